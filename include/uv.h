@@ -229,6 +229,7 @@ typedef struct uv_prepare_s uv_prepare_t;
 typedef struct uv_check_s uv_check_t;
 typedef struct uv_idle_s uv_idle_t;
 typedef struct uv_async_s uv_async_t;
+typedef struct uv_channel_s uv_channel_t;
 typedef struct uv_process_s uv_process_t;
 typedef struct uv_fs_event_s uv_fs_event_t;
 typedef struct uv_fs_poll_s uv_fs_poll_t;
@@ -257,12 +258,34 @@ typedef struct uv_utsname_s uv_utsname_t;
 typedef struct uv_statfs_s uv_statfs_t;
 
 typedef struct uv_metrics_s uv_metrics_t;
+typedef struct uv_threadpool_s uv_threadpool_t;
+typedef struct uv_threadpool_options_s uv_threadpool_options_t;
+typedef struct uv_threadpool_kind_metrics_s uv_threadpool_kind_metrics_t;
+typedef struct uv_threadpool_metrics_s uv_threadpool_metrics_t;
 
 typedef enum {
   UV_LOOP_BLOCK_SIGNAL = 0,
   UV_METRICS_IDLE_TIME,
-  UV_LOOP_USE_IO_URING_SQPOLL
+  UV_LOOP_USE_IO_URING_SQPOLL,
 #define UV_LOOP_USE_IO_URING_SQPOLL UV_LOOP_USE_IO_URING_SQPOLL
+  UV_LOOP_USE_IO_URING_POLL,
+#define UV_LOOP_USE_IO_URING_POLL UV_LOOP_USE_IO_URING_POLL
+  UV_LOOP_USE_EDGE_TRIGGERED_STREAMS,
+#define UV_LOOP_USE_EDGE_TRIGGERED_STREAMS UV_LOOP_USE_EDGE_TRIGGERED_STREAMS
+  UV_LOOP_USE_IO_URING_STREAMS,
+#define UV_LOOP_USE_IO_URING_STREAMS UV_LOOP_USE_IO_URING_STREAMS
+  UV_LOOP_USE_IO_URING_BUFFERS,
+#define UV_LOOP_USE_IO_URING_BUFFERS UV_LOOP_USE_IO_URING_BUFFERS
+  UV_LOOP_USE_TIMER_WHEEL,
+#define UV_LOOP_USE_TIMER_WHEEL UV_LOOP_USE_TIMER_WHEEL
+  UV_LOOP_TIMER_SLACK,
+#define UV_LOOP_TIMER_SLACK UV_LOOP_TIMER_SLACK
+  UV_LOOP_THREADPOOL,
+#define UV_LOOP_THREADPOOL UV_LOOP_THREADPOOL
+  UV_LOOP_WORK_PRIORITY,
+#define UV_LOOP_WORK_PRIORITY UV_LOOP_WORK_PRIORITY
+  UV_METRICS_THREADPOOL_TIME
+#define UV_METRICS_THREADPOOL_TIME UV_METRICS_THREADPOOL_TIME
 } uv_loop_option;
 
 typedef enum {
@@ -334,6 +357,9 @@ typedef void (*uv_close_cb)(uv_handle_t* handle);
 typedef void (*uv_poll_cb)(uv_poll_t* handle, int status, int events);
 typedef void (*uv_timer_cb)(uv_timer_t* handle);
 typedef void (*uv_async_cb)(uv_async_t* handle);
+typedef void (*uv_channel_cb)(uv_channel_t* channel,
+                              void** msgs,
+                              unsigned int nmsgs);
 typedef void (*uv_prepare_cb)(uv_prepare_t* handle);
 typedef void (*uv_check_cb)(uv_check_t* handle);
 typedef void (*uv_idle_cb)(uv_idle_t* handle);
@@ -545,6 +571,8 @@ UV_EXTERN int uv_accept(uv_stream_t* server, uv_stream_t* client);
 UV_EXTERN int uv_read_start(uv_stream_t*,
                             uv_alloc_cb alloc_cb,
                             uv_read_cb read_cb);
+UV_EXTERN int uv_read_start_provided(uv_stream_t*, uv_read_cb read_cb);
+UV_EXTERN int uv_read_buf_release(uv_loop_t* loop, const uv_buf_t* buf);
 UV_EXTERN int uv_read_stop(uv_stream_t*);
 
 UV_EXTERN int uv_write(uv_write_t* req,
@@ -603,6 +631,7 @@ UV_EXTERN int uv_tcp_keepalive(uv_tcp_t* handle,
                                int enable,
                                unsigned int delay);
 UV_EXTERN int uv_tcp_simultaneous_accepts(uv_tcp_t* handle, int enable);
+UV_EXTERN int uv_tcp_zerocopy(uv_tcp_t* handle, int enable, size_t threshold);
 
 enum uv_tcp_flags {
   /* Used with uv_tcp_bind, when an IPv6 address is used. */
@@ -702,7 +731,17 @@ enum uv_udp_flags {
   /*
    * Indicates that recvmmsg should be used, if available.
    */
-  UV_UDP_RECVMMSG = 256
+  UV_UDP_RECVMMSG = 256,
+  /*
+   * Indicates that the kernel should split uv_udp_send_gso() payloads into
+   * datagrams (UDP_SEGMENT), if available.
+   */
+  UV_UDP_GSO = 512,
+  /*
+   * Indicates that the kernel may coalesce received datagrams (UDP_GRO), if
+   * available. The datagrams are handed to the recv_cb as UV_UDP_MMSG_CHUNKs.
+   */
+  UV_UDP_GRO = 1024
 };
 
 typedef void (*uv_udp_send_cb)(uv_udp_send_t* req, int status);
@@ -771,6 +810,13 @@ UV_EXTERN int uv_udp_send(uv_udp_send_t* req,
                           unsigned int nbufs,
                           const struct sockaddr* addr,
                           uv_udp_send_cb send_cb);
+UV_EXTERN int uv_udp_send_gso(uv_udp_send_t* req,
+                              uv_udp_t* handle,
+                              const uv_buf_t bufs[],
+                              unsigned int nbufs,
+                              const struct sockaddr* addr,
+                              size_t segment_size,
+                              uv_udp_send_cb send_cb);
 UV_EXTERN int uv_udp_try_send(uv_udp_t* handle,
                               const uv_buf_t bufs[],
                               unsigned int nbufs,
@@ -944,6 +990,24 @@ UV_EXTERN int uv_async_init(uv_loop_t*,
 UV_EXTERN int uv_async_send(uv_async_t* async);
 
 
+/*
+ * uv_channel_t is a subclass of uv_async_t.
+ */
+struct uv_channel_s {
+  UV_HANDLE_FIELDS
+  UV_ASYNC_PRIVATE_FIELDS
+  /* private */
+  uv_channel_cb channel_cb;
+  void* ring;
+};
+
+UV_EXTERN int uv_channel_init(uv_loop_t*,
+                              uv_channel_t* channel,
+                              unsigned int capacity,
+                              uv_channel_cb channel_cb);
+UV_EXTERN int uv_channel_send(uv_channel_t* channel, void* msg);
+
+
 /*
  * uv_timer_t is a subclass of uv_handle_t.
  *
@@ -963,6 +1027,7 @@ UV_EXTERN int uv_timer_stop(uv_timer_t* handle);
 UV_EXTERN int uv_timer_again(uv_timer_t* handle);
 UV_EXTERN void uv_timer_set_repeat(uv_timer_t* handle, uint64_t repeat);
 UV_EXTERN uint64_t uv_timer_get_repeat(const uv_timer_t* handle);
+UV_EXTERN void uv_timer_set_strict(uv_timer_t* handle, int strict);
 UV_EXTERN uint64_t uv_timer_get_due_in(const uv_timer_t* handle);
 
 
@@ -1173,13 +1238,76 @@ struct uv_work_s {
   UV_WORK_PRIVATE_FIELDS
 };
 
+typedef enum {
+  UV_WORK_PRIORITY_CRITICAL = -1,
+  UV_WORK_PRIORITY_NORMAL = 0,
+  UV_WORK_PRIORITY_BACKGROUND = 1
+} uv_work_priority;
+
 UV_EXTERN int uv_queue_work(uv_loop_t* loop,
                             uv_work_t* req,
                             uv_work_cb work_cb,
                             uv_after_work_cb after_work_cb);
+UV_EXTERN int uv_queue_work_ex(uv_loop_t* loop,
+                               uv_work_t* req,
+                               uv_work_cb work_cb,
+                               uv_after_work_cb after_work_cb,
+                               uv_work_priority priority);
+UV_EXTERN int uv_queue_work_batch(uv_loop_t* loop,
+                                  uv_work_t reqs[],
+                                  unsigned int nreqs,
+                                  uv_work_cb work_cb,
+                                  uv_after_work_cb after_work_cb);
+UV_EXTERN int uv_queue_work_batch_ex(uv_loop_t* loop,
+                                     uv_work_t reqs[],
+                                     unsigned int nreqs,
+                                     uv_work_cb work_cb,
+                                     uv_after_work_cb after_work_cb,
+                                     uv_work_priority priority);
+UV_EXTERN int uv_queue_work_detached(uv_loop_t* loop,
+                                     uv_work_t* req,
+                                     uv_work_cb work_cb);
 
 UV_EXTERN int uv_cancel(uv_req_t* req);
 
+enum uv_threadpool_flags {
+  /* File system requests. */
+  UV_THREADPOOL_FS = 1,
+  /* uv_getaddrinfo() and uv_getnameinfo() requests. */
+  UV_THREADPOOL_DNS = 2,
+  /* uv_queue_work() and uv_random() requests. */
+  UV_THREADPOOL_WORK = 4
+};
+
+enum uv_threadpool_placement {
+  /* Pin every thread to a single CPU. */
+  UV_THREADPOOL_PIN_CPU = 1,
+  /* Spread the threads over the NUMA nodes, run work on the loop's node. */
+  UV_THREADPOOL_PIN_NUMA = 2
+};
+
+struct uv_threadpool_s {
+  void* data;
+  /* private */
+  void* internal;
+};
+
+struct uv_threadpool_options_s {
+  unsigned int min_threads;
+  unsigned int max_threads;
+  uint64_t spawn_delay;  /* milliseconds */
+  uint64_t idle_timeout;  /* milliseconds */
+  uint64_t spin_time;  /* microseconds */
+  unsigned int placement;  /* uv_threadpool_placement flags */
+  const char* cpumask;
+  size_t cpumask_size;
+};
+
+UV_EXTERN int uv_threadpool_init(uv_threadpool_t* pool, unsigned int nthreads);
+UV_EXTERN int uv_threadpool_init_ex(uv_threadpool_t* pool,
+                                    const uv_threadpool_options_t* options);
+UV_EXTERN int uv_threadpool_close(uv_threadpool_t* pool);
+
 
 struct uv_cpu_times_s {
   uint64_t user; /* milliseconds */
@@ -1377,6 +1505,31 @@ struct uv_metrics_s {
 UV_EXTERN int uv_metrics_info(uv_loop_t* loop, uv_metrics_t* metrics);
 UV_EXTERN uint64_t uv_metrics_idle_time(uv_loop_t* loop);
 
+#define UV_THREADPOOL_HISTOGRAM_SIZE 24
+
+struct uv_threadpool_kind_metrics_s {
+  uint64_t completed;
+  uint64_t cancelled;
+  uint64_t wait_time;  /* nanoseconds */
+  uint64_t run_time;  /* nanoseconds */
+  uint64_t wait_histogram[UV_THREADPOOL_HISTOGRAM_SIZE];
+  uint64_t run_histogram[UV_THREADPOOL_HISTOGRAM_SIZE];
+  /* Of the thread pool that runs this kind of request. */
+  unsigned int queued;
+  unsigned int idle_threads;
+  unsigned int threads;
+  uint64_t slow_io_throttled;
+};
+
+struct uv_threadpool_metrics_s {
+  uv_threadpool_kind_metrics_t fs;
+  uv_threadpool_kind_metrics_t dns;
+  uv_threadpool_kind_metrics_t work;
+};
+
+UV_EXTERN int uv_metrics_threadpool(uv_loop_t* loop,
+                                    uv_threadpool_metrics_t* metrics);
+
 typedef enum {
   UV_FS_UNKNOWN = -1,
   UV_FS_CUSTOM,
@@ -31,7 +31,11 @@ struct uv__work {
   void (*work)(struct uv__work *w);
   void (*done)(struct uv__work *w, int status);
   struct uv_loop_s* loop;
+  int kind;  /* Not last, that costs padding on 32 bit platforms. */
   struct uv__queue wq;
+  uint64_t enqueue_time;
+  uint64_t start_time;
+  uint64_t finish_time;
 };
 
 #endif /* UV_THREADPOOL_H_ */
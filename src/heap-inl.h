@@ -16,7 +16,11 @@
 #ifndef UV_SRC_HEAP_H_
 #define UV_SRC_HEAP_H_
 
+#include "uv-common.h"  /* uv__realloc(), uv__free() */
+
+#include <assert.h>
 #include <stddef.h>  /* NULL */
+#include <string.h>  /* memcpy() */
 
 #if defined(__GNUC__)
 # define HEAP_EXPORT(declaration) __attribute__((unused)) static declaration
@@ -24,21 +28,27 @@
 # define HEAP_EXPORT(declaration) static declaration
 #endif
 
+/* Number of children per node. Four of them halve the height of the tree
+ * compared to a binary heap and the children of a node share a cache line,
+ * which makes up for the extra comparisons.
+ */
+#define HEAP_ARITY 4
+#define HEAP_MIN_CAPACITY 16
+
 struct heap_node {
-  struct heap_node* left;
-  struct heap_node* right;
-  struct heap_node* parent;
+  unsigned int index;
 };
 
-/* A binary min heap.  The usual properties hold: the root is the lowest
- * element in the set, the height of the tree is at most log2(nodes) and
- * it's always a complete binary tree.
+/* A 4-ary min heap, stored in an array in level order. The root is the lowest
+ * element in the set, the children of nodes[i] are nodes[4*i+1] to
+ * nodes[4*i+4]. Nodes know their own index so that they can be removed
+ * without searching for them.
  *
- * The heap function try hard to detect corrupted tree nodes at the cost
- * of a minor reduction in performance.  Compile with -DNDEBUG to disable.
+ * The array grows and shrinks in powers of two. Its capacity is stored in
+ * front of it, in the slot at nodes[-1].
  */
 struct heap {
-  struct heap_node* min;
+  struct heap_node** nodes;
   unsigned int nelts;
 };
 
@@ -48,10 +58,11 @@ typedef int (*heap_compare_fn)(const struct heap_node* a,
 
 /* Public functions. */
 HEAP_EXPORT(void heap_init(struct heap* heap));
+HEAP_EXPORT(void heap_free(struct heap* heap));
 HEAP_EXPORT(struct heap_node* heap_min(const struct heap* heap));
-HEAP_EXPORT(void heap_insert(struct heap* heap,
-                             struct heap_node* newnode,
-                             heap_compare_fn less_than));
+HEAP_EXPORT(int heap_insert(struct heap* heap,
+                            struct heap_node* newnode,
+                            heap_compare_fn less_than));
 HEAP_EXPORT(void heap_remove(struct heap* heap,
                              struct heap_node* node,
                              heap_compare_fn less_than));
@@ -60,186 +71,178 @@ HEAP_EXPORT(void heap_dequeue(struct heap* heap, heap_compare_fn less_than));
 /* Implementation follows. */
 
 HEAP_EXPORT(void heap_init(struct heap* heap)) {
-  heap->min = NULL;
+  heap->nodes = NULL;
   heap->nelts = 0;
 }
 
+HEAP_EXPORT(void heap_free(struct heap* heap)) {
+  assert(heap->nelts == 0);
+  if (heap->nodes != NULL)
+    uv__free(heap->nodes - 1);
+  heap->nodes = NULL;
+}
+
 HEAP_EXPORT(struct heap_node* heap_min(const struct heap* heap)) {
-  return heap->min;
+  if (heap->nelts == 0)
+    return NULL;
+  return heap->nodes[0];
 }
 
-/* Swap parent with child. Child moves closer to the root, parent moves away. */
-static void heap_node_swap(struct heap* heap,
-                           struct heap_node* parent,
-                           struct heap_node* child) {
-  struct heap_node* sibling;
-  struct heap_node t;
-
-  t = *parent;
-  *parent = *child;
-  *child = t;
-
-  parent->parent = child;
-  if (child->left == child) {
-    child->left = parent;
-    sibling = child->right;
-  } else {
-    child->right = parent;
-    sibling = child->left;
-  }
-  if (sibling != NULL)
-    sibling->parent = child;
-
-  if (parent->left != NULL)
-    parent->left->parent = parent;
-  if (parent->right != NULL)
-    parent->right->parent = parent;
-
-  if (child->parent == NULL)
-    heap->min = child;
-  else if (child->parent->left == parent)
-    child->parent->left = child;
-  else
-    child->parent->right = child;
+static unsigned int heap_capacity(const struct heap* heap) {
+  unsigned int capacity;
+
+  if (heap->nodes == NULL)
+    return 0;
+
+  memcpy(&capacity, heap->nodes - 1, sizeof(capacity));
+  return capacity;
 }
 
-HEAP_EXPORT(void heap_insert(struct heap* heap,
-                             struct heap_node* newnode,
-                             heap_compare_fn less_than)) {
-  struct heap_node** parent;
-  struct heap_node** child;
-  unsigned int path;
-  unsigned int n;
-  unsigned int k;
-
-  newnode->left = NULL;
-  newnode->right = NULL;
-  newnode->parent = NULL;
-
-  /* Calculate the path from the root to the insertion point.  This is a min
-   * heap so we always insert at the left-most free node of the bottom row.
-   */
-  path = 0;
-  for (k = 0, n = 1 + heap->nelts; n >= 2; k += 1, n /= 2)
-    path = (path << 1) | (n & 1);
-
-  /* Now traverse the heap using the path we calculated in the previous step. */
-  parent = child = &heap->min;
-  while (k > 0) {
-    parent = child;
-    if (path & 1)
-      child = &(*child)->right;
-    else
-      child = &(*child)->left;
-    path >>= 1;
-    k -= 1;
-  }
+/* Leaves the heap alone on failure. */
+static int heap_resize(struct heap* heap, unsigned int capacity) {
+  struct heap_node** nodes;
 
-  /* Insert the new node. */
-  newnode->parent = *parent;
-  *child = newnode;
-  heap->nelts += 1;
+  if ((size_t) capacity + 1 > (size_t) -1 / sizeof(*nodes))
+    return UV_ENOMEM;
 
-  /* Walk up the tree and check at each node if the heap property holds.
-   * It's a min heap so parent < child must be true.
-   */
-  while (newnode->parent != NULL && less_than(newnode, newnode->parent))
-    heap_node_swap(heap, newnode->parent, newnode);
+  nodes = NULL;
+  if (heap->nodes != NULL)
+    nodes = heap->nodes - 1;
+
+  nodes = uv__realloc(nodes, (1 + (size_t) capacity) * sizeof(*nodes));
+  if (nodes == NULL)
+    return UV_ENOMEM;
+
+  memcpy(nodes, &capacity, sizeof(capacity));
+  heap->nodes = nodes + 1;
+  return 0;
 }
 
-HEAP_EXPORT(void heap_remove(struct heap* heap,
-                             struct heap_node* node,
-                             heap_compare_fn less_than)) {
-  struct heap_node* smallest;
-  struct heap_node** max;
-  struct heap_node* child;
-  unsigned int path;
-  unsigned int k;
-  unsigned int n;
+/* Put |node| at |index|, or further up if it's less than its parents. */
+static void heap_sift_up(struct heap* heap,
+                         struct heap_node* node,
+                         unsigned int index,
+                         heap_compare_fn less_than) {
+  struct heap_node* parent;
 
-  if (heap->nelts == 0)
-    return;
+  while (index > 0) {
+    parent = heap->nodes[(index - 1) / HEAP_ARITY];
+    if (!less_than(node, parent))
+      break;
 
-  /* Calculate the path from the min (the root) to the max, the left-most node
-   * of the bottom row.
-   */
-  path = 0;
-  for (k = 0, n = heap->nelts; n >= 2; k += 1, n /= 2)
-    path = (path << 1) | (n & 1);
-
-  /* Now traverse the heap using the path we calculated in the previous step. */
-  max = &heap->min;
-  while (k > 0) {
-    if (path & 1)
-      max = &(*max)->right;
-    else
-      max = &(*max)->left;
-    path >>= 1;
-    k -= 1;
+    parent->index = index;
+    heap->nodes[index] = parent;
+    index = (index - 1) / HEAP_ARITY;
   }
 
-  heap->nelts -= 1;
+  node->index = index;
+  heap->nodes[index] = node;
+}
 
-  /* Unlink the max node. */
-  child = *max;
-  *max = NULL;
+/* Put |node| at |index|, or further down if it's greater than its children. */
+static void heap_sift_down(struct heap* heap,
+                           struct heap_node* node,
+                           unsigned int index,
+                           heap_compare_fn less_than) {
+  struct heap_node* smallest;
+  unsigned int child;
+  unsigned int last;
+  unsigned int i;
 
-  if (child == node) {
-    /* We're removing either the max or the last node in the tree. */
-    if (child == heap->min) {
-      heap->min = NULL;
+  for (;;) {
+    if (heap->nelts < 2 || index > (heap->nelts - 2) / HEAP_ARITY)
+      break;  /* No children. */
+
+    child = HEAP_ARITY * index + 1;
+    last = child + HEAP_ARITY;
+    if (last > heap->nelts)
+      last = heap->nelts;
+
+    smallest = heap->nodes[child];
+    for (i = child + 1; i < last; i++) {
+      if (less_than(heap->nodes[i], smallest)) {
+        smallest = heap->nodes[i];
+        child = i;
+      }
     }
-    return;
-  }
 
-  /* Replace the to be deleted node with the max node. */
-  child->left = node->left;
-  child->right = node->right;
-  child->parent = node->parent;
+    if (!less_than(smallest, node))
+      break;
 
-  if (child->left != NULL) {
-    child->left->parent = child;
+    smallest->index = index;
+    heap->nodes[index] = smallest;
+    index = child;
   }
 
-  if (child->right != NULL) {
-    child->right->parent = child;
-  }
+  node->index = index;
+  heap->nodes[index] = node;
+}
 
-  if (node->parent == NULL) {
-    heap->min = child;
-  } else if (node->parent->left == node) {
-    node->parent->left = child;
-  } else {
-    node->parent->right = child;
+/* Returns UV_ENOMEM when the array needs to grow and that fails. */
+HEAP_EXPORT(int heap_insert(struct heap* heap,
+                            struct heap_node* newnode,
+                            heap_compare_fn less_than)) {
+  unsigned int capacity;
+  int err;
+
+  capacity = heap_capacity(heap);
+  if (heap->nelts == capacity) {
+    capacity = capacity ? 2 * capacity : HEAP_MIN_CAPACITY;
+    if (capacity < heap->nelts)
+      return UV_ENOMEM;
+
+    err = heap_resize(heap, capacity);
+    if (err)
+      return err;
   }
 
-  /* Walk down the subtree and check at each node if the heap property holds.
-   * It's a min heap so parent < child must be true.  If the parent is bigger,
-   * swap it with the smallest child.
+  heap->nelts += 1;
+  heap_sift_up(heap, newnode, heap->nelts - 1, less_than);
+  return 0;
+}
+
+HEAP_EXPORT(void heap_remove(struct heap* heap,
+                             struct heap_node* node,
+                             heap_compare_fn less_than)) {
+  struct heap_node* last;
+  unsigned int capacity;
+  unsigned int index;
+
+  if (heap->nelts == 0)
+    return;
+
+  index = node->index;
+  assert(index < heap->nelts);
+  assert(heap->nodes[index] == node);
+
+  heap->nelts -= 1;
+  last = heap->nodes[heap->nelts];
+
+  /* Fill the hole with the last node. It came from a different subtree, so it
+   * can be less than the parent of |node| or greater than its children.
    */
-  for (;;) {
-    smallest = child;
-    if (child->left != NULL && less_than(child->left, smallest))
-      smallest = child->left;
-    if (child->right != NULL && less_than(child->right, smallest))
-      smallest = child->right;
-    if (smallest == child)
-      break;
-    heap_node_swap(heap, child, smallest);
+  if (last != node) {
+    if (index > 0 && less_than(last, heap->nodes[(index - 1) / HEAP_ARITY]))
+      heap_sift_up(heap, last, index, less_than);
+    else
+      heap_sift_down(heap, last, index, less_than);
   }
 
-  /* Walk up the subtree and check that each parent is less than the node
-   * this is required, because `max` node is not guaranteed to be the
-   * actual maximum in tree
+  /* Shrink to half when only a quarter of the array is in use. Re-inserting
+   * a node right after removing it, to change its key, never has to grow the
+   * array again. Failing to shrink is harmless.
    */
-  while (child->parent != NULL && less_than(child, child->parent))
-    heap_node_swap(heap, child->parent, child);
+  capacity = heap_capacity(heap);
+  if (capacity > HEAP_MIN_CAPACITY && heap->nelts <= capacity / 4)
+    heap_resize(heap, capacity / 2);
 }
 
 HEAP_EXPORT(void heap_dequeue(struct heap* heap, heap_compare_fn less_than)) {
-  heap_remove(heap, heap->min, less_than);
+  heap_remove(heap, heap_min(heap), less_than);
 }
 
+#undef HEAP_ARITY
+#undef HEAP_MIN_CAPACITY
 #undef HEAP_EXPORT
 
 #endif  /* UV_SRC_HEAP_H_ */
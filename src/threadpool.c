@@ -25,25 +25,126 @@
 # include "unix/internal.h"
 #endif
 
+#include <limits.h>
 #include <stdlib.h>
 
 #define MAX_THREADPOOL_SIZE 1024
 
+/* One queue per uv_work_priority, most urgent first. A less urgent queue gets
+ * a turn after more urgent work has been picked ahead of it this many times.
+ */
+#define UV__WORK_PRIORITIES 3
+#define UV__WORK_STARVATION_LIMIT 8
+
+/* How often, in seconds, auto-sized pools look at the CPU quota. */
+#define UV__THREADPOOL_RESIZE_INTERVAL 1
+
+#ifdef _MSC_VER
+#define uv__tp_load(p) InterlockedOr((LONG volatile*)(p), 0)
+#define uv__tp_add(p, v) InterlockedExchangeAdd((LONG volatile*)(p), v)
+#define uv__tp_store(p, v) InterlockedExchange((LONG volatile*)(p), v)
+#else
+#define uv__tp_load(p) atomic_load((_Atomic int*)(p))
+#define uv__tp_add(p, v) atomic_fetch_add((_Atomic int*)(p), v)
+#define uv__tp_store(p, v) atomic_store((_Atomic int*)(p), v)
+#endif
+
+/* How many spinning loads of `queued` worker_spin() does between clock
+ * reads.
+ */
+#define UV__WORK_SPIN_CHECK 64
+
+struct uv__threadpool;
+
+enum {
+  UV__WORKER_NONE,
+  UV__WORKER_RUNNING,
+  UV__WORKER_EXITED  /* Waiting to be joined. */
+};
+
+/* Every worker owns a queue. Loops hand their work to a preferred worker and
+ * workers that run out of work steal from the other workers' queues. Lock
+ * order is the pool's `mutex` first, then the workers' mutexes in array
+ * order; only uv__work_cancel() holds more than one lock at a time.
+ */
+struct uv__worker {
+  uv_mutex_t mutex;
+  struct uv__queue wq[UV__WORK_PRIORITIES];
+  unsigned int skipped[UV__WORK_PRIORITIES];
+  uv_thread_t thread;
+  struct uv__threadpool* pool;
+  uv_sem_t* started;
+  int delayed;  /* Started by uv__threadpool_grow(), see worker_delay(). */
+  int state;  /* Guarded by the pool's `mutex`. */
+  uint64_t spin;  /* Nanoseconds, adapts to the load, see worker_spin(). */
+  unsigned int node;  /* Index into the pool's `nodes`. */
+};
+
+/* Elastic pools, where min_threads < nthreads, start threads when work waits
+ * for more than spawn_delay nanoseconds and let threads exit after they idled
+ * for idle_timeout nanoseconds.
+ */
+struct uv__threadpool {
+  uv_cond_t cond;
+  uv_cond_t spawn_cond;
+  uv_mutex_t mutex;
+  int idle_threads;
+  int queued;  /* Work in the workers' queues, may lag behind. */
+  int nrunning;
+  int spawning;
+  int exiting;
+  int spinning;  /* Spinning threads that no post() counted on yet. */
+  int max_spinning;
+  int detached;  /* Detached work in the workers' queues. */
+  unsigned int nloops;  /* Loops bound to the pool. */
+  unsigned int slow_io_work_running;
+  unsigned int nthreads;  /* Number of workers, running or not. */
+  unsigned int min_threads;
+  int max_threads;  /* Running threads, at most nthreads. */
+  int auto_size;  /* Follows the CPU quota, see uv__threadpool_autosize(). */
+  int resize_at;  /* Seconds, when to look at the CPU quota again. */
+  uint64_t spawn_delay;
+  uint64_t idle_timeout;
+  uint64_t spin_time;  /* 0 when idle threads go to sleep right away. */
+  char* cpumasks;  /* One per worker, NULL when the threads aren't pinned. */
+  size_t cpumask_size;
+  int* nodes;  /* NUMA nodes, the workers of a node are adjacent. */
+  unsigned int nnodes;
+  struct uv__worker* workers;
+  int slow_io_scheduled;  /* |run_slow_work_message| is queued. */
+  int slow_io_deferred;  /* ... or waits for a slow I/O thread. */
+  unsigned int slow_io_pending;  /* Length of |slow_io_pending_wq|. */
+  uint64_t slow_io_throttled;
+  struct uv__queue run_slow_work_message;
+  struct uv__queue slow_io_pending_wq;
+};
+
 static uv_once_t once = UV_ONCE_INIT;
-static uv_cond_t cond;
-static uv_mutex_t mutex;
-static unsigned int idle_threads;
-static unsigned int slow_io_work_running;
-static unsigned int nthreads;
-static uv_thread_t* threads;
-static uv_thread_t default_threads[4];
-static struct uv__queue exit_message;
-static struct uv__queue wq;
-static struct uv__queue run_slow_work_message;
-static struct uv__queue slow_io_pending_wq;
-
-static unsigned int slow_work_thread_threshold(void) {
-  return (nthreads + 1) / 2;
+static struct uv__threadpool default_pool;
+static int default_pool_started;  /* Set once init_once() has run. */
+static struct uv__worker default_workers[4];
+static int next_worker;
+
+static unsigned int slow_work_thread_threshold(struct uv__threadpool* pool) {
+  return (uv__tp_load(&pool->nrunning) + 1) / 2;
+}
+
+/* Take one off `*p` unless it's zero. Returns 1 on success. */
+static int uv__tp_take(int* p) {
+  int n;
+
+  for (;;) {
+    n = uv__tp_load(p);
+    if (n == 0)
+      return 0;
+#ifdef _MSC_VER
+    if (InterlockedCompareExchange((LONG volatile*) p, n - 1, n) == n)
+      return 1;
+#else
+    if (atomic_compare_exchange_weak((_Atomic int*) p, &n, n - 1))
+      return 1;
+#endif
+  }
 }
 
 static void uv__cancelled(struct uv__work* w) {
@@ -51,112 +152,679 @@ static void uv__cancelled(struct uv__work* w) {
 }
 
 
-/* To avoid deadlock with uv_cancel() it's crucial that the worker
- * never holds the global mutex and the loop-local mutex at the same time.
+/* Hand finished work back to its loop. The loop's list of finished work is a
+ * lock-free stack, linked through w->wq.prev. w->wq.next keeps pointing to
+ * w->wq so that uv__work_cancel() still sees it as not cancellable. Only the
+ * thread that finds the stack empty wakes up the loop.
+ */
+static void uv__work_finish(struct uv__work* w) {
+  struct uv__queue* next;
+  void** head;
+#ifdef _MSC_VER
+  struct uv__queue* prev;
+#endif
+
+  head = &uv__get_internal_fields(w->loop)->wq_done;
+
+#ifdef _MSC_VER
+  next = *(struct uv__queue* volatile*) head;
+  for (;;) {
+    w->wq.prev = next;
+    prev = InterlockedCompareExchangePointer(head, &w->wq, next);
+    if (prev == next)
+      break;
+    next = prev;
+  }
+#else
+  next = atomic_load_explicit((_Atomic(void*)*) head, memory_order_relaxed);
+  do
+    w->wq.prev = next;
+  while (!atomic_compare_exchange_weak((_Atomic(void*)*) head,
+                                       (void**) &next,
+                                       &w->wq));
+#endif
+
+  if (next == NULL)
+    uv_async_send(&w->loop->wq_async);
+}
+
+
+static void worker(void* arg);
+
+
+/* Start a worker in a free slot. `mutex` must be locked. */
+static int uv__threadpool_spawn(struct uv__threadpool* pool,
+                                int delayed,
+                                uv_sem_t* started) {
+  uv_thread_options_t config;
+  struct uv__worker* wk;
+  unsigned int i;
+  int err;
+
+  if (pool->nrunning >= pool->max_threads)
+    return UV_EAGAIN;
+
+  for (i = 0; i < pool->nthreads; i++)
+    if (pool->workers[i].state != UV__WORKER_RUNNING)
+      break;
+
+  if (i == pool->nthreads)
+    return UV_EAGAIN;
+
+  wk = pool->workers + i;
+  if (wk->state == UV__WORKER_EXITED) {
+    if (uv_thread_join(&wk->thread))
+      abort();
+    wk->state = UV__WORKER_NONE;
+  }
+
+  wk->delayed = delayed;
+  wk->started = started;
+  wk->spin = pool->spin_time;
+
+  config.flags = UV_THREAD_HAS_STACK_SIZE;
+  config.stack_size = 8u << 20;  /* 8 MB */
+
+  err = uv_thread_create_ex(&wk->thread, &config, worker, wk);
+  if (err)
+    return err;
+
+  wk->state = UV__WORKER_RUNNING;
+  uv__tp_add(&pool->nrunning, 1);
+  if (delayed)
+    uv__tp_add(&pool->spawning, 1);
+
+  return 0;
+}
+
+
+/* Work is waiting and all threads are busy. Start a thread that waits for
+ * spawn_delay and then checks if the work is still waiting, unless there are
+ * no threads at all.
+ */
+static void uv__threadpool_grow(struct uv__threadpool* pool) {
+  uv_mutex_lock(&pool->mutex);
+  if (!pool->exiting &&
+      pool->spawning == 0 &&
+      pool->idle_threads == 0 &&
+      uv__tp_load(&pool->queued) > 0)
+    uv__threadpool_spawn(pool, pool->nrunning > 0, NULL);
+  uv_mutex_unlock(&pool->mutex);
+}
+
+
+/* Wake up as many idle threads as there is new work, or grow the pool. */
+static void uv__threadpool_wake(struct uv__threadpool* pool, int nwork) {
+  int idle;
+
+  /* Pairs with the check in worker(): either the idle thread sees the work or
+   * we see the idle thread.
+   */
+  uv__tp_add(&pool->queued, nwork);
+
+  /* Spinning threads find the work without being signalled. */
+  while (nwork > 0 && uv__tp_take(&pool->spinning))
+    nwork--;
+
+  if (nwork == 0)
+    return;
+
+  idle = uv__tp_load(&pool->idle_threads);
+  if (idle > 0) {
+    if (nwork > idle)
+      nwork = idle;
+    uv_mutex_lock(&pool->mutex);
+    while (nwork-- > 0)
+      uv_cond_signal(&pool->cond);
+    uv_mutex_unlock(&pool->mutex);
+  } else if (uv__tp_load(&pool->nrunning) < uv__tp_load(&pool->max_threads) &&
+             uv__tp_load(&pool->spawning) == 0) {
+    uv__threadpool_grow(pool);
+  }
+}
+
+
+static void post(struct uv__worker* wk, struct uv__queue* q, int prio) {
+  uv_mutex_lock(&wk->mutex);
+  uv__queue_insert_tail(&wk->wq[prio - UV_WORK_PRIORITY_CRITICAL], q);
+  uv_mutex_unlock(&wk->mutex);
+  uv__threadpool_wake(wk->pool, 1);
+}
+
+
+/* Like post() but for all work in |q|, which is emptied. */
+static void post_batch(struct uv__worker* wk,
+                       struct uv__queue* q,
+                       int nwork,
+                       int prio) {
+  uv_mutex_lock(&wk->mutex);
+  uv__queue_add(&wk->wq[prio - UV_WORK_PRIORITY_CRITICAL], q);
+  uv_mutex_unlock(&wk->mutex);
+  uv__queue_init(q);
+  uv__threadpool_wake(wk->pool, nwork);
+}
+
+
+static void post_slow_io(struct uv__worker* wk, struct uv__queue* q) {
+  struct uv__threadpool* pool;
+
+  pool = wk->pool;
+  uv_mutex_lock(&pool->mutex);
+  uv__queue_insert_tail(&pool->slow_io_pending_wq, q);
+  pool->slow_io_pending++;
+  if (pool->slow_io_scheduled) {
+    /* Running slow I/O tasks is already scheduled => Nothing to do here.
+       The worker that runs said other task will schedule this one as well. */
+    uv_mutex_unlock(&pool->mutex);
+    return;
+  }
+  pool->slow_io_scheduled = 1;
+  uv_mutex_unlock(&pool->mutex);
+
+  post(wk, &pool->run_slow_work_message, UV_WORK_PRIORITY_NORMAL);
+}
+
+
+static int uv__worker_empty(const struct uv__worker* wk) {
+  unsigned int i;
+
+  for (i = 0; i < UV__WORK_PRIORITIES; i++)
+    if (!uv__queue_empty(&wk->wq[i]))
+      return 0;
+
+  return 1;
+}
+
+
+static struct uv__queue* uv__work_pop(struct uv__worker* wk) {
+  struct uv__queue* q;
+  int prio;
+  int i;
+
+  prio = -1;
+  for (i = 0; i < UV__WORK_PRIORITIES; i++) {
+    if (uv__queue_empty(&wk->wq[i]))
+      continue;
+
+    if (prio == -1) {
+      prio = i;
+    } else if (++wk->skipped[i] > UV__WORK_STARVATION_LIMIT) {
+      prio = i;
+      break;
+    }
+  }
+
+  wk->skipped[prio] = 0;
+  q = uv__queue_head(&wk->wq[prio]);
+  uv__queue_remove(q);
+  uv__queue_init(q);  /* Signal uv_cancel() that the work req is executing. */
+  uv__tp_add(&wk->pool->queued, -1);
+
+  return q;
+}
+
+
+/* Take the oldest work from another worker's queue. Stealing one request at
+ * a time keeps the work of a loop in submission order, work never sits in the
+ * queue of a worker that is stuck in a long-running request.
+ */
+static struct uv__queue* uv__work_steal(struct uv__worker* self) {
+  struct uv__threadpool* pool;
+  struct uv__worker* victim;
+  struct uv__queue* q;
+  unsigned int pass;
+  unsigned int i;
+
+  /* Try the workers on our own NUMA node first. */
+  pool = self->pool;
+  for (pass = 0; pass < pool->nnodes && pass < 2; pass++) {
+    for (i = 1; i < pool->nthreads; i++) {
+      if (uv__tp_load(&pool->queued) == 0)
+        return NULL;
+
+      victim = pool->workers + (self - pool->workers + i) % pool->nthreads;
+      if ((victim->node == self->node) != (pass == 0))
+        continue;
+
+      q = NULL;
+      uv_mutex_lock(&victim->mutex);
+      if (!uv__worker_empty(victim))
+        q = uv__work_pop(victim);
+      uv_mutex_unlock(&victim->mutex);
+
+      if (q != NULL)
+        return q;
+    }
+  }
+
+  return NULL;
+}
+
+
+/* Let a thread that exits go, it's joined when its slot is reused or when the
+ * pool is stopped. `mutex` must be locked.
+ */
+static void worker_exit(struct uv__worker* self) {
+  uv__tp_add(&self->pool->nrunning, -1);
+  self->state = UV__WORKER_EXITED;
+  uv_mutex_unlock(&self->pool->mutex);
+}
+
+
+/* Returns 0 when the work that made uv__threadpool_grow() start the thread
+ * was picked up by other threads in the meantime and the thread exited.
  */
+static int worker_delay(struct uv__worker* self) {
+  struct uv__threadpool* pool;
+  uint64_t deadline;
+  uint64_t now;
+  int n;
+
+  pool = self->pool;
+  uv_mutex_lock(&pool->mutex);
+
+  deadline = uv_hrtime() + pool->spawn_delay;
+  while (!pool->exiting) {
+    now = uv_hrtime();
+    if (now >= deadline)
+      break;
+    uv_cond_timedwait(&pool->spawn_cond, &pool->mutex, deadline - now);
+  }
+
+  uv__tp_add(&pool->spawning, -1);
+
+  n = uv__tp_load(&pool->queued);
+  if (n == 0 && !pool->exiting &&
+      pool->nrunning > (int) pool->min_threads) {
+    worker_exit(self);
+    return 0;
+  }
+
+  /* The work waited long enough, start threads for all of it right away. */
+  n -= pool->idle_threads + 1;
+  while (n-- > 0 && !pool->exiting)
+    if (uv__threadpool_spawn(pool, 0, NULL))
+      break;
+
+  uv_mutex_unlock(&pool->mutex);
+  return 1;
+}
+
+
+/* Busy-wait for new work for a little while, which is a lot cheaper than
+ * going to sleep and being woken up again when work arrives at a high rate.
+ * The spin time is halved every time nothing showed up and reset when work
+ * arrived soon after the thread went to sleep after all. Returns 0 when the
+ * thread didn't spin.
+ */
+static int worker_spin(struct uv__worker* self) {
+  struct uv__threadpool* pool;
+  uint64_t deadline;
+  unsigned int i;
+
+  pool = self->pool;
+  if (self->spin == 0)
+    return 0;
+
+  if (uv__tp_load(&pool->spinning) >= pool->max_spinning)
+    return 0;
+
+  /* Pairs with uv__threadpool_wake(): either post() sees us spinning and
+   * doesn't signal, or we see the work.
+   */
+  uv__tp_add(&pool->spinning, 1);
+  deadline = uv_hrtime() + self->spin;
+  for (i = 1; uv__tp_load(&pool->queued) == 0; i++) {
+    uv__cpu_relax();
+    if (i % UV__WORK_SPIN_CHECK == 0 && uv_hrtime() >= deadline)
+      break;
+  }
+
+  /* If somebody already took us off, a post() counted on us to run work. */
+  if (uv__tp_take(&pool->spinning) && uv__tp_load(&pool->queued) == 0)
+    self->spin /= 2;
+
+  return 1;
+}
+
+
+/* One thread per CPU of the quota, but at least two so that slow I/O
+ * doesn't hold up everything else, see slow_work_thread_threshold().
+ */
+static unsigned int uv__threadpool_auto_threads(struct uv__threadpool* pool) {
+  unsigned int n;
+
+  n = uv_available_parallelism();
+  if (n < 2)
+    n = 2;
+  if (n > pool->nthreads)
+    n = pool->nthreads;
+
+  return n;
+}
+
+
+/* Follow changes of the CPU quota. Busy pools check at most once every
+ * UV__THREADPOOL_RESIZE_INTERVAL seconds, idle ones when work shows up.
+ */
+static void uv__threadpool_autosize(struct uv__threadpool* pool) {
+  unsigned int n;
+  int now;
+
+  now = (int) (uv_hrtime() / 1000000000);
+  if (now < uv__tp_load(&pool->resize_at))
+    return;
+
+  uv_mutex_lock(&pool->mutex);
+  if (now < pool->resize_at || pool->exiting) {
+    uv_mutex_unlock(&pool->mutex);
+    return;
+  }
+  uv__tp_store(&pool->resize_at, now + UV__THREADPOOL_RESIZE_INTERVAL);
+  uv_mutex_unlock(&pool->mutex);
+
+  /* Reads the cgroup files, don't hold the lock. */
+  n = uv__threadpool_auto_threads(pool);
+
+  uv_mutex_lock(&pool->mutex);
+  if (n != pool->min_threads && !pool->exiting) {
+    pool->min_threads = n;
+    uv__tp_store(&pool->max_threads, (int) n);
+
+    while (pool->nrunning < (int) n)
+      if (uv__threadpool_spawn(pool, 0, NULL))
+        break;
+
+    /* Let idle threads above the new size exit. */
+    uv_cond_broadcast(&pool->cond);
+  }
+  uv_mutex_unlock(&pool->mutex);
+}
+
+
 static void worker(void* arg) {
+  struct uv__threadpool* pool;
+  struct uv__worker* self;
   struct uv__work* w;
   struct uv__queue* q;
+  uv_thread_t tid;
+  uint64_t parked;
   int is_slow_work;
+  int may_spin;
+  int repost;
+
+  self = arg;
+  pool = self->pool;
+  if (self->started != NULL)
+    uv_sem_post(self->started);
+
+  /* Best effort, the CPUs may have gone offline in the meantime. */
+  if (pool->cpumasks != NULL) {
+    tid = uv_thread_self();
+    uv_thread_setaffinity(&tid,
+                          pool->cpumasks +
+                              (self - pool->workers) * pool->cpumask_size,
+                          NULL,
+                          pool->cpumask_size);
+  }
 
-  uv_sem_post((uv_sem_t*) arg);
-  arg = NULL;
+  if (self->delayed && !worker_delay(self))
+    return;
 
-  uv_mutex_lock(&mutex);
+  may_spin = 1;
   for (;;) {
-    /* `mutex` should always be locked at this point. */
-
-    /* Keep waiting while either no work is present or only slow I/O
-       and we're at the threshold for that. */
-    while (uv__queue_empty(&wq) ||
-           (uv__queue_head(&wq) == &run_slow_work_message &&
-            uv__queue_next(&run_slow_work_message) == &wq &&
-            slow_io_work_running >= slow_work_thread_threshold())) {
-      idle_threads += 1;
-      uv_cond_wait(&cond, &mutex);
-      idle_threads -= 1;
+    if (pool->auto_size)
+      uv__threadpool_autosize(pool);
+
+    q = NULL;
+    uv_mutex_lock(&self->mutex);
+    if (!uv__worker_empty(self))
+      q = uv__work_pop(self);
+    uv_mutex_unlock(&self->mutex);
+
+    if (q == NULL)
+      q = uv__work_steal(self);
+
+    if (q == NULL && may_spin) {
+      may_spin = 0;
+      if (worker_spin(self))
+        continue;
     }
 
-    q = uv__queue_head(&wq);
-    if (q == &exit_message) {
-      uv_cond_signal(&cond);
-      uv_mutex_unlock(&mutex);
-      break;
+    if (q == NULL) {
+      /* Keep waiting while no work is present. Slow I/O work that is over
+         the threshold is not in any queue, see `slow_io_deferred`. */
+      uv_mutex_lock(&pool->mutex);
+      if (pool->exiting) {
+        uv_mutex_unlock(&pool->mutex);
+        break;
+      }
+      uv__tp_add(&pool->idle_threads, 1);
+      parked = pool->spin_time != 0 ? uv_hrtime() : 0;
+      while (!pool->exiting && uv__tp_load(&pool->queued) == 0) {
+        if (pool->nrunning <= (int) pool->min_threads) {
+          uv_cond_wait(&pool->cond, &pool->mutex);
+          continue;
+        }
+
+        if (uv_cond_timedwait(&pool->cond, &pool->mutex, pool->idle_timeout))
+          if (pool->nrunning > (int) pool->min_threads) {
+            /* Like post(), stop being idle before looking at the queue. */
+            uv__tp_add(&pool->idle_threads, -1);
+            if (uv__tp_load(&pool->queued) == 0) {
+              worker_exit(self);
+              return;
+            }
+            uv__tp_add(&pool->idle_threads, 1);
+          }
+      }
+      uv__tp_add(&pool->idle_threads, -1);
+      uv_mutex_unlock(&pool->mutex);
+
+      /* Spinning a little longer would have saved the wakeup. */
+      if (parked != 0 && uv_hrtime() - parked < pool->spin_time)
+        self->spin = pool->spin_time;
+
+      continue;
     }
 
-    uv__queue_remove(q);
-    uv__queue_init(q);  /* Signal uv_cancel() that the work req is executing. */
+    may_spin = 1;
+
+    /* post() only grows the pool when nobody was idle, check again now that
+     * we're not idle anymore either.
+     */
+    if (uv__tp_load(&pool->queued) > 0 &&
+        uv__tp_load(&pool->idle_threads) == 0 &&
+        uv__tp_load(&pool->spinning) == 0 &&
+        uv__tp_load(&pool->nrunning) < uv__tp_load(&pool->max_threads) &&
+        uv__tp_load(&pool->spawning) == 0)
+      uv__threadpool_grow(pool);
 
     is_slow_work = 0;
-    if (q == &run_slow_work_message) {
-      /* If we're at the slow I/O threshold, re-schedule until after all
-         other work in the queue is done. */
-      if (slow_io_work_running >= slow_work_thread_threshold()) {
-        uv__queue_insert_tail(&wq, q);
+    if (q == &pool->run_slow_work_message) {
+      uv_mutex_lock(&pool->mutex);
+
+      /* If we're at the slow I/O threshold, re-schedule when one of the
+         slow I/O threads is done. */
+      if (pool->slow_io_work_running >= slow_work_thread_threshold(pool)) {
+        pool->slow_io_deferred = 1;
+        pool->slow_io_throttled++;
+        uv_mutex_unlock(&pool->mutex);
         continue;
       }
 
       /* If we encountered a request to run slow I/O work but there is none
          to run, that means it's cancelled => Start over. */
-      if (uv__queue_empty(&slow_io_pending_wq))
+      if (uv__queue_empty(&pool->slow_io_pending_wq)) {
+        pool->slow_io_scheduled = 0;
+        uv_mutex_unlock(&pool->mutex);
         continue;
+      }
 
       is_slow_work = 1;
-      slow_io_work_running++;
+      pool->slow_io_work_running++;
 
-      q = uv__queue_head(&slow_io_pending_wq);
+      q = uv__queue_head(&pool->slow_io_pending_wq);
+      pool->slow_io_pending--;
       uv__queue_remove(q);
       uv__queue_init(q);
 
       /* If there is more slow I/O work, schedule it to be run as well. */
-      if (!uv__queue_empty(&slow_io_pending_wq)) {
-        uv__queue_insert_tail(&wq, &run_slow_work_message);
-        if (idle_threads > 0)
-          uv_cond_signal(&cond);
-      }
-    }
+      repost = !uv__queue_empty(&pool->slow_io_pending_wq);
+      pool->slow_io_scheduled = repost;
+      uv_mutex_unlock(&pool->mutex);
 
-    uv_mutex_unlock(&mutex);
+      if (repost)
+        post(self, &pool->run_slow_work_message, UV_WORK_PRIORITY_NORMAL);
+    }
 
     w = uv__queue_data(q, struct uv__work, wq);
-    w->work(w);
-
-    uv_mutex_lock(&w->loop->wq_mutex);
-    w->work = NULL;  /* Signal uv_cancel() that the work req is done
-                        executing. */
-    uv__queue_insert_tail(&w->loop->wq, &w->wq);
-    uv_async_send(&w->loop->wq_async);
-    uv_mutex_unlock(&w->loop->wq_mutex);
+    if (w->done == NULL) {
+      /* Detached work doesn't go back to the loop. The request belongs to
+       * the user again once work() returns, don't touch it after that.
+       */
+      uv__tp_add(&pool->detached, -1);
+      w->work(w);
+    } else {
+      if (w->enqueue_time != 0)
+        w->start_time = uv_hrtime();
+      w->work(w);
+      if (w->enqueue_time != 0)
+        w->finish_time = uv_hrtime();
+      w->work = NULL;  /* Signal uv__work_done() that it's not cancelled. */
+      uv__work_finish(w);
+    }
 
-    /* Lock `mutex` since that is expected at the start of the next
-     * iteration. */
-    uv_mutex_lock(&mutex);
     if (is_slow_work) {
-      /* `slow_io_work_running` is protected by `mutex`. */
-      slow_io_work_running--;
+      uv_mutex_lock(&pool->mutex);
+      pool->slow_io_work_running--;
+      repost = pool->slow_io_deferred;
+      pool->slow_io_deferred = 0;
+      uv_mutex_unlock(&pool->mutex);
+
+      if (repost)
+        post(self, &pool->run_slow_work_message, UV_WORK_PRIORITY_NORMAL);
     }
   }
 }
 
 
-static void post(struct uv__queue* q, enum uv__work_kind kind) {
-  uv_mutex_lock(&mutex);
-  if (kind == UV__WORK_SLOW_IO) {
-    /* Insert into a separate queue. */
-    uv__queue_insert_tail(&slow_io_pending_wq, q);
-    if (!uv__queue_empty(&run_slow_work_message)) {
-      /* Running slow I/O tasks is already scheduled => Nothing to do here.
-         The worker that runs said other task will schedule this one as well. */
-      uv_mutex_unlock(&mutex);
-      return;
+static void uv__threadpool_stop(struct uv__threadpool* pool) {
+  unsigned int i;
+  int state;
+
+  uv_mutex_lock(&pool->mutex);
+  pool->exiting = 1;
+  uv_cond_broadcast(&pool->cond);
+  uv_cond_broadcast(&pool->spawn_cond);
+  uv_mutex_unlock(&pool->mutex);
+
+  for (i = 0; i < pool->nthreads; i++) {
+    uv_mutex_lock(&pool->mutex);
+    state = pool->workers[i].state;
+    uv_mutex_unlock(&pool->mutex);
+
+    if (state != UV__WORKER_NONE)
+      if (uv_thread_join(&pool->workers[i].thread))
+        abort();
+  }
+
+  for (i = 0; i < pool->nthreads; i++)
+    uv_mutex_destroy(&pool->workers[i].mutex);
+
+  uv_mutex_destroy(&pool->mutex);
+  uv_cond_destroy(&pool->spawn_cond);
+  uv_cond_destroy(&pool->cond);
+}
+
+
+static int uv__threadpool_start(struct uv__threadpool* pool) {
+  unsigned int i;
+  unsigned int j;
+  uv_sem_t sem;
+  int err;
+
+  pool->idle_threads = 0;
+  pool->queued = 0;
+  pool->nrunning = 0;
+  pool->spawning = 0;
+  pool->exiting = 0;
+  pool->spinning = 0;
+  pool->detached = 0;
+  pool->nloops = 0;
+
+  /* Leave CPUs to the loops and the threads that run work. */
+  pool->max_spinning = (pool->nthreads + 1) / 2;
+  if (pool->max_spinning > (int) uv_available_parallelism() - 1)
+    pool->max_spinning = (int) uv_available_parallelism() - 1;
+
+  pool->slow_io_work_running = 0;
+  pool->slow_io_scheduled = 0;
+  pool->slow_io_deferred = 0;
+  pool->slow_io_pending = 0;
+  pool->slow_io_throttled = 0;
+  uv__queue_init(&pool->slow_io_pending_wq);
+  uv__queue_init(&pool->run_slow_work_message);
+
+  err = uv_cond_init(&pool->cond);
+  if (err)
+    return err;
+
+  err = uv_cond_init(&pool->spawn_cond);
+  if (err)
+    goto fail_spawn_cond;
+
+  err = uv_mutex_init(&pool->mutex);
+  if (err)
+    goto fail_mutex;
+
+  err = uv_sem_init(&sem, 0);
+  if (err)
+    goto fail_sem;
+
+  for (i = 0; i < pool->nthreads; i++) {
+    err = uv_mutex_init(&pool->workers[i].mutex);
+    if (err)
+      goto fail_workers;
+    for (j = 0; j < UV__WORK_PRIORITIES; j++) {
+      uv__queue_init(&pool->workers[i].wq[j]);
+      pool->workers[i].skipped[j] = 0;
     }
-    q = &run_slow_work_message;
+    pool->workers[i].pool = pool;
+    pool->workers[i].state = UV__WORKER_NONE;
   }
 
-  uv__queue_insert_tail(&wq, q);
-  if (idle_threads > 0)
-    uv_cond_signal(&cond);
-  uv_mutex_unlock(&mutex);
+  uv_mutex_lock(&pool->mutex);
+  for (i = 0; i < pool->min_threads; i++) {
+    err = uv__threadpool_spawn(pool, 0, &sem);
+    if (err)
+      break;
+  }
+  uv_mutex_unlock(&pool->mutex);
+
+  while (i > 0) {
+    uv_sem_wait(&sem);
+    i--;
+  }
+
+  uv_sem_destroy(&sem);
+
+  if (err)
+    uv__threadpool_stop(pool);
+
+  return err;
+
+fail_workers:
+  while (i > 0)
+    uv_mutex_destroy(&pool->workers[--i].mutex);
+  uv_sem_destroy(&sem);
+fail_sem:
+  uv_mutex_destroy(&pool->mutex);
+fail_mutex:
+  uv_cond_destroy(&pool->spawn_cond);
+fail_spawn_cond:
+  uv_cond_destroy(&pool->cond);
+  return err;
 }
 
 
@@ -165,79 +833,95 @@ static void post(struct uv__queue* q, enum uv__work_kind kind) {
 __attribute__((destructor))
 #endif
 void uv__threadpool_cleanup(void) {
-  unsigned int i;
-
-  if (nthreads == 0)
+  if (default_pool.nthreads == 0)
     return;
 
 #ifndef __MVS__
   /* TODO(gabylb) - zos: revisit when Woz compiler is available. */
-  post(&exit_message, UV__WORK_CPU);
+  uv__threadpool_stop(&default_pool);
 #endif
 
-  for (i = 0; i < nthreads; i++)
-    if (uv_thread_join(threads + i))
-      abort();
+  if (default_pool.workers != default_workers)
+    uv__free(default_pool.workers);
 
-  if (threads != default_threads)
-    uv__free(threads);
+  default_pool.workers = NULL;
+  default_pool.nthreads = 0;
+  uv__tp_store(&default_pool_started, 0);
+}
 
-  uv_mutex_destroy(&mutex);
-  uv_cond_destroy(&cond);
 
-  threads = NULL;
-  nthreads = 0;
+static unsigned int uv__threadpool_max_cpus(void) {
+  uv_cpu_info_t* cpus;
+  unsigned int n;
+  int count;
+
+  n = uv_available_parallelism();
+  if (uv_cpu_info(&cpus, &count) == 0) {
+    if ((unsigned int) count > n)
+      n = count;
+    uv_free_cpu_info(cpus, count);
+  }
+
+  if (n < 2)
+    n = 2;
+
+  return n;
 }
 
 
 static void init_threads(void) {
-  uv_thread_options_t config;
-  unsigned int i;
+  struct uv__threadpool* pool;
   const char* val;
-  uv_sem_t sem;
 
-  nthreads = ARRAY_SIZE(default_threads);
+  pool = &default_pool;
+  pool->nthreads = ARRAY_SIZE(default_workers);
+  pool->auto_size = 0;
   val = getenv("UV_THREADPOOL_SIZE");
-  if (val != NULL)
-    nthreads = atoi(val);
-  if (nthreads == 0)
-    nthreads = 1;
-  if (nthreads > MAX_THREADPOOL_SIZE)
-    nthreads = MAX_THREADPOOL_SIZE;
-
-  threads = default_threads;
-  if (nthreads > ARRAY_SIZE(default_threads)) {
-    threads = uv__malloc(nthreads * sizeof(threads[0]));
-    if (threads == NULL) {
-      nthreads = ARRAY_SIZE(default_threads);
-      threads = default_threads;
+  if (val != NULL && strcmp(val, "auto") == 0) {
+    /* Room for every CPU, the quota may go up later on. */
+    pool->auto_size = 1;
+    pool->nthreads = uv__threadpool_max_cpus();
+  } else if (val != NULL) {
+    pool->nthreads = atoi(val);
+  }
+  if (pool->nthreads == 0)
+    pool->nthreads = 1;
+  if (pool->nthreads > MAX_THREADPOOL_SIZE)
+    pool->nthreads = MAX_THREADPOOL_SIZE;
+
+  pool->workers = default_workers;
+  if (pool->nthreads > ARRAY_SIZE(default_workers)) {
+    pool->workers = uv__malloc(pool->nthreads * sizeof(pool->workers[0]));
+    if (pool->workers == NULL) {
+      pool->nthreads = ARRAY_SIZE(default_workers);
+      pool->workers = default_workers;
     }
   }
 
-  if (uv_cond_init(&cond))
-    abort();
-
-  if (uv_mutex_init(&mutex))
-    abort();
+  pool->min_threads = pool->nthreads;
+  pool->max_threads = pool->nthreads;
+  pool->idle_timeout = 0;
+  pool->cpumasks = NULL;
+  pool->nodes = NULL;
+  pool->nnodes = 1;
+
+  if (pool->auto_size) {
+    /* Threads above the quota exit as soon as they are idle. */
+    pool->min_threads = uv__threadpool_auto_threads(pool);
+    pool->max_threads = pool->min_threads;
+    pool->resize_at =
+        (int) (uv_hrtime() / 1000000000) + UV__THREADPOOL_RESIZE_INTERVAL;
+  }
 
-  uv__queue_init(&wq);
-  uv__queue_init(&slow_io_pending_wq);
-  uv__queue_init(&run_slow_work_message);
+  pool->spin_time = 0;
+  val = getenv("UV_THREADPOOL_SPIN");
+  if (val != NULL && atoi(val) > 0)
+    pool->spin_time = (uint64_t) atoi(val) * 1000;
 
-  if (uv_sem_init(&sem, 0))
+  if (uv__threadpool_start(pool))
     abort();
 
-  config.flags = UV_THREAD_HAS_STACK_SIZE;
-  config.stack_size = 8u << 20;  /* 8 MB */
-
-  for (i = 0; i < nthreads; i++)
-    if (uv_thread_create_ex(threads + i, &config, worker, &sem))
-      abort();
-
-  for (i = 0; i < nthreads; i++)
-    uv_sem_wait(&sem);
-
-  uv_sem_destroy(&sem);
+  uv__tp_store(&default_pool_started, 1);
 }
 
 
@@ -245,6 +929,7 @@ static void init_threads(void) {
 static void reset_once(void) {
   uv_once_t child_once = UV_ONCE_INIT;
   memcpy(&once, &child_once, sizeof(child_once));
+  uv__tp_store(&default_pool_started, 0);
 }
 #endif
 
@@ -253,7 +938,7 @@ static void init_once(void) {
 #ifndef _WIN32
   /* Re-initialize the threadpool after fork.
    * Note that this discards the global mutex and condition as well
-   * as the work queue.
+   * as the work queues.
    */
   if (pthread_atfork(NULL, NULL, &reset_once))
     abort();
@@ -262,70 +947,522 @@ static void init_once(void) {
 }
 
 
+int uv_threadpool_init(uv_threadpool_t* tp, unsigned int nthreads) {
+  uv_threadpool_options_t options;
+
+  memset(&options, 0, sizeof(options));
+  options.min_threads = nthreads;
+  options.max_threads = nthreads;
+
+  return uv_threadpool_init_ex(tp, &options);
+}
+
+
+static void uv__threadpool_unplace(struct uv__threadpool* pool) {
+  unsigned int i;
+
+  uv__free(pool->cpumasks);
+  uv__free(pool->nodes);
+  pool->cpumasks = NULL;
+  pool->nodes = NULL;
+  pool->nnodes = 1;
+
+  for (i = 0; i < pool->nthreads; i++)
+    pool->workers[i].node = 0;
+}
+
+
+/* Work out the CPUs of every worker. The workers are spread evenly over the
+ * NUMA nodes, node k gets the adjacent workers whose index i satisfies
+ * floor(i * nnodes / nthreads) == k.
+ */
+static int uv__threadpool_place(struct uv__threadpool* pool,
+                                const uv_threadpool_options_t* options) {
+  uv_thread_t tid;
+  unsigned int ncpus;
+  unsigned int count;
+  unsigned int first;
+  unsigned int pick;
+  unsigned int i;
+  unsigned int j;
+  unsigned int k;
+  unsigned int n;
+  int* cpu_nodes;
+  char* wmask;
+  char* mask;
+  int* cpus;
+  int size;
+  int err;
+
+  pool->cpumasks = NULL;
+  pool->nodes = NULL;
+  pool->nnodes = 1;
+  for (i = 0; i < pool->nthreads; i++)
+    pool->workers[i].node = 0;
+
+  if (options->placement == 0 && options->cpumask == NULL)
+    return 0;
+
+  if (options->placement & ~(UV_THREADPOOL_PIN_CPU | UV_THREADPOOL_PIN_NUMA))
+    return UV_EINVAL;
+
+  size = uv_cpumask_size();
+  if (size < 0)
+    return size;
+
+  mask = uv__malloc(size);
+  cpus = uv__malloc(size * sizeof(*cpus));
+  cpu_nodes = uv__malloc(size * sizeof(*cpu_nodes));
+  pool->nodes = uv__malloc(size * sizeof(*pool->nodes));
+  pool->cpumasks = uv__calloc(pool->nthreads, size);
+  pool->cpumask_size = size;
+
+  err = UV_ENOMEM;
+  if (mask == NULL ||
+      cpus == NULL ||
+      cpu_nodes == NULL ||
+      pool->nodes == NULL ||
+      pool->cpumasks == NULL)
+    goto out;
+
+  if (options->cpumask != NULL) {
+    err = UV_EINVAL;
+    if (options->cpumask_size < (size_t) size)
+      goto out;
+    memcpy(mask, options->cpumask, size);
+  } else {
+    tid = uv_thread_self();
+    err = uv_thread_getaffinity(&tid, mask, size);
+    if (err)
+      goto out;
+  }
+
+  /* Number the nodes in the order their first CPU shows up. */
+  ncpus = 0;
+  pool->nnodes = 0;
+  for (i = 0; i < (unsigned int) size; i++) {
+    if (!mask[i])
+      continue;
+
+    n = 0;
+    if (options->placement & UV_THREADPOOL_PIN_NUMA)
+      n = uv__cpu_numa_node(i);
+
+    for (k = 0; k < pool->nnodes; k++)
+      if (pool->nodes[k] == (int) n)
+        break;
+
+    if (k == pool->nnodes)
+      pool->nodes[pool->nnodes++] = n;
+
+    cpus[ncpus] = i;
+    cpu_nodes[ncpus] = k;
+    ncpus++;
+  }
+
+  err = UV_EINVAL;
+  if (ncpus == 0)
+    goto out;
+
+  for (i = 0; i < pool->nthreads; i++) {
+    k = i * pool->nnodes / pool->nthreads;
+    first = (k * pool->nthreads + pool->nnodes - 1) / pool->nnodes;
+    pool->workers[i].node = k;
+
+    count = 0;
+    for (j = 0; j < ncpus; j++)
+      count += cpu_nodes[j] == (int) k;
+
+    /* With UV_THREADPOOL_PIN_CPU, take turns over the node's CPUs. */
+    pick = (i - first) % count;
+    wmask = pool->cpumasks + (size_t) i * size;
+    for (j = 0, n = 0; j < ncpus; j++) {
+      if (cpu_nodes[j] != (int) k)
+        continue;
+      if (!(options->placement & UV_THREADPOOL_PIN_CPU) || n == pick)
+        wmask[cpus[j]] = 1;
+      n++;
+    }
+  }
+
+  err = 0;
+
+out:
+  uv__free(cpu_nodes);
+  uv__free(cpus);
+  uv__free(mask);
+
+  if (err)
+    uv__threadpool_unplace(pool);
+
+  return err;
+}
+
+
+int uv_threadpool_init_ex(uv_threadpool_t* tp,
+                          const uv_threadpool_options_t* options) {
+  struct uv__threadpool* pool;
+  unsigned int nthreads;
+  int err;
+
+  nthreads = options->max_threads;
+  if (nthreads == 0 || nthreads > MAX_THREADPOOL_SIZE)
+    return UV_EINVAL;
+
+  if (options->min_threads > nthreads)
+    return UV_EINVAL;
+
+  pool = uv__malloc(sizeof(*pool) + nthreads * sizeof(pool->workers[0]));
+  if (pool == NULL)
+    return UV_ENOMEM;
+
+  pool->nthreads = nthreads;
+  pool->min_threads = options->min_threads;
+  pool->max_threads = nthreads;
+  pool->auto_size = 0;
+  pool->spawn_delay = options->spawn_delay * 1000000;
+  pool->idle_timeout = options->idle_timeout * 1000000;
+  pool->spin_time = options->spin_time * 1000;
+  pool->workers = (struct uv__worker*) (pool + 1);
+
+  err = uv__threadpool_place(pool, options);
+  if (err) {
+    uv__free(pool);
+    return err;
+  }
+
+  err = uv__threadpool_start(pool);
+  if (err) {
+    uv__threadpool_unplace(pool);
+    uv__free(pool);
+    return err;
+  }
+
+  tp->internal = pool;
+  return 0;
+}
+
+
+int uv_threadpool_close(uv_threadpool_t* tp) {
+  struct uv__threadpool* pool;
+  unsigned int nloops;
+
+  pool = tp->internal;
+  uv_mutex_lock(&pool->mutex);
+  nloops = pool->nloops;
+  uv_mutex_unlock(&pool->mutex);
+
+  if (nloops > 0)
+    return UV_EBUSY;
+
+  uv__threadpool_stop(pool);
+  uv__threadpool_unplace(pool);
+  uv__free(pool);
+  tp->internal = NULL;
+
+  return 0;
+}
+
+
+static struct uv__threadpool* uv__threadpool_get(uv_loop_t* loop,
+                                                 enum uv__work_kind kind) {
+  struct uv__threadpool* pool;
+
+  pool = uv__get_internal_fields(loop)->wq_pools[kind];
+  if (pool != NULL)
+    return pool;
+
+  uv_once(&once, init_once);
+  return &default_pool;
+}
+
+
+static void uv__threadpool_set(uv_loop_t* loop,
+                               enum uv__work_kind kind,
+                               struct uv__threadpool* pool) {
+  struct uv__threadpool* prev;
+  void** slot;
+
+  slot = &uv__get_internal_fields(loop)->wq_pools[kind];
+  prev = *slot;
+  *slot = pool;
+
+  if (prev != NULL) {
+    uv_mutex_lock(&prev->mutex);
+    prev->nloops--;
+    uv_mutex_unlock(&prev->mutex);
+  }
+
+  if (pool != NULL) {
+    uv_mutex_lock(&pool->mutex);
+    pool->nloops++;
+    uv_mutex_unlock(&pool->mutex);
+  }
+}
+
+
+int uv__threadpool_bind(uv_loop_t* loop,
+                        unsigned int kinds,
+                        uv_threadpool_t* tp) {
+  struct uv__threadpool* pool;
+
+  if (kinds & ~(UV_THREADPOOL_FS | UV_THREADPOOL_DNS | UV_THREADPOOL_WORK))
+    return UV_EINVAL;
+
+  /* Work that is in flight needs to find its pool again in uv_cancel().
+   * Detached work isn't active, its pool counts it instead.
+   */
+  if (uv__has_active_reqs(loop))
+    return UV_EBUSY;
+
+  if (kinds & UV_THREADPOOL_WORK) {
+    pool = uv__get_internal_fields(loop)->wq_pools[UV__WORK_CPU];
+    if (pool == NULL)
+      pool = &default_pool;  /* Zero if it hasn't started yet. */
+    if (uv__tp_load(&pool->detached) > 0)
+      return UV_EBUSY;
+  }
+
+  pool = tp != NULL ? tp->internal : NULL;
+  if (kinds & UV_THREADPOOL_WORK)
+    uv__threadpool_set(loop, UV__WORK_CPU, pool);
+  if (kinds & UV_THREADPOOL_FS)
+    uv__threadpool_set(loop, UV__WORK_FAST_IO, pool);
+  if (kinds & UV_THREADPOOL_DNS)
+    uv__threadpool_set(loop, UV__WORK_SLOW_IO, pool);
+
+  return 0;
+}
+
+
+void uv__threadpool_unbind(uv_loop_t* loop) {
+  uv__threadpool_set(loop, UV__WORK_CPU, NULL);
+  uv__threadpool_set(loop, UV__WORK_FAST_IO, NULL);
+  uv__threadpool_set(loop, UV__WORK_SLOW_IO, NULL);
+}
+
+
+/* Zero tells worker() not to record the start and finish times either. */
+static uint64_t uv__work_now(uv_loop_t* loop) {
+  if (uv__get_internal_fields(loop)->flags & UV__METRICS_THREADPOOL_TIME)
+    return uv_hrtime();
+
+  return 0;
+}
+
+
+static struct uv__worker* uv__work_worker(uv_loop_t* loop,
+                                          enum uv__work_kind kind) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__threadpool* pool;
+  unsigned int first;
+  unsigned int end;
+  unsigned int k;
+  int cpu;
+
+  pool = uv__threadpool_get(loop, kind);
+
+  /* Spread loops over the workers, idle workers steal from busy ones. */
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->wq_worker == 0)
+    lfields->wq_worker = 1 + (unsigned int) uv__tp_add(&next_worker, 1);
+
+  if (pool->nnodes > 1) {
+    /* Stay on the NUMA node that the loop thread first ran work on. */
+    if (lfields->wq_node == 0) {
+      cpu = uv_thread_getcpu();
+      lfields->wq_node = cpu < 0 ? -1 : 1 + uv__cpu_numa_node(cpu);
+    }
+
+    for (k = 0; k < pool->nnodes; k++) {
+      if (pool->nodes[k] != lfields->wq_node - 1)
+        continue;
+
+      first = (k * pool->nthreads + pool->nnodes - 1) / pool->nnodes;
+      end = ((k + 1) * pool->nthreads + pool->nnodes - 1) / pool->nnodes;
+      if (end > first)
+        return pool->workers + first + (lfields->wq_worker - 1) % (end - first);
+    }
+  }
+
+  return pool->workers + (lfields->wq_worker - 1) % pool->nthreads;
+}
+
+
+static void uv__work_submit_priority(uv_loop_t* loop,
+                                     struct uv__work* w,
+                                     enum uv__work_kind kind,
+                                     void (*work)(struct uv__work* w),
+                                     void (*done)(struct uv__work* w,
+                                                  int status),
+                                     int prio) {
+  struct uv__worker* wk;
+
+  wk = uv__work_worker(loop, kind);
+  w->loop = loop;
+  w->work = work;
+  w->done = done;
+  w->kind = kind;
+  w->enqueue_time = uv__work_now(loop);
+
+  if (kind == UV__WORK_SLOW_IO)
+    post_slow_io(wk, &w->wq);
+  else
+    post(wk, &w->wq, prio);
+}
+
+
 void uv__work_submit(uv_loop_t* loop,
                      struct uv__work* w,
                      enum uv__work_kind kind,
                      void (*work)(struct uv__work* w),
                      void (*done)(struct uv__work* w, int status)) {
-  uv_once(&once, init_once);
-  w->loop = loop;
-  w->work = work;
-  w->done = done;
-  post(&w->wq, kind);
+  uv__work_submit_priority(loop,
+                           w,
+                           kind,
+                           work,
+                           done,
+                           uv__get_internal_fields(loop)->wq_priority);
 }
 
 
 /* TODO(bnoordhuis) teach libuv how to cancel file operations
  * that go through io_uring instead of the thread pool.
  */
-static int uv__work_cancel(uv_loop_t* loop, uv_req_t* req, struct uv__work* w) {
+static int uv__work_cancel(uv_loop_t* loop,
+                           uv_req_t* req,
+                           struct uv__work* w,
+                           enum uv__work_kind kind) {
+  struct uv__threadpool* pool;
+  struct uv__queue* q;
+  unsigned int i;
   int cancelled;
 
-  uv_once(&once, init_once);  /* Ensure |mutex| is initialized. */
-  uv_mutex_lock(&mutex);
-  uv_mutex_lock(&w->loop->wq_mutex);
+  /* The loop can't be bound to another pool while it has work queued, see
+   * uv__threadpool_bind().
+   */
+  pool = uv__threadpool_get(loop, kind);  /* Ensure |mutex| is initialized. */
+  uv_mutex_lock(&pool->mutex);
+  for (i = 0; i < pool->nthreads; i++)
+    uv_mutex_lock(&pool->workers[i].mutex);
+
+  /* Workers empty w->wq when they take the work off the queue, and leave it
+   * that way until uv__work_done() ran.
+   */
+  cancelled = !uv__queue_empty(&w->wq);
+  if (cancelled) {
+    /* Find out what queue the work is in by walking to its head. */
+    q = uv__queue_next(&w->wq);
+    while (q != &pool->slow_io_pending_wq &&
+           ((char*) q < (char*) pool->workers ||
+            (char*) q >= (char*) (pool->workers + pool->nthreads)))
+      q = uv__queue_next(q);
+
+    if (q != &pool->slow_io_pending_wq)
+      uv__tp_add(&pool->queued, -1);
+    else
+      pool->slow_io_pending--;
 
-  cancelled = !uv__queue_empty(&w->wq) && w->work != NULL;
-  if (cancelled)
     uv__queue_remove(&w->wq);
+    uv__queue_init(&w->wq);
+  }
 
-  uv_mutex_unlock(&w->loop->wq_mutex);
-  uv_mutex_unlock(&mutex);
+  for (i = pool->nthreads; i > 0; i--)
+    uv_mutex_unlock(&pool->workers[i - 1].mutex);
+  uv_mutex_unlock(&pool->mutex);
 
   if (!cancelled)
     return UV_EBUSY;
 
+  if (w->done == NULL) {
+    uv__tp_add(&pool->detached, -1);
+    return 0;  /* Detached, nothing to tell the loop. */
+  }
+
   w->work = uv__cancelled;
-  uv_mutex_lock(&loop->wq_mutex);
-  uv__queue_insert_tail(&loop->wq, &w->wq);
-  uv_async_send(&loop->wq_async);
-  uv_mutex_unlock(&loop->wq_mutex);
+  uv__work_finish(w);
 
   return 0;
 }
 
 
+static unsigned int uv__work_bucket(uint64_t ns) {
+  unsigned int bucket;
+  uint64_t us;
+
+  /* Bucket 0 is below one microsecond, bucket n is [2^(n-1), 2^n) us. */
+  us = ns / 1000;
+  for (bucket = 0; us != 0; bucket++)
+    us >>= 1;
+
+  if (bucket >= UV_THREADPOOL_HISTOGRAM_SIZE)
+    bucket = UV_THREADPOOL_HISTOGRAM_SIZE - 1;
+
+  return bucket;
+}
+
+
+static void uv__work_account(uv_loop_t* loop, struct uv__work* w, int err) {
+  uv_threadpool_kind_metrics_t* m;
+  uint64_t wait;
+  uint64_t run;
+
+  m = &uv__get_internal_fields(loop)->wq_metrics[w->kind];
+  if (err) {
+    m->cancelled++;
+    return;
+  }
+
+  m->completed++;
+  if (w->enqueue_time == 0)
+    return;  /* UV_METRICS_THREADPOOL_TIME not enabled. */
+
+  wait = w->start_time - w->enqueue_time;
+  run = w->finish_time - w->start_time;
+
+  m->wait_time += wait;
+  m->run_time += run;
+  m->wait_histogram[uv__work_bucket(wait)]++;
+  m->run_histogram[uv__work_bucket(run)]++;
+}
+
+
 void uv__work_done(uv_async_t* handle) {
   struct uv__work* w;
   uv_loop_t* loop;
   struct uv__queue* q;
+  struct uv__queue* next;
   struct uv__queue wq;
   int err;
   int nevents;
 
   loop = container_of(handle, uv_loop_t, wq_async);
-  uv_mutex_lock(&loop->wq_mutex);
-  uv__queue_move(&loop->wq, &wq);
-  uv_mutex_unlock(&loop->wq_mutex);
+
+  /* Take the stack and put it in the order the work finished in. */
+#ifdef _MSC_VER
+  q = InterlockedExchangePointer(&uv__get_internal_fields(loop)->wq_done,
+                                 NULL);
+#else
+  q = atomic_exchange((_Atomic(void*)*) &uv__get_internal_fields(loop)->wq_done,
+                      NULL);
+#endif
+  uv__queue_init(&wq);
+  while (q != NULL) {
+    next = q->prev;
+    uv__queue_insert_head(&wq, q);
+    q = next;
+  }
 
   nevents = 0;
 
   while (!uv__queue_empty(&wq)) {
     q = uv__queue_head(&wq);
     uv__queue_remove(q);
+    uv__queue_init(q);  /* Signal uv_cancel() that it's too late. */
 
     w = container_of(q, struct uv__work, wq);
     err = (w->work == uv__cancelled) ? UV_ECANCELED : 0;
+    uv__work_account(loop, w, err);
     w->done(w, err);
     nevents++;
   }
@@ -369,23 +1506,164 @@ int uv_queue_work(uv_loop_t* loop,
                   uv_work_t* req,
                   uv_work_cb work_cb,
                   uv_after_work_cb after_work_cb) {
+  return uv_queue_work_ex(loop,
+                          req,
+                          work_cb,
+                          after_work_cb,
+                          uv__get_internal_fields(loop)->wq_priority);
+}
+
+
+int uv_queue_work_ex(uv_loop_t* loop,
+                     uv_work_t* req,
+                     uv_work_cb work_cb,
+                     uv_after_work_cb after_work_cb,
+                     uv_work_priority priority) {
   if (work_cb == NULL)
     return UV_EINVAL;
 
+  if (priority < UV_WORK_PRIORITY_CRITICAL ||
+      priority > UV_WORK_PRIORITY_BACKGROUND)
+    return UV_EINVAL;
+
   uv__req_init(loop, req, UV_WORK);
   req->loop = loop;
   req->work_cb = work_cb;
   req->after_work_cb = after_work_cb;
-  uv__work_submit(loop,
-                  &req->work_req,
-                  UV__WORK_CPU,
-                  uv__queue_work,
-                  uv__queue_done);
+  uv__work_submit_priority(loop,
+                           &req->work_req,
+                           UV__WORK_CPU,
+                           uv__queue_work,
+                           uv__queue_done,
+                           priority);
+  return 0;
+}
+
+
+/* Not an active request, the loop doesn't wait for it. */
+int uv_queue_work_detached(uv_loop_t* loop,
+                           uv_work_t* req,
+                           uv_work_cb work_cb) {
+  struct uv__threadpool* pool;
+
+  if (work_cb == NULL)
+    return UV_EINVAL;
+
+  pool = uv__threadpool_get(loop, UV__WORK_CPU);
+  uv__tp_add(&pool->detached, 1);
+
+  UV_REQ_INIT(req, UV_WORK);
+  req->loop = loop;
+  req->work_cb = work_cb;
+  req->after_work_cb = NULL;
+  uv__work_submit(loop, &req->work_req, UV__WORK_CPU, uv__queue_work, NULL);
+  return 0;
+}
+
+
+int uv_queue_work_batch(uv_loop_t* loop,
+                        uv_work_t reqs[],
+                        unsigned int nreqs,
+                        uv_work_cb work_cb,
+                        uv_after_work_cb after_work_cb) {
+  return uv_queue_work_batch_ex(loop,
+                                reqs,
+                                nreqs,
+                                work_cb,
+                                after_work_cb,
+                                uv__get_internal_fields(loop)->wq_priority);
+}
+
+
+int uv_queue_work_batch_ex(uv_loop_t* loop,
+                           uv_work_t reqs[],
+                           unsigned int nreqs,
+                           uv_work_cb work_cb,
+                           uv_after_work_cb after_work_cb,
+                           uv_work_priority priority) {
+  struct uv__worker* wk;
+  struct uv__queue wq;
+  uint64_t now;
+  uv_work_t* req;
+  unsigned int i;
+
+  if (work_cb == NULL || nreqs > INT_MAX)
+    return UV_EINVAL;
+
+  if (priority < UV_WORK_PRIORITY_CRITICAL ||
+      priority > UV_WORK_PRIORITY_BACKGROUND)
+    return UV_EINVAL;
+
+  if (nreqs == 0)
+    return 0;
+
+  wk = uv__work_worker(loop, UV__WORK_CPU);
+  uv__queue_init(&wq);
+  now = uv__work_now(loop);
+
+  for (i = 0; i < nreqs; i++) {
+    req = reqs + i;
+    uv__req_init(loop, req, UV_WORK);
+    req->loop = loop;
+    req->work_cb = work_cb;
+    req->after_work_cb = after_work_cb;
+    req->work_req.loop = loop;
+    req->work_req.work = uv__queue_work;
+    req->work_req.done = uv__queue_done;
+    req->work_req.kind = UV__WORK_CPU;
+    req->work_req.enqueue_time = now;
+    uv__queue_insert_tail(&wq, &req->work_req.wq);
+  }
+
+  post_batch(wk, &wq, nreqs, priority);
+  return 0;
+}
+
+
+int uv_metrics_threadpool(uv_loop_t* loop, uv_threadpool_metrics_t* metrics) {
+  uv_threadpool_kind_metrics_t* m;
+  struct uv__threadpool* pool;
+  int queued;
+  int kind;
+
+  for (kind = UV__WORK_CPU; kind <= UV__WORK_SLOW_IO; kind++) {
+    if (kind == UV__WORK_CPU)
+      m = &metrics->work;
+    else if (kind == UV__WORK_FAST_IO)
+      m = &metrics->fs;
+    else
+      m = &metrics->dns;
+
+    *m = uv__get_internal_fields(loop)->wq_metrics[kind];
+
+    /* Don't start the default pool just to report that it's empty. */
+    pool = uv__get_internal_fields(loop)->wq_pools[kind];
+    if (pool == NULL) {
+      if (!uv__tp_load(&default_pool_started)) {
+        m->queued = 0;
+        m->idle_threads = 0;
+        m->threads = 0;
+        m->slow_io_throttled = 0;
+        continue;
+      }
+      pool = &default_pool;
+    }
+
+    uv_mutex_lock(&pool->mutex);
+    queued = uv__tp_load(&pool->queued);  /* Can briefly be negative. */
+    m->queued = (queued > 0 ? queued : 0) + pool->slow_io_pending;
+    m->idle_threads = pool->idle_threads;
+    m->threads = pool->nrunning;
+    m->slow_io_throttled = pool->slow_io_throttled;
+    uv_mutex_unlock(&pool->mutex);
+  }
+
   return 0;
 }
 
 
 int uv_cancel(uv_req_t* req) {
+  enum uv__work_kind kind;
   struct uv__work* wreq;
   uv_loop_t* loop;
 
@@ -393,26 +1671,31 @@ int uv_cancel(uv_req_t* req) {
   case UV_FS:
     loop =  ((uv_fs_t*) req)->loop;
     wreq = &((uv_fs_t*) req)->work_req;
+    kind = UV__WORK_FAST_IO;
     break;
   case UV_GETADDRINFO:
     loop =  ((uv_getaddrinfo_t*) req)->loop;
     wreq = &((uv_getaddrinfo_t*) req)->work_req;
+    kind = UV__WORK_SLOW_IO;
     break;
   case UV_GETNAMEINFO:
     loop = ((uv_getnameinfo_t*) req)->loop;
     wreq = &((uv_getnameinfo_t*) req)->work_req;
+    kind = UV__WORK_SLOW_IO;
     break;
   case UV_RANDOM:
     loop = ((uv_random_t*) req)->loop;
     wreq = &((uv_random_t*) req)->work_req;
+    kind = UV__WORK_CPU;
     break;
   case UV_WORK:
     loop =  ((uv_work_t*) req)->loop;
     wreq = &((uv_work_t*) req)->work_req;
+    kind = UV__WORK_CPU;
     break;
   default:
     return UV_EINVAL;
   }
 
-  return uv__work_cancel(loop, req, wreq);
+  return uv__work_cancel(loop, req, wreq, kind);
 }
@@ -24,6 +24,34 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* Levels of 64 slots cover 6 bits of the millisecond clock each, all of the
+ * 64 bit range takes 11 of them.
+ */
+#define UV__TIMER_WHEEL_BITS 6
+#define UV__TIMER_WHEEL_SLOTS (1 << UV__TIMER_WHEEL_BITS)
+#define UV__TIMER_WHEEL_LEVELS 11
+
+/* A hierarchical timing wheel, the UV_LOOP_USE_TIMER_WHEEL alternative to the
+ * timer heap. A timer sits at the level of the highest 6 bit group where its
+ * due time differs from |now|, in the slot that group selects. When |now|
+ * enters a slot of a higher level, its timers move down ("cascade"). Slots of
+ * level 0 hold timers that are due at exactly the same time, in start order.
+ *
+ * Active timers are linked through handle->node.queue instead of
+ * handle->node.heap.
+ */
+struct uv__timer_wheel {
+  uint64_t now;  /* Timers due before |now| have expired. */
+  struct uv__queue due;  /* Timers started with a due time before |now|. */
+  uint64_t occupied[UV__TIMER_WHEEL_LEVELS];  /* One bit per non-empty slot. */
+  struct uv__queue slots[UV__TIMER_WHEEL_LEVELS][UV__TIMER_WHEEL_SLOTS];
+};
 
 
 static struct heap *timer_heap(const uv_loop_t* loop) {
@@ -35,23 +63,275 @@ static struct heap *timer_heap(const uv_loop_t* loop) {
 }
 
 
+static struct uv__timer_wheel* timer_wheel(const uv_loop_t* loop) {
+  return uv__get_internal_fields(loop)->timer_wheel;
+}
+
+
+static unsigned timer_wheel_ctz(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+  unsigned long r;
+  _BitScanForward64(&r, x);
+  return r;
+#else
+  unsigned r;
+  for (r = 0; !(x & 1); x >>= 1)
+    r++;
+  return r;
+#endif
+}
+
+
+/* Returns the slot of |timeout| or NULL if the timer belongs on the due list.
+ * Sets |*level| and |*index| to the slot's position.
+ */
+static struct uv__queue* timer_wheel_slot(struct uv__timer_wheel* w,
+                                          uint64_t timeout,
+                                          unsigned* level,
+                                          unsigned* index) {
+  uint64_t x;
+  unsigned l;
+
+  if (timeout < w->now)
+    return NULL;
+
+  l = 0;
+  for (x = timeout ^ w->now;
+       x >> UV__TIMER_WHEEL_BITS;
+       x >>= UV__TIMER_WHEEL_BITS)
+    l++;
+
+  *level = l;
+  *index = (timeout >> (l * UV__TIMER_WHEEL_BITS)) &
+           (UV__TIMER_WHEEL_SLOTS - 1);
+  return &w->slots[l][*index];
+}
+
+
+static void timer_wheel_insert(struct uv__timer_wheel* w, uv_timer_t* handle) {
+  struct uv__queue* slot;
+  unsigned level;
+  unsigned index;
+
+  slot = timer_wheel_slot(w, handle->timeout, &level, &index);
+  if (slot == NULL) {
+    uv__queue_insert_tail(&w->due, &handle->node.queue);
+    return;
+  }
+
+  uv__queue_insert_tail(slot, &handle->node.queue);
+  w->occupied[level] |= (uint64_t) 1 << index;
+}
+
+
+static void timer_wheel_remove(struct uv__timer_wheel* w, uv_timer_t* handle) {
+  struct uv__queue* slot;
+  unsigned level;
+  unsigned index;
+
+  uv__queue_remove(&handle->node.queue);
+
+  slot = timer_wheel_slot(w, handle->timeout, &level, &index);
+  if (slot != NULL && uv__queue_empty(slot))
+    w->occupied[level] &= ~((uint64_t) 1 << index);
+}
+
+
+/* Moves the timers in the slots that |now| has entered down to lower levels.
+ * Must be called whenever |now| changes.
+ */
+static void timer_wheel_cascade(struct uv__timer_wheel* w) {
+  struct uv__queue* q;
+  struct uv__queue queue;
+  unsigned level;
+  unsigned index;
+
+  for (level = UV__TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+    index = (w->now >> (level * UV__TIMER_WHEEL_BITS)) &
+            (UV__TIMER_WHEEL_SLOTS - 1);
+    if (!(w->occupied[level] & ((uint64_t) 1 << index)))
+      continue;
+
+    w->occupied[level] &= ~((uint64_t) 1 << index);
+    uv__queue_move(&w->slots[level][index], &queue);
+
+    while (!uv__queue_empty(&queue)) {
+      q = uv__queue_head(&queue);
+      uv__queue_remove(q);
+      timer_wheel_insert(w, uv__queue_data(q, uv_timer_t, node.queue));
+    }
+  }
+}
+
+
+/* Returns when the first non-empty slot starts, UINT64_MAX if there is none.
+ * That is the exact due time of its timers for level 0 and a lower bound for
+ * the other levels.
+ */
+static uint64_t timer_wheel_next(const struct uv__timer_wheel* w) {
+  uint64_t mask;
+  unsigned shift;
+  unsigned level;
+  unsigned index;
+
+  for (level = 0; level < UV__TIMER_WHEEL_LEVELS; level++) {
+    shift = level * UV__TIMER_WHEEL_BITS;
+    index = (w->now >> shift) & (UV__TIMER_WHEEL_SLOTS - 1);
+
+    /* Timers at higher levels are in later slots than |now|, never in its own
+     * slot: that one cascaded when |now| entered it.
+     */
+    mask = w->occupied[level] >> index;
+    if (level > 0) {
+      mask >>= 1;
+      index++;
+    }
+    if (mask == 0)
+      continue;
+
+    index += timer_wheel_ctz(mask);
+    shift += UV__TIMER_WHEEL_BITS;
+    if (shift >= 64)
+      return (uint64_t) index << (level * UV__TIMER_WHEEL_BITS);
+
+    return (w->now >> shift << shift) |
+           (uint64_t) index << (level * UV__TIMER_WHEEL_BITS);
+  }
+
+  return (uint64_t) -1;
+}
+
+
+/* Stops the timers that are due at |time| and appends them to |ready|, in the
+ * order uv__run_timers() calls them.
+ */
+static void timer_wheel_expire(struct uv__timer_wheel* w,
+                               uint64_t time,
+                               struct uv__queue* ready) {
+  struct uv__queue* slot;
+  uint64_t next;
+
+  if (!uv__queue_empty(&w->due)) {
+    uv__queue_add(ready, &w->due);
+    uv__queue_init(&w->due);
+  }
+
+  while (w->now <= time) {
+    next = timer_wheel_next(w);
+    if (next > time)
+      next = time + 1;
+
+    w->now = next;
+    timer_wheel_cascade(w);
+    if (next > time)
+      break;
+
+    /* |next| is a level 0 due time, or a slot start that just cascaded. */
+    slot = &w->slots[0][next & (UV__TIMER_WHEEL_SLOTS - 1)];
+    if (uv__queue_empty(slot))
+      continue;
+
+    w->occupied[0] &= ~((uint64_t) 1 << (next & (UV__TIMER_WHEEL_SLOTS - 1)));
+    uv__queue_add(ready, slot);
+    uv__queue_init(slot);
+
+    w->now = next + 1;
+    timer_wheel_cascade(w);
+  }
+}
+
+
+int uv__timer_wheel_init(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__timer_wheel* w;
+  unsigned level;
+  unsigned index;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->timer_wheel != NULL)
+    return 0;
+
+  /* The running timers are in the heap. */
+  if (heap_min(timer_heap(loop)) != NULL)
+    return UV_EBUSY;
+
+  w = uv__malloc(sizeof(*w));
+  if (w == NULL)
+    return UV_ENOMEM;
+
+  w->now = loop->time;
+  uv__queue_init(&w->due);
+  for (level = 0; level < UV__TIMER_WHEEL_LEVELS; level++) {
+    w->occupied[level] = 0;
+    for (index = 0; index < UV__TIMER_WHEEL_SLOTS; index++)
+      uv__queue_init(&w->slots[level][index]);
+  }
+
+  lfields->timer_wheel = w;
+  return 0;
+}
+
+
+void uv__timer_wheel_free(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  uv__free(lfields->timer_wheel);
+  lfields->timer_wheel = NULL;
+}
+
+
+/* The heap is ordered by a copy of timeout and start_id that is kept in
+ * handle->u.reserved. uv_timer_start() only updates handle->timeout when an
+ * active timer is pushed further out, and the timer is moved to its new place
+ * once it reaches the top of the heap. The key is therefore a lower bound of
+ * the due time, and the due time of the top timer when they're equal.
+ */
+struct uv__timer_key {
+  uint64_t timeout;
+  uint64_t start_id;
+};
+
+STATIC_ASSERT(sizeof(struct uv__timer_key) <=
+              sizeof(((uv_timer_t*) 0)->u.reserved));
+
+
+static struct uv__timer_key timer_heap_key(const uv_timer_t* handle) {
+  struct uv__timer_key key;
+
+  memcpy(&key, handle->u.reserved, sizeof(key));
+  return key;
+}
+
+
+static void timer_heap_update_key(uv_timer_t* handle) {
+  struct uv__timer_key key;
+
+  key.timeout = handle->timeout;
+  key.start_id = handle->start_id;
+  memcpy(handle->u.reserved, &key, sizeof(key));
+}
+
+
 static int timer_less_than(const struct heap_node* ha,
                            const struct heap_node* hb) {
-  const uv_timer_t* a;
-  const uv_timer_t* b;
+  struct uv__timer_key a;
+  struct uv__timer_key b;
 
-  a = container_of(ha, uv_timer_t, node.heap);
-  b = container_of(hb, uv_timer_t, node.heap);
+  a = timer_heap_key(container_of(ha, uv_timer_t, node.heap));
+  b = timer_heap_key(container_of(hb, uv_timer_t, node.heap));
 
-  if (a->timeout < b->timeout)
+  if (a.timeout < b.timeout)
     return 1;
-  if (b->timeout < a->timeout)
+  if (b.timeout < a.timeout)
     return 0;
 
   /* Compare start_id when both have the same timeout. start_id is
    * allocated with loop->timer_counter in uv_timer_start().
    */
-  return a->start_id < b->start_id;
+  return a.start_id < b.start_id;
 }
 
 
@@ -70,25 +350,57 @@ int uv_timer_start(uv_timer_t* handle,
                    uint64_t timeout,
                    uint64_t repeat) {
   uint64_t clamped_timeout;
+  uint64_t slack;
+  uint64_t rem;
+  int lazy;
+  int err;
 
   if (uv__is_closing(handle) || cb == NULL)
     return UV_EINVAL;
 
-  uv_timer_stop(handle);
-
   clamped_timeout = handle->loop->time + timeout;
   if (clamped_timeout < timeout)
     clamped_timeout = (uint64_t) -1;
 
+  /* Round the due time up to a multiple of the slack, so that timers that
+   * are due close to each other expire in the same loop iteration.
+   */
+  slack = uv__get_internal_fields(handle->loop)->timer_slack;
+  if (slack > 1 && !(handle->flags & UV_HANDLE_TIMER_STRICT)) {
+    rem = clamped_timeout % slack;
+    if (rem != 0 && clamped_timeout <= (uint64_t) -1 - slack)
+      clamped_timeout += slack - rem;
+  }
+
+  /* Pushing out the due time of a timer in the heap, e.g. an idle timeout
+   * that is refreshed on every read, leaves it where it is for now.
+   */
+  lazy = uv__is_active(handle) &&
+         timer_wheel(handle->loop) == NULL &&
+         clamped_timeout > timer_heap_key(handle).timeout;
+
+  if (!lazy)
+    uv_timer_stop(handle);
+
   handle->timer_cb = cb;
   handle->timeout = clamped_timeout;
   handle->repeat = repeat;
   /* start_id is the second index to be compared in timer_less_than() */
   handle->start_id = handle->loop->timer_counter++;
 
-  heap_insert(timer_heap(handle->loop),
-              (struct heap_node*) &handle->node.heap,
-              timer_less_than);
+  if (lazy)
+    return 0;
+
+  if (timer_wheel(handle->loop) != NULL) {
+    timer_wheel_insert(timer_wheel(handle->loop), handle);
+  } else {
+    timer_heap_update_key(handle);
+    err = heap_insert(timer_heap(handle->loop),
+                      (struct heap_node*) &handle->node.heap,
+                      timer_less_than);
+    if (err)
+      return err;
+  }
   uv__handle_start(handle);
 
   return 0;
@@ -97,9 +409,12 @@ int uv_timer_start(uv_timer_t* handle,
 
 int uv_timer_stop(uv_timer_t* handle) {
   if (uv__is_active(handle)) {
-    heap_remove(timer_heap(handle->loop),
-                (struct heap_node*) &handle->node.heap,
-                timer_less_than);
+    if (timer_wheel(handle->loop) != NULL)
+      timer_wheel_remove(timer_wheel(handle->loop), handle);
+    else
+      heap_remove(timer_heap(handle->loop),
+                  (struct heap_node*) &handle->node.heap,
+                  timer_less_than);
     uv__handle_stop(handle);
   } else {
     uv__queue_remove(&handle->node.queue);
@@ -115,7 +430,6 @@ int uv_timer_again(uv_timer_t* handle) {
     return UV_EINVAL;
 
   if (handle->repeat) {
-    uv_timer_stop(handle);
     uv_timer_start(handle, handle->timer_cb, handle->repeat, handle->repeat);
   }
 
@@ -128,6 +442,14 @@ void uv_timer_set_repeat(uv_timer_t* handle, uint64_t repeat) {
 }
 
 
+void uv_timer_set_strict(uv_timer_t* handle, int strict) {
+  if (strict)
+    handle->flags |= UV_HANDLE_TIMER_STRICT;
+  else
+    handle->flags &= ~UV_HANDLE_TIMER_STRICT;
+}
+
+
 uint64_t uv_timer_get_repeat(const uv_timer_t* handle) {
   return handle->repeat;
 }
@@ -142,19 +464,36 @@ uint64_t uv_timer_get_due_in(const uv_timer_t* handle) {
 
 
 int uv__next_timeout(const uv_loop_t* loop) {
+  const struct uv__timer_wheel* w;
   const struct heap_node* heap_node;
   const uv_timer_t* handle;
+  uint64_t timeout;
   uint64_t diff;
 
-  heap_node = heap_min(timer_heap(loop));
-  if (heap_node == NULL)
-    return -1; /* block indefinitely */
+  w = timer_wheel(loop);
+  if (w != NULL) {
+    /* Wakes up early when the first timer is in a higher level slot. It has
+     * cascaded by the time uv__run_timers() returns.
+     */
+    if (!uv__queue_empty(&w->due))
+      return 0;
+
+    timeout = timer_wheel_next(w);
+    if (timeout == (uint64_t) -1)
+      return -1; /* block indefinitely */
+  } else {
+    heap_node = heap_min(timer_heap(loop));
+    if (heap_node == NULL)
+      return -1; /* block indefinitely */
+
+    handle = container_of(heap_node, uv_timer_t, node.heap);
+    timeout = timer_heap_key(handle).timeout;
+  }
 
-  handle = container_of(heap_node, uv_timer_t, node.heap);
-  if (handle->timeout <= loop->time)
+  if (timeout <= loop->time)
     return 0;
 
-  diff = handle->timeout - loop->time;
+  diff = timeout - loop->time;
   if (diff > INT_MAX)
     diff = INT_MAX;
 
@@ -170,17 +509,33 @@ void uv__run_timers(uv_loop_t* loop) {
 
   uv__queue_init(&ready_queue);
 
-  for (;;) {
-    heap_node = heap_min(timer_heap(loop));
-    if (heap_node == NULL)
-      break;
-
-    handle = container_of(heap_node, uv_timer_t, node.heap);
-    if (handle->timeout > loop->time)
-      break;
-
-    uv_timer_stop(handle);
-    uv__queue_insert_tail(&ready_queue, &handle->node.queue);
+  if (timer_wheel(loop) != NULL) {
+    timer_wheel_expire(timer_wheel(loop), loop->time, &ready_queue);
+    uv__queue_foreach(queue_node, &ready_queue) {
+      handle = uv__queue_data(queue_node, uv_timer_t, node.queue);
+      uv__handle_stop(handle);
+    }
+  } else {
+    for (;;) {
+      heap_node = heap_min(timer_heap(loop));
+      if (heap_node == NULL)
+        break;
+
+      handle = container_of(heap_node, uv_timer_t, node.heap);
+      if (timer_heap_key(handle).timeout != handle->timeout) {
+        heap_remove(timer_heap(loop), heap_node, timer_less_than);
+        timer_heap_update_key(handle);
+        /* Can't fail, heap_remove() leaves room for it. */
+        heap_insert(timer_heap(loop), heap_node, timer_less_than);
+        continue;
+      }
+
+      if (handle->timeout > loop->time)
+        break;
+
+      uv_timer_stop(handle);
+      uv__queue_insert_tail(&ready_queue, &handle->node.queue);
+    }
   }
 
   while (!uv__queue_empty(&ready_queue)) {
@@ -40,7 +40,82 @@
 
 static void uv__async_send(uv_loop_t* loop);
 static int uv__async_start(uv_loop_t* loop);
-static void uv__cpu_relax(void);
+
+/* Signalled handles are pushed onto a lock-free stack, linked through
+ * u.reserved[1], and moved to the ready queue of the loop by the loop thread.
+ * The ready queue is linked through u.reserved[2] and u.reserved[3]. That way
+ * uv__async_io() only looks at handles that have been signalled.
+ */
+#define uv__async_next(h) ((h)->u.reserved[1])
+
+/* Number of messages that are passed to the channel callback at once. */
+#define UV__CHANNEL_BATCH 64
+
+/* A bounded multi-producer queue (after Dmitry Vyukov's). The sequence number
+ * of a slot says whose turn it is: |pos| for the producer that claims |pos|,
+ * |pos| + 1 for the loop thread once the message is in it.
+ */
+struct uv__channel_slot {
+  _Atomic size_t seq;
+  void* msg;
+};
+
+struct uv__channel_ring {
+  _Atomic size_t tail;  /* Next slot to claim for producers. */
+  size_t head;  /* Next slot to read, only used by the loop thread. */
+  size_t mask;
+  struct uv__channel_slot* slots;
+};
+
+
+static struct uv__queue* uv__async_ready_node(uv_async_t* handle) {
+  return (struct uv__queue*) &handle->u.reserved[2];
+}
+
+
+static _Atomic(void*)* uv__async_pending(uv_loop_t* loop) {
+  return (_Atomic(void*)*) &uv__get_internal_fields(loop)->async_pending;
+}
+
+
+/* Only the handle that finds the stack empty wakes up the loop, the others
+ * piggyback on that wakeup.
+ */
+static void uv__async_push(uv_async_t* handle) {
+  _Atomic(void*)* head;
+  void* next;
+
+  head = uv__async_pending(handle->loop);
+  next = atomic_load_explicit(head, memory_order_relaxed);
+  do
+    uv__async_next(handle) = next;
+  while (!atomic_compare_exchange_weak(head, &next, handle));
+
+  if (next == NULL)
+    uv__async_send(handle->loop);
+}
+
+
+/* Move the stack to the end of the ready queue. Only call this from the event
+ * loop thread.
+ */
+static void uv__async_drain(uv_loop_t* loop) {
+  struct uv__queue* ready;
+  struct uv__queue* q;
+  uv_async_t* h;
+
+  h = atomic_exchange(uv__async_pending(loop), NULL);
+
+  /* The stack is in reverse order. Insert every handle in front of the one
+   * that was signalled after it.
+   */
+  ready = &uv__get_internal_fields(loop)->async_ready;
+  q = ready;
+  for (; h != NULL; h = uv__async_next(h)) {
+    uv__queue_insert_tail(q, uv__async_ready_node(h));
+    q = uv__async_ready_node(h);
+  }
+}
 
 
 int uv_async_init(uv_loop_t* loop, uv_async_t* handle, uv_async_cb async_cb) {
@@ -76,9 +151,9 @@ int uv_async_send(uv_async_t* handle) {
   /* Set the loop to busy. */
   atomic_fetch_add(busy, 1);
 
-  /* Wake up the other thread's event loop. */
+  /* Queue the handle and wake up the other thread's event loop. */
   if (atomic_exchange(pending, 1) == 0)
-    uv__async_send(handle->loop);
+    uv__async_push(handle);
 
   /* Set the loop to not-busy. */
   atomic_fetch_add(busy, -1);
@@ -87,11 +162,12 @@ int uv_async_send(uv_async_t* handle) {
 }
 
 
-/* Wait for the busy flag to clear before closing.
- * Only call this from the event loop thread. */
-static void uv__async_spin(uv_async_t* handle) {
+/* Wait for the busy flag to clear before closing. Returns the previous value
+ * of the pending flag. Only call this from the event loop thread. */
+static int uv__async_spin(uv_async_t* handle) {
   _Atomic int* pending;
   _Atomic int* busy;
+  int was_pending;
   int i;
 
   pending = (_Atomic int*) &handle->pending;
@@ -99,7 +175,7 @@ static void uv__async_spin(uv_async_t* handle) {
 
   /* Set the pending flag first, so no new events will be added by other
    * threads after this function returns. */
-  atomic_store(pending, 1);
+  was_pending = atomic_exchange(pending, 1);
 
   for (;;) {
     /* 997 is not completely chosen at random. It's a prime number, acyclic by
@@ -107,7 +183,7 @@ static void uv__async_spin(uv_async_t* handle) {
      */
     for (i = 0; i < 997; i++) {
       if (atomic_load(busy) == 0)
-        return;
+        return was_pending;
 
       /* Other thread is busy with this handle, spin until it's done. */
       uv__cpu_relax();
@@ -123,16 +199,179 @@ static void uv__async_spin(uv_async_t* handle) {
 
 
 void uv__async_close(uv_async_t* handle) {
-  uv__async_spin(handle);
+  void* ring;
+
+  /* Producers that come after this see no ring, the ones that are already
+   * inside uv_channel_send() are waited for by uv__async_spin().
+   */
+  ring = NULL;
+  if (handle->flags & UV_HANDLE_ASYNC_CHANNEL)
+    ring = atomic_exchange((_Atomic(void*)*) &((uv_channel_t*) handle)->ring,
+                           NULL);
+
+  /* A pending handle is on the stack or in the ready queue. Unlink it before
+   * the user gets a chance to free it.
+   */
+  if (uv__async_spin(handle)) {
+    uv__async_drain(handle->loop);
+    uv__queue_remove(uv__async_ready_node(handle));
+  }
+
+  /* No producer is inside uv_channel_send() anymore. Messages that have not
+   * been delivered yet are dropped.
+   */
+  uv__free(ring);
+
   uv__queue_remove(&handle->queue);
   uv__handle_stop(handle);
 }
 
 
+static void uv__channel_io(uv_async_t* handle) {
+  struct uv__channel_ring* ring;
+  struct uv__channel_slot* slot;
+  uv_channel_t* channel;
+  void* msgs[UV__CHANNEL_BATCH];
+  unsigned int nmsgs;
+  size_t budget;
+
+  channel = (uv_channel_t*) handle;
+  ring = channel->ring;
+
+  /* Don't let producers that keep the channel full starve the loop, come back
+   * in the next loop iteration after a full round.
+   */
+  for (budget = ring->mask + 1; budget > 0; budget -= nmsgs) {
+    for (nmsgs = 0; nmsgs < budget && nmsgs < UV__CHANNEL_BATCH; nmsgs++) {
+      slot = &ring->slots[ring->head & ring->mask];
+      if (atomic_load(&slot->seq) != ring->head + 1)
+        break;  /* Empty, or the producer is still busy with it. */
+
+      msgs[nmsgs] = slot->msg;
+      atomic_store_explicit(&slot->seq,
+                            ring->head + ring->mask + 1,
+                            memory_order_release);
+      ring->head++;
+    }
+
+    if (nmsgs == 0)
+      return;
+
+    channel->channel_cb(channel, msgs, nmsgs);
+
+    if (uv__is_closing(channel))
+      return;
+  }
+
+  uv_async_send(handle);
+}
+
+
+int uv_channel_init(uv_loop_t* loop,
+                    uv_channel_t* channel,
+                    unsigned int capacity,
+                    uv_channel_cb channel_cb) {
+  struct uv__channel_ring* ring;
+  size_t size;
+  size_t i;
+  int err;
+
+  if (capacity == 0 || capacity > 1u << 30 || channel_cb == NULL)
+    return UV_EINVAL;
+
+  size = 1;
+  while (size < capacity)
+    size *= 2;
+
+  ring = uv__malloc(sizeof(*ring) + size * sizeof(ring->slots[0]));
+  if (ring == NULL)
+    return UV_ENOMEM;
+
+  ring->slots = (struct uv__channel_slot*) (ring + 1);
+  ring->mask = size - 1;
+  ring->head = 0;
+  atomic_init(&ring->tail, 0);
+  for (i = 0; i < size; i++)
+    atomic_init(&ring->slots[i].seq, i);
+
+  err = uv_async_init(loop, (uv_async_t*) channel, uv__channel_io);
+  if (err) {
+    uv__free(ring);
+    return err;
+  }
+
+  channel->flags |= UV_HANDLE_ASYNC_CHANNEL;
+  channel->channel_cb = channel_cb;
+  channel->ring = ring;
+
+  return 0;
+}
+
+
+int uv_channel_send(uv_channel_t* channel, void* msg) {
+  struct uv__channel_ring* ring;
+  struct uv__channel_slot* slot;
+  _Atomic int* pending;
+  _Atomic int* busy;
+  ptrdiff_t diff;
+  size_t pos;
+  int err;
+
+  pending = (_Atomic int*) &channel->pending;
+  busy = (_Atomic int*) &channel->u.fd;
+
+  /* Keep uv_close() from freeing the ring under our feet. Pairs with
+   * uv__async_close(): either it sees us busy and waits, or we see the ring
+   * gone.
+   */
+  atomic_fetch_add(busy, 1);
+  ring = atomic_load((_Atomic(void*)*) &channel->ring);
+  if (ring == NULL) {
+    atomic_fetch_add(busy, -1);
+    return UV_EBADF;
+  }
+
+  err = 0;
+  pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  for (;;) {
+    slot = &ring->slots[pos & ring->mask];
+    diff = (ptrdiff_t) (atomic_load_explicit(&slot->seq, memory_order_acquire) -
+                        pos);
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak(&ring->tail, &pos, pos + 1))
+        break;
+    } else if (diff < 0) {
+      err = UV_EAGAIN;  /* Full. */
+      break;
+    } else {
+      pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    }
+  }
+
+  if (err == 0) {
+    slot->msg = msg;
+    atomic_store(&slot->seq, pos + 1);
+
+    /* Only wake up the loop when the channel isn't pending already. The loop
+     * clears the pending flag before it looks at the slots, the seq_cst store
+     * and load make sure that either it sees the message or we see the flag
+     * cleared.
+     */
+    if (atomic_load(pending) == 0)
+      uv_async_send((uv_async_t*) channel);
+  }
+
+  atomic_fetch_add(busy, -1);
+
+  return err;
+}
+
+
 static void uv__async_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   char buf[1024];
   ssize_t r;
-  struct uv__queue queue;
+  struct uv__queue* ready;
   struct uv__queue* q;
   uv_async_t* h;
   _Atomic int *pending;
@@ -157,13 +396,17 @@ static void uv__async_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
     abort();
   }
 
-  uv__queue_move(&loop->async_handles, &queue);
-  while (!uv__queue_empty(&queue)) {
-    q = uv__queue_head(&queue);
-    h = uv__queue_data(q, uv_async_t, queue);
+  /* Handles that are signalled from now on are pushed onto the stack again
+   * and wake up the loop once more.
+   */
+  uv__async_drain(loop);
+
+  ready = &uv__get_internal_fields(loop)->async_ready;
+  while (!uv__queue_empty(ready)) {
+    q = uv__queue_head(ready);
+    h = container_of((void**) q, uv_async_t, u.reserved[2]);
 
     uv__queue_remove(q);
-    uv__queue_insert_tail(&loop->async_handles, q);
 
     /* Atomically fetch and clear pending flag */
     pending = (_Atomic int*) &h->pending;
@@ -301,6 +544,9 @@ int uv__async_fork(uv_loop_t* loop) {
     h->u.fd = 0;
   }
 
+  uv__get_internal_fields(loop)->async_pending = NULL;
+  uv__queue_init(&uv__get_internal_fields(loop)->async_ready);
+
   /* Recreate these, since they still exist, but belong to the wrong pid now. */
   if (loop->async_wfd != -1) {
     if (loop->async_wfd != loop->async_io_watcher.fd)
@@ -314,16 +560,3 @@ int uv__async_fork(uv_loop_t* loop) {
 
   return uv__async_start(loop);
 }
-
-
-static void uv__cpu_relax(void) {
-#if defined(__i386__) || defined(__x86_64__)
-  __asm__ __volatile__ ("rep; nop" ::: "memory");  /* a.k.a. PAUSE */
-#elif (defined(__arm__) && __ARM_ARCH >= 7) || defined(__aarch64__)
-  __asm__ __volatile__ ("yield" ::: "memory");
-#elif (defined(__ppc__) || defined(__ppc64__)) && defined(__APPLE__)
-  __asm volatile ("" : : : "memory");
-#elif !defined(__APPLE__) && (defined(__powerpc64__) || defined(__ppc64__) || defined(__PPC64__))
-  __asm__ __volatile__ ("or 1,1,1; or 2,2,2" ::: "memory");
-#endif
-}
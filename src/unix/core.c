@@ -163,6 +163,11 @@ void uv_close(uv_handle_t* handle, uv_close_cb close_cb) {
   switch (handle->type) {
   case UV_NAMED_PIPE:
     uv__pipe_close((uv_pipe_t*)handle);
+    /* io_uring operations that are still in flight call
+     * uv__make_close_pending() when they complete.
+     */
+    if (uv__stream_iou_busy((uv_stream_t*)handle))
+      return;
     break;
 
   case UV_TTY:
@@ -171,6 +176,8 @@ void uv_close(uv_handle_t* handle, uv_close_cb close_cb) {
 
   case UV_TCP:
     uv__tcp_close((uv_tcp_t*)handle);
+    if (uv__stream_iou_busy((uv_stream_t*)handle))
+      return;
     break;
 
   case UV_UDP:
@@ -913,8 +920,9 @@ void uv__io_init(uv__io_t* w, uv__io_cb cb, int fd) {
 
 
 void uv__io_start(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
-  assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI)));
-  assert(0 != events);
+  assert(0 == (events &
+               ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI | UV__POLLET)));
+  assert(0 != (events & ~UV__POLLET));
   assert(w->fd >= 0);
   assert(w->fd < INT_MAX);
 
@@ -955,9 +963,11 @@ void uv__io_stop(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
 
   w->pevents &= ~events;
 
-  if (w->pevents == 0) {
+  /* UV__POLLET is a mode, not an event, don't keep it around on its own. */
+  if ((w->pevents & ~UV__POLLET) == 0) {
     uv__queue_remove(&w->watcher_queue);
     uv__queue_init(&w->watcher_queue);
+    w->pevents = 0;
     w->events = 0;
 
     if (w == loop->watchers[w->fd]) {
@@ -965,8 +975,18 @@ void uv__io_stop(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
       loop->watchers[w->fd] = NULL;
       loop->nfds--;
     }
+    return;
   }
-  else if (uv__queue_empty(&w->watcher_queue))
+
+#if !defined(__sun)
+  /* Same as in uv__io_start(), don't touch the backend if the event mask
+   * is unchanged. uv__drain() stops POLLOUT after every write, for example.
+   */
+  if (w->events == w->pevents)
+    return;
+#endif
+
+  if (uv__queue_empty(&w->watcher_queue))
     uv__queue_insert_tail(&loop->watcher_queue, &w->watcher_queue);
 }
 
@@ -1533,6 +1553,12 @@ uv_pid_t uv_os_getppid(void) {
   return getppid();
 }
 
+#ifndef __linux__
+int uv__cpu_numa_node(int cpu) {
+  return 0;
+}
+#endif
+
 int uv_cpumask_size(void) {
 #if UV__CPU_AFFINITY_SUPPORTED
   return CPU_SETSIZE;
@@ -147,6 +147,15 @@ union uv__sockaddr {
 # define UV__POLLPRI 0
 #endif
 
+/* Only the epoll backend supports edge-triggered watchers. The value is that
+ * of EPOLLET, it's passed to epoll_ctl() as-is.
+ */
+#if defined(__linux__)
+# define UV__POLLET 0x80000000u
+#else
+# define UV__POLLET 0
+#endif
+
 #if !defined(O_CLOEXEC) && defined(__FreeBSD__)
 /*
  * It may be that we are just missing `__POSIX_VISIBLE >= 200809`.
@@ -161,7 +170,10 @@ typedef struct uv__stream_queued_fds_s uv__stream_queued_fds_t;
 enum {
   UV_LOOP_BLOCK_SIGPROF = 0x1,
   UV_LOOP_REAP_CHILDREN = 0x2,
-  UV_LOOP_ENABLE_IO_URING_SQPOLL = 0x4
+  UV_LOOP_ENABLE_IO_URING_SQPOLL = 0x4,
+  UV_LOOP_ENABLE_IO_URING_POLL = 0x8,
+  UV_LOOP_ENABLE_EDGE_TRIGGERED_STREAMS = 0x10,
+  UV_LOOP_ENABLE_IO_URING_STREAMS = 0x20
 };
 
 /* flags of excluding ifaddr */
@@ -357,6 +369,28 @@ int uv__iou_fs_statx(uv_loop_t* loop,
                      int is_lstat);
 int uv__iou_fs_symlink(uv_loop_t* loop, uv_fs_t* req);
 int uv__iou_fs_unlink(uv_loop_t* loop, uv_fs_t* req);
+int uv__iou_poll_init(uv_loop_t* loop);
+int uv__iou_stream_init(uv_loop_t* loop);
+int uv__iou_stream_recv(uv_stream_t* stream, void* buf, size_t len);
+int uv__iou_stream_accept(uv_stream_t* stream);
+int uv__iou_pbuf_init(uv_loop_t* loop, unsigned int count, unsigned int size);
+size_t uv__iou_pbuf_size(uv_loop_t* loop);
+unsigned int uv__iou_pbuf_avail(uv_loop_t* loop);
+struct uv__queue* uv__iou_pbuf_waiters(uv_loop_t* loop);
+int uv__iou_pbuf_release(uv_loop_t* loop, const char* base);
+int uv__iou_stream_sendmsg(uv_stream_t* stream,
+                           uv_write_t* req,
+                           const struct msghdr* msg,
+                           int zerocopy);
+int uv__iou_stream_zerocopy(void);
+void uv__iou_stream_cancel(uv_stream_t* stream, uv_write_t* req);
+int uv__stream_iou_busy(uv_stream_t* stream);
+void uv__stream_iou_recv_done(uv_stream_t* stream, int res, char* buf);
+void uv__stream_iou_accept_done(uv_stream_t* stream, int res, int more);
+int uv__stream_iou_listen(uv_stream_t* stream);
+void uv__stream_iou_send_done(uv_write_t* req, int res, int more);
+void uv__stream_iou_send_notif(uv_write_t* req);
+int uv__stream_iou_zerocopy(uv_stream_t* stream, int enable, size_t threshold);
 #else
 #define uv__iou_fs_close(loop, req) 0
 #define uv__iou_fs_ftruncate(loop, req) 0
@@ -369,6 +403,9 @@ int uv__iou_fs_unlink(uv_loop_t* loop, uv_fs_t* req);
 #define uv__iou_fs_statx(loop, req, is_fstat, is_lstat) 0
 #define uv__iou_fs_symlink(loop, req) 0
 #define uv__iou_fs_unlink(loop, req) 0
+#define uv__stream_iou_busy(stream) 0
+#define uv__stream_iou_listen(stream) UV_ENOSYS
+#define uv__stream_iou_zerocopy(stream, enable, threshold) UV_ENOTSUP
 #endif
 
 #if defined(__APPLE__)
@@ -132,6 +132,7 @@ enum {
 enum {
   UV__IORING_FEAT_SINGLE_MMAP = 1u,
   UV__IORING_FEAT_NODROP = 2u,
+  UV__IORING_FEAT_EXT_ARG = 256u,  /* linux v5.11 */
   UV__IORING_FEAT_RSRC_TAGS = 1024u,  /* linux v5.13 */
 };
 
@@ -139,21 +140,30 @@ enum {
   UV__IORING_OP_READV = 1,
   UV__IORING_OP_WRITEV = 2,
   UV__IORING_OP_FSYNC = 3,
+  UV__IORING_OP_POLL_ADD = 6,
+  UV__IORING_OP_POLL_REMOVE = 7,
+  UV__IORING_OP_SENDMSG = 9,
+  UV__IORING_OP_ACCEPT = 13,
+  UV__IORING_OP_ASYNC_CANCEL = 14,
   UV__IORING_OP_OPENAT = 18,
   UV__IORING_OP_CLOSE = 19,
   UV__IORING_OP_STATX = 21,
+  UV__IORING_OP_RECV = 27,
   UV__IORING_OP_EPOLL_CTL = 29,
   UV__IORING_OP_RENAMEAT = 35,
   UV__IORING_OP_UNLINKAT = 36,
   UV__IORING_OP_MKDIRAT = 37,
   UV__IORING_OP_SYMLINKAT = 38,
   UV__IORING_OP_LINKAT = 39,
+  UV__IORING_OP_SENDMSG_ZC = 48,
   UV__IORING_OP_FTRUNCATE = 55,
 };
 
 enum {
   UV__IORING_ENTER_GETEVENTS = 1u,
   UV__IORING_ENTER_SQ_WAKEUP = 2u,
+  UV__IORING_ENTER_SQ_WAIT = 4u,
+  UV__IORING_ENTER_EXT_ARG = 8u,
 };
 
 enum {
@@ -161,6 +171,25 @@ enum {
   UV__IORING_SQ_CQ_OVERFLOW = 2u,
 };
 
+enum {
+  UV__IOSQE_BUFFER_SELECT = 32u,
+};
+
+enum {
+  UV__IORING_CQE_F_BUFFER = 1u,
+  UV__IORING_CQE_F_MORE = 2u,
+  UV__IORING_CQE_F_NOTIF = 8u,
+  UV__IORING_CQE_BUFFER_SHIFT = 16,
+};
+
+enum {
+  UV__IORING_ACCEPT_MULTISHOT = 1u,  /* linux v5.19 */
+};
+
+enum {
+  UV__IORING_REGISTER_PBUF_RING = 22,  /* linux v5.19 */
+};
+
 struct uv__io_cqring_offsets {
   uint32_t head;
   uint32_t tail;
@@ -214,10 +243,14 @@ struct uv__io_uring_sqe {
     uint32_t fsync_flags;
     uint32_t open_flags;
     uint32_t statx_flags;
+    uint32_t poll32_events;
+    uint32_t msg_flags;
+    uint32_t accept_flags;
   };
   uint64_t user_data;
   union {
     uint16_t buf_index;
+    uint16_t buf_group;
     uint64_t pad[3];
   };
 };
@@ -250,6 +283,75 @@ STATIC_ASSERT(40 + 40 + 40 == sizeof(struct uv__io_uring_params));
 STATIC_ASSERT(40 == offsetof(struct uv__io_uring_params, sq_off));
 STATIC_ASSERT(80 == offsetof(struct uv__io_uring_params, cq_off));
 
+struct uv__io_uring_getevents_arg {
+  uint64_t sigmask;
+  uint32_t sigmask_sz;
+  uint32_t pad;
+  uint64_t ts;  /* struct __kernel_timespec* */
+};
+
+STATIC_ASSERT(24 == sizeof(struct uv__io_uring_getevents_arg));
+
+struct uv__kernel_timespec {
+  int64_t tv_sec;
+  long long tv_nsec;
+};
+
+STATIC_ASSERT(16 == sizeof(struct uv__kernel_timespec));
+
+/* An entry of a provided buffer ring. The kernel reads the ring's tail from
+ * the |resv| field of the first entry.
+ */
+struct uv__io_uring_buf {
+  uint64_t addr;
+  uint32_t len;
+  uint16_t bid;
+  uint16_t resv;
+};
+
+STATIC_ASSERT(16 == sizeof(struct uv__io_uring_buf));
+
+struct uv__io_uring_buf_reg {
+  uint64_t ring_addr;
+  uint32_t ring_entries;
+  uint16_t bgid;
+  uint16_t flags;
+  uint64_t resv[3];
+};
+
+STATIC_ASSERT(40 == sizeof(struct uv__io_uring_buf_reg));
+
+/* Buffers that io_uring streams receive into, see uv__iou_pbuf_init(). They
+ * are handed out in order of |bid| and the memory of buffer |bid| starts at
+ * |slab| + |bid| * |size|.
+ */
+struct uv__iou_pbuf {
+  struct uv__io_uring_buf* ring;
+  char* slab;
+  unsigned char* held;  /* Per buffer, 1 if taken out of the ring. */
+  struct uv__queue waiters;  /* Streams waiting for a buffer. */
+  size_t ringlen;
+  size_t slablen;
+  size_t size;
+  uint32_t count;
+  uint32_t navail;
+  uint16_t tail;
+  int registered;
+};
+
+/* The low bits of a SQE's user_data field tell uv__poll_io_uring() and
+ * uv__io_poll_iou() what kind of operation completed. Requests and handles are
+ * at least four byte aligned so a pointer to a uv_fs_t or uv_write_t carries
+ * an implicit tag of zero.
+ */
+enum {
+  UV__IOU_TAG_REQ = 0,
+  UV__IOU_TAG_POLL = 1,
+  UV__IOU_TAG_IGNORE = 2,
+  UV__IOU_TAG_HANDLE = 3,  /* Receive into a uv_stream_t. */
+  UV__IOU_TAG_MASK = 3,
+};
+
 STATIC_ASSERT(EPOLL_CTL_ADD < 4);
 STATIC_ASSERT(EPOLL_CTL_DEL < 4);
 STATIC_ASSERT(EPOLL_CTL_MOD < 4);
@@ -286,6 +388,12 @@ static void uv__epoll_ctl_prep(int epollfd,
                                int fd,
                                struct epoll_event* e);
 
+static void uv__iou_flush(struct uv__iou* iou);
+static void uv__iou_poll_cancel(uv_loop_t* loop, struct uv__iou* iou, int fd);
+static int uv__iou_ring_init(uv_loop_t* loop);
+static int uv__iou_pbuf_register(uv_loop_t* loop, struct uv__iou_pbuf* p);
+static void uv__iou_pbuf_delete(struct uv__iou_pbuf* p);
+
 RB_GENERATE_STATIC(watcher_root, watcher_list, entry, compare_watchers)
 
 
@@ -450,6 +558,20 @@ int uv__io_uring_enter(int fd,
 }
 
 
+static int uv__io_uring_getevents(int fd,
+                                  unsigned to_submit,
+                                  unsigned min_complete,
+                                  struct uv__io_uring_getevents_arg* arg) {
+  return syscall(__NR_io_uring_enter,
+                 fd,
+                 to_submit,
+                 min_complete,
+                 UV__IORING_ENTER_GETEVENTS | UV__IORING_ENTER_EXT_ARG,
+                 arg,
+                 sizeof(*arg));
+}
+
+
 int uv__io_uring_register(int fd, unsigned opcode, void* arg, unsigned nargs) {
   return syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
 }
@@ -641,6 +763,8 @@ int uv__platform_loop_init(uv_loop_t* loop) {
   lfields = uv__get_internal_fields(loop);
   lfields->ctl.ringfd = -1;
   lfields->iou.ringfd = -2;  /* "uninitialized" */
+  lfields->iou_polls = NULL;
+  lfields->niou_polls = 0;
 
   loop->inotify_watchers = NULL;
   loop->inotify_fd = -1;
@@ -656,10 +780,23 @@ int uv__platform_loop_init(uv_loop_t* loop) {
 
 
 int uv__io_fork(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__iou_pbuf* pbuf;
   int err;
+  int use_iou_poll;
+  int use_iou_streams;
   struct watcher_list* root;
 
+  /* Keep the provided buffers, the application may still hold some. */
+  lfields = uv__get_internal_fields(loop);
+  pbuf = lfields->iou_pbuf;
+  lfields->iou_pbuf = NULL;
+
   root = uv__inotify_watchers(loop)->rbh_root;
+  use_iou_poll = loop->flags & UV_LOOP_ENABLE_IO_URING_POLL;
+  use_iou_streams = loop->flags & UV_LOOP_ENABLE_IO_URING_STREAMS;
+  loop->flags &= ~(UV_LOOP_ENABLE_IO_URING_POLL |
+                   UV_LOOP_ENABLE_IO_URING_STREAMS);
 
   uv__close(loop->backend_fd);
   loop->backend_fd = -1;
@@ -671,6 +808,20 @@ int uv__io_fork(uv_loop_t* loop) {
   if (err)
     return err;
 
+  /* Falls back to epoll if the child can't set up a new ring. */
+  if (use_iou_poll)
+    uv__iou_poll_init(loop);
+
+  if (use_iou_streams)
+    uv__iou_stream_init(loop);
+
+  if (pbuf != NULL) {
+    pbuf->registered = 0;
+    lfields->iou_pbuf = pbuf;
+    if (uv__iou_ring_init(loop) == 0)
+      uv__iou_pbuf_register(loop, pbuf);
+  }
+
   return uv__inotify_fork(loop, root);
 }
 
@@ -681,6 +832,12 @@ void uv__platform_loop_delete(uv_loop_t* loop) {
   lfields = uv__get_internal_fields(loop);
   uv__iou_delete(&lfields->ctl);
   uv__iou_delete(&lfields->iou);
+  if (lfields->iou_pbuf != NULL)
+    uv__iou_pbuf_delete(lfields->iou_pbuf);
+  lfields->iou_pbuf = NULL;
+  uv__free(lfields->iou_polls);
+  lfields->iou_polls = NULL;
+  lfields->niou_polls = 0;
 
   if (loop->inotify_fd != -1) {
     uv__io_stop(loop, &loop->inotify_read_watcher, POLLIN);
@@ -712,6 +869,18 @@ void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
       if (inv->events[i].data.fd == fd)
         inv->events[i].data.fd = -1;
 
+  /* Cancel the outstanding poll, if any. Completions that are already in
+   * the completion ring are recognized as stale by uv__io_poll_iou().
+   *
+   * Submit the cancellation right away because the poll holds a reference
+   * to the file; a listen socket would otherwise stay bound to its port
+   * until the next loop iteration.
+   */
+  if (loop->flags & UV_LOOP_ENABLE_IO_URING_POLL) {
+    uv__iou_poll_cancel(loop, &lfields->iou, fd);
+    uv__iou_flush(&lfields->iou);
+  }
+
   /* Remove the file descriptor from the epoll.
    * This avoids a problem where the same file description remains open
    * in another process, causing repeated junk epoll events.
@@ -778,50 +947,611 @@ static struct uv__io_uring_sqe* uv__iou_get_sqe(struct uv__iou* iou,
       iou->ringfd = -1;  /* "failed" */
   }
 
-  if (iou->ringfd == -1)
+  if (iou->ringfd == -1)
+    return NULL;
+
+  head = atomic_load_explicit((_Atomic uint32_t*) iou->sqhead,
+                              memory_order_acquire);
+  tail = *iou->sqtail;
+  mask = iou->sqmask;
+
+  if ((head & mask) == ((tail + 1) & mask))
+    return NULL;  /* No room in ring buffer. TODO(bnoordhuis) maybe flush it? */
+
+  slot = tail & mask;
+  sqe = iou->sqe;
+  sqe = &sqe[slot];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->user_data = (uintptr_t) req;
+
+  /* Pacify uv_cancel(). */
+  req->work_req.loop = loop;
+  req->work_req.work = NULL;
+  req->work_req.done = NULL;
+  uv__queue_init(&req->work_req.wq);
+
+  uv__req_register(loop);
+  iou->in_flight++;
+
+  return sqe;
+}
+
+
+static void uv__iou_submit(struct uv__iou* iou) {
+  uint32_t flags;
+
+  atomic_store_explicit((_Atomic uint32_t*) iou->sqtail,
+                        *iou->sqtail + 1,
+                        memory_order_release);
+
+  flags = atomic_load_explicit((_Atomic uint32_t*) iou->sqflags,
+                               memory_order_acquire);
+
+  if (flags & UV__IORING_SQ_NEED_WAKEUP)
+    if (uv__io_uring_enter(iou->ringfd, 0, 0, UV__IORING_ENTER_SQ_WAKEUP))
+      if (errno != EOWNERDEAD)  /* Kernel bug. Harmless, ignore. */
+        perror("libuv: io_uring_enter(wakeup)");  /* Can't happen. */
+}
+
+
+/* Submits pending entries or, when the ring is serviced by a SQPOLL thread,
+ * wakes up the thread and waits for it to make room in the submission ring.
+ */
+static void uv__iou_flush(struct uv__iou* iou) {
+  uint32_t head;
+  int rc;
+
+  head = atomic_load_explicit((_Atomic uint32_t*) iou->sqhead,
+                              memory_order_acquire);
+
+  do
+    rc = uv__io_uring_enter(iou->ringfd,
+                            *iou->sqtail - head,
+                            0,
+                            UV__IORING_ENTER_SQ_WAKEUP |
+                            UV__IORING_ENTER_SQ_WAIT);
+  while (rc == -1 && errno == EINTR);
+
+  if (rc == -1 && errno != EBUSY && errno != EAGAIN)
+    perror("libuv: io_uring_enter(submit)");  /* Can't happen. */
+}
+
+
+/* Like uv__iou_get_sqe() but for internal operations that aren't tied to
+ * a request. Flushes the submission ring when it's full instead of failing.
+ */
+static struct uv__io_uring_sqe* uv__iou_get_internal_sqe(struct uv__iou* iou) {
+  struct uv__io_uring_sqe* sqe;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t mask;
+
+  assert(iou->ringfd >= 0);
+
+  mask = iou->sqmask;
+
+  for (;;) {
+    head = atomic_load_explicit((_Atomic uint32_t*) iou->sqhead,
+                                memory_order_acquire);
+    tail = *iou->sqtail;
+
+    if ((head & mask) != ((tail + 1) & mask))
+      break;
+
+    uv__iou_flush(iou);
+  }
+
+  sqe = iou->sqe;
+  sqe = &sqe[tail & mask];
+  memset(sqe, 0, sizeof(*sqe));
+
+  return sqe;
+}
+
+
+static void uv__iou_poll_cancel(uv_loop_t* loop, struct uv__iou* iou, int fd) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__io_uring_sqe* sqe;
+
+  lfields = uv__get_internal_fields(loop);
+
+  if ((unsigned) fd >= lfields->niou_polls)
+    return;
+
+  if (lfields->iou_polls[fd] == 0)
+    return;
+
+  sqe = uv__iou_get_internal_sqe(iou);
+  sqe->addr = lfields->iou_polls[fd];
+  sqe->opcode = UV__IORING_OP_POLL_REMOVE;
+  sqe->user_data = UV__IOU_TAG_IGNORE;
+  uv__iou_submit(iou);
+
+  lfields->iou_polls[fd] = 0;
+}
+
+
+/* Arms a one-shot poll for the watcher's current event mask. Multishot polls
+ * only post a completion when the file's wait queue is woken up, i.e., they
+ * are edge-triggered, whereas libuv expects level-triggered semantics: for
+ * example, uv__server_io() accepts only one connection per event. A one-shot
+ * poll checks for readiness when it's armed, and the SQE that rearms it goes
+ * out with the io_uring_enter() call that waits for the next batch of events,
+ * so it doesn't cost an extra system call.
+ */
+static void uv__iou_poll_arm(uv_loop_t* loop,
+                             struct uv__iou* iou,
+                             uv__io_t* w) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__io_uring_sqe* sqe;
+  uint64_t* polls;
+  uint32_t events;
+  unsigned int n;
+
+  lfields = uv__get_internal_fields(loop);
+
+  if ((unsigned) w->fd >= lfields->niou_polls) {
+    n = loop->nwatchers;
+    assert((unsigned) w->fd < n);
+
+    polls = uv__reallocf(lfields->iou_polls, n * sizeof(*polls));
+    if (polls == NULL)
+      abort();
+
+    memset(polls + lfields->niou_polls,
+           0,
+           (n - lfields->niou_polls) * sizeof(*polls));
+
+    lfields->iou_polls = polls;
+    lfields->niou_polls = n;
+  }
+
+  uv__iou_poll_cancel(loop, iou, w->fd);
+
+  /* One-shot polls check for readiness when they're armed, edge-triggered
+   * watchers work as-is as long as UV__POLLET isn't passed on to the kernel.
+   */
+  events = w->pevents & ~UV__POLLET;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  events = events << 16 | events >> 16;  /* Kernel expects swapped halves. */
+#endif
+
+  sqe = uv__iou_get_internal_sqe(iou);
+  sqe->fd = w->fd;
+  sqe->opcode = UV__IORING_OP_POLL_ADD;
+  sqe->poll32_events = events;
+  sqe->user_data = (uint64_t) ++lfields->iou_pollgen << 34 |
+                   (uint64_t) w->fd << 2 |
+                   UV__IOU_TAG_POLL;
+  uv__iou_submit(iou);
+
+  lfields->iou_polls[w->fd] = sqe->user_data;
+  w->events = w->pevents;
+}
+
+
+/* Sets up the ring that the io_uring poll backend and io_uring streams use.
+ * Returns UV_ENOSYS if io_uring isn't available.
+ */
+static int uv__iou_ring_init(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct epoll_event e;
+  struct uv__iou* iou;
+
+  lfields = uv__get_internal_fields(loop);
+  iou = &lfields->iou;
+
+  /* Reuse the SQPOLL ring if it exists already. */
+  if (iou->ringfd == -2) {
+    if (loop->flags & UV_LOOP_ENABLE_IO_URING_SQPOLL)
+      uv__iou_init(loop->backend_fd, iou, 1024, UV__IORING_SETUP_SQPOLL);
+    else
+      uv__iou_init(loop->backend_fd, iou, 1024, 0);
+
+    if (iou->ringfd == -2)
+      iou->ringfd = -1;  /* "failed" */
+
+    /* Keep uv_backend_fd() working for embedders: the epoll file descriptor
+     * becomes readable when there are completions to reap. The SQPOLL ring
+     * is already watched by uv__iou_init().
+     */
+    if (iou->ringfd >= 0 && !(loop->flags & UV_LOOP_ENABLE_IO_URING_SQPOLL)) {
+      memset(&e, 0, sizeof(e));
+      e.events = POLLIN;
+      e.data.fd = iou->ringfd;
+
+      if (epoll_ctl(loop->backend_fd, EPOLL_CTL_ADD, iou->ringfd, &e)) {
+        uv__iou_delete(iou);
+        iou->ringfd = -1;
+      }
+    }
+  }
+
+  if (iou->ringfd == -1)
+    return UV_ENOSYS;
+
+  return 0;
+}
+
+
+int uv__iou_poll_init(uv_loop_t* loop) {
+  struct epoll_event e;
+  unsigned int i;
+  uv__io_t* w;
+
+  if (loop->flags & UV_LOOP_ENABLE_IO_URING_POLL)
+    return 0;
+
+  if (uv__iou_ring_init(loop))
+    return UV_ENOSYS;
+
+  /* Move file descriptors that epoll is watching over to the ring. */
+  memset(&e, 0, sizeof(e));
+  for (i = 0; i < loop->nwatchers; i++) {
+    w = loop->watchers[i];
+    if (w == NULL || w->events == 0)
+      continue;
+
+    epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, w->fd, &e);
+    w->events = 0;
+
+    if (uv__queue_empty(&w->watcher_queue))
+      uv__queue_insert_tail(&loop->watcher_queue, &w->watcher_queue);
+  }
+
+  loop->flags |= UV_LOOP_ENABLE_IO_URING_POLL;
+
+  return 0;
+}
+
+
+int uv__iou_stream_init(uv_loop_t* loop) {
+  if (uv__iou_ring_init(loop))
+    return UV_ENOSYS;
+
+  loop->flags |= UV_LOOP_ENABLE_IO_URING_STREAMS;
+
+  return 0;
+}
+
+
+/* The ring keeps a reference to the socket, closing the file descriptor
+ * doesn't end the receive. The caller must wait for the completion before
+ * it releases |buf|, see uv__stream_iou_recv_done(). When |buf| is NULL, the
+ * kernel picks a buffer from the loop's provided buffer ring.
+ */
+int uv__iou_stream_recv(uv_stream_t* stream, void* buf, size_t len) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou* iou;
+
+  iou = &uv__get_internal_fields(stream->loop)->iou;
+
+  if (iou->ringfd < 0)
+    return UV_ENOSYS;
+
+  sqe = uv__iou_get_internal_sqe(iou);
+  sqe->addr = (uintptr_t) buf;
+  sqe->fd = uv__stream_fd(stream);
+  sqe->len = len;
+  sqe->opcode = UV__IORING_OP_RECV;
+
+  if (buf == NULL) {
+    sqe->flags = UV__IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->len = 0;  /* Up to the size of the buffer. */
+  }
+
+  sqe->user_data = (uintptr_t) stream | UV__IOU_TAG_HANDLE;
+
+  uv__iou_submit(iou);
+  iou->in_flight++;
+
+  return 0;
+}
+
+
+/* |msg| must stay valid until the completion arrives: with SQPOLL, the kernel
+ * doesn't look at it before the submission thread picks up the SQE.
+ *
+ * A zero-copy send posts a second completion, flagged UV__IORING_CQE_F_NOTIF,
+ * once the kernel no longer references the buffers, provided that the first
+ * one has UV__IORING_CQE_F_MORE set.
+ */
+int uv__iou_stream_sendmsg(uv_stream_t* stream,
+                           uv_write_t* req,
+                           const struct msghdr* msg,
+                           int zerocopy) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou* iou;
+
+  iou = &uv__get_internal_fields(stream->loop)->iou;
+
+  if (iou->ringfd < 0)
+    return UV_ENOSYS;
+
+  sqe = uv__iou_get_internal_sqe(iou);
+  sqe->addr = (uintptr_t) msg;
+  sqe->fd = uv__stream_fd(stream);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->opcode = UV__IORING_OP_SENDMSG;
+  sqe->user_data = (uintptr_t) req;
+
+  if (zerocopy)
+    sqe->opcode = UV__IORING_OP_SENDMSG_ZC;
+
+  uv__iou_submit(iou);
+  iou->in_flight++;
+
+  return 0;
+}
+
+
+/* Starts a multishot accept on the listen socket |stream|. It posts a
+ * completion for every incoming connection until it fails or is cancelled;
+ * the last completion lacks UV__IORING_CQE_F_MORE. Kernels that don't
+ * support it fail the first completion with UV_EINVAL.
+ */
+int uv__iou_stream_accept(uv_stream_t* stream) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou* iou;
+
+  iou = &uv__get_internal_fields(stream->loop)->iou;
+
+  if (iou->ringfd < 0)
+    return UV_ENOSYS;
+
+  sqe = uv__iou_get_internal_sqe(iou);
+  sqe->accept_flags = SOCK_CLOEXEC | SOCK_NONBLOCK;
+  sqe->fd = uv__stream_fd(stream);
+  sqe->ioprio = UV__IORING_ACCEPT_MULTISHOT;
+  sqe->opcode = UV__IORING_OP_ACCEPT;
+  sqe->user_data = (uintptr_t) stream | UV__IOU_TAG_HANDLE;
+
+  uv__iou_submit(iou);
+  iou->in_flight++;
+
+  return 0;
+}
+
+
+/* Returns 0 if uv__iou_stream_sendmsg() can do zero-copy sends. */
+int uv__iou_stream_zerocopy(void) {
+  /* IORING_OP_SENDMSG_ZC first appeared in linux v6.1. */
+  if (uv__kernel_version() < /* 6.1.0 */ 0x060100)
+    return UV_ENOTSUP;
+
+  return 0;
+}
+
+
+/* Cancels the stream's in-flight send |req| or, when |req| is NULL, its
+ * receive or accept. The operation still posts a completion, usually with
+ * -ECANCELED. Submitted right away because the stream is about to close its
+ * socket.
+ */
+void uv__iou_stream_cancel(uv_stream_t* stream, uv_write_t* req) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou* iou;
+
+  iou = &uv__get_internal_fields(stream->loop)->iou;
+
+  sqe = uv__iou_get_internal_sqe(iou);
+  sqe->addr = (uintptr_t) stream | UV__IOU_TAG_HANDLE;
+  if (req != NULL)
+    sqe->addr = (uintptr_t) req;
+  sqe->opcode = UV__IORING_OP_ASYNC_CANCEL;
+  sqe->user_data = UV__IOU_TAG_IGNORE;
+
+  uv__iou_submit(iou);
+  uv__iou_flush(iou);
+}
+
+
+static void uv__iou_pbuf_put(struct uv__iou_pbuf* p, uint16_t bid) {
+  struct uv__io_uring_buf* b;
+
+  b = &p->ring[p->tail & (p->count - 1)];
+  b->addr = (uintptr_t) (p->slab + bid * p->size);
+  b->len = p->size;
+  b->bid = bid;
+
+  p->tail++;
+  p->navail++;
+  atomic_store_explicit((_Atomic uint16_t*) &p->ring[0].resv,
+                        p->tail,
+                        memory_order_release);
+}
+
+
+/* Registers the ring with buffer group 0 of the loop's io_uring instance and
+ * fills it with the buffers that aren't taken. Also used after fork().
+ */
+static int uv__iou_pbuf_register(uv_loop_t* loop, struct uv__iou_pbuf* p) {
+  struct uv__io_uring_buf_reg reg;
+  struct uv__iou* iou;
+  uint32_t i;
+
+  iou = &uv__get_internal_fields(loop)->iou;
+
+  p->tail = 0;
+  p->navail = 0;
+  atomic_store_explicit((_Atomic uint16_t*) &p->ring[0].resv,
+                        0,
+                        memory_order_relaxed);
+
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uintptr_t) p->ring;
+  reg.ring_entries = p->count;
+  reg.bgid = 0;
+
+  if (uv__io_uring_register(iou->ringfd,
+                            UV__IORING_REGISTER_PBUF_RING,
+                            &reg,
+                            1)) {
+    return UV__ERR(errno);
+  }
+
+  for (i = 0; i < p->count; i++)
+    if (!p->held[i])
+      uv__iou_pbuf_put(p, i);
+
+  p->registered = 1;
+
+  return 0;
+}
+
+
+static void uv__iou_pbuf_delete(struct uv__iou_pbuf* p) {
+  if (p->slab != MAP_FAILED)
+    munmap(p->slab, p->slablen);
+  if (p->ring != MAP_FAILED)
+    munmap(p->ring, p->ringlen);
+  uv__free(p->held);
+  uv__free(p);
+}
+
+
+int uv__iou_pbuf_init(uv_loop_t* loop, unsigned int count, unsigned int size) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__iou_pbuf* p;
+  int err;
+
+  /* The kernel wants a power of two, bids are 16 bits. */
+  if (count == 0 || count > 32768 || (count & (count - 1)))
+    return UV_EINVAL;
+
+  if (size == 0 || size > INT32_MAX || (size_t) count * size > SIZE_MAX / 2)
+    return UV_EINVAL;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->iou_pbuf != NULL)
+    return UV_EBUSY;
+
+  if (uv__iou_ring_init(loop))
+    return UV_ENOSYS;
+
+  p = uv__calloc(1, sizeof(*p));
+  if (p == NULL)
+    return UV_ENOMEM;
+
+  uv__queue_init(&p->waiters);
+  p->count = count;
+  p->size = size;
+  p->ringlen = count * sizeof(*p->ring);
+  p->slablen = (size_t) count * size;
+  p->held = uv__calloc(count, sizeof(*p->held));
+  p->ring = mmap(NULL,
+                 p->ringlen,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS,
+                 -1,
+                 0);
+  p->slab = mmap(NULL,
+                 p->slablen,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS,
+                 -1,
+                 0);
+
+  if (p->held == NULL || p->ring == MAP_FAILED || p->slab == MAP_FAILED) {
+    uv__iou_pbuf_delete(p);
+    return UV_ENOMEM;
+  }
+
+  err = uv__iou_pbuf_register(loop, p);
+  if (err) {
+    uv__iou_pbuf_delete(p);
+    return err == UV_EINVAL ? UV_ENOSYS : err;  /* EINVAL: pre-5.19 kernel. */
+  }
+
+  lfields->iou_pbuf = p;
+
+  return 0;
+}
+
+
+/* Returns the size of the loop's provided buffers, or 0 if there are none. */
+size_t uv__iou_pbuf_size(uv_loop_t* loop) {
+  struct uv__iou_pbuf* p;
+
+  p = uv__get_internal_fields(loop)->iou_pbuf;
+  if (p == NULL || !p->registered)
+    return 0;
+
+  return p->size;
+}
+
+
+/* Number of buffers that are in the ring, 0 means receives fail with
+ * UV_ENOBUFS. Streams can wait for a buffer on uv__iou_pbuf_waiters().
+ */
+unsigned int uv__iou_pbuf_avail(uv_loop_t* loop) {
+  struct uv__iou_pbuf* p;
+
+  p = uv__get_internal_fields(loop)->iou_pbuf;
+  if (p == NULL)
+    return 0;
+
+  return p->navail;
+}
+
+
+struct uv__queue* uv__iou_pbuf_waiters(uv_loop_t* loop) {
+  struct uv__iou_pbuf* p;
+
+  p = uv__get_internal_fields(loop)->iou_pbuf;
+  if (p == NULL)
     return NULL;
 
-  head = atomic_load_explicit((_Atomic uint32_t*) iou->sqhead,
-                              memory_order_acquire);
-  tail = *iou->sqtail;
-  mask = iou->sqmask;
+  return &p->waiters;
+}
 
-  if ((head & mask) == ((tail + 1) & mask))
-    return NULL;  /* No room in ring buffer. TODO(bnoordhuis) maybe flush it? */
 
-  slot = tail & mask;
-  sqe = iou->sqe;
-  sqe = &sqe[slot];
-  memset(sqe, 0, sizeof(*sqe));
-  sqe->user_data = (uintptr_t) req;
+/* Called when a completion says the kernel took buffer |bid| out of the
+ * ring.
+ */
+static char* uv__iou_pbuf_take(uv_loop_t* loop, uint32_t bid) {
+  struct uv__iou_pbuf* p;
 
-  /* Pacify uv_cancel(). */
-  req->work_req.loop = loop;
-  req->work_req.work = NULL;
-  req->work_req.done = NULL;
-  uv__queue_init(&req->work_req.wq);
+  p = uv__get_internal_fields(loop)->iou_pbuf;
+  assert(p != NULL);
+  assert(bid < p->count);
+  assert(!p->held[bid]);
+  assert(p->navail > 0);
 
-  uv__req_register(loop);
-  iou->in_flight++;
+  p->held[bid] = 1;
+  p->navail--;
 
-  return sqe;
+  return p->slab + bid * p->size;
 }
 
 
-static void uv__iou_submit(struct uv__iou* iou) {
-  uint32_t flags;
+/* Puts the buffer that |base| points into back in the ring. Returns
+ * UV_EINVAL if |base| isn't a provided buffer or was already released.
+ */
+int uv__iou_pbuf_release(uv_loop_t* loop, const char* base) {
+  struct uv__iou_pbuf* p;
+  size_t bid;
 
-  atomic_store_explicit((_Atomic uint32_t*) iou->sqtail,
-                        *iou->sqtail + 1,
-                        memory_order_release);
+  p = uv__get_internal_fields(loop)->iou_pbuf;
+  if (p == NULL)
+    return UV_EINVAL;
 
-  flags = atomic_load_explicit((_Atomic uint32_t*) iou->sqflags,
-                               memory_order_acquire);
+  if (base < p->slab || base >= p->slab + p->slablen)
+    return UV_EINVAL;
 
-  if (flags & UV__IORING_SQ_NEED_WAKEUP)
-    if (uv__io_uring_enter(iou->ringfd, 0, 0, UV__IORING_ENTER_SQ_WAKEUP))
-      if (errno != EOWNERDEAD)  /* Kernel bug. Harmless, ignore. */
-        perror("libuv: io_uring_enter(wakeup)");  /* Can't happen. */
+  bid = (base - p->slab) / p->size;
+  if (!p->held[bid])
+    return UV_EINVAL;
+
+  p->held[bid] = 0;
+
+  /* The ring is gone after a failed re-registration in a forked child. */
+  if (p->registered)
+    uv__iou_pbuf_put(p, bid);
+
+  return 0;
 }
 
 
@@ -877,7 +1607,7 @@ int uv__iou_fs_ftruncate(uv_loop_t* loop, uv_fs_t* req) {
     return 0;
 
   sqe->fd = req->file;
-  sqe->len = req->off;
+  sqe->off = req->off;
   sqe->opcode = UV__IORING_OP_FTRUNCATE;
   uv__iou_submit(iou);
 
@@ -1161,10 +1891,106 @@ static void uv__iou_fs_statx_post(uv_fs_t* req) {
 }
 
 
+/* Returns 1 if the request's callback ran, 0 if it was handed off to the
+ * thread pool.
+ */
+static int uv__iou_complete_req(uv_loop_t* loop,
+                                struct uv__iou* iou,
+                                struct uv__io_uring_cqe* e) {
+  uv_fs_t* req;
+
+  req = (uv_fs_t*) (uintptr_t) e->user_data;
+  assert(req->type == UV_FS);
+
+  uv__req_unregister(loop);
+  iou->in_flight--;
+
+  /* If the op is not supported by the kernel retry using the thread pool */
+  if (e->res == -EOPNOTSUPP) {
+    uv__fs_post(loop, req);
+    return 0;
+  }
+
+  /* io_uring stores error codes as negative numbers, same as libuv. */
+  req->result = e->res;
+
+  switch (req->fs_type) {
+    case UV_FS_FSTAT:
+    case UV_FS_LSTAT:
+    case UV_FS_STAT:
+      uv__iou_fs_statx_post(req);
+      break;
+    default:  /* Squelch -Wswitch warnings. */
+      break;
+  }
+
+  uv__metrics_update_idle_time(loop);
+  req->cb(req);
+
+  return 1;
+}
+
+
+/* Returns 1 if a callback ran. Completions of polls are handled by
+ * uv__io_poll_iou().
+ */
+static int uv__iou_complete(uv_loop_t* loop,
+                            struct uv__iou* iou,
+                            struct uv__io_uring_cqe* e) {
+  uv_stream_t* stream;
+  uv_req_t* req;
+  char* buf;
+
+  switch (e->user_data & UV__IOU_TAG_MASK) {
+    case UV__IOU_TAG_REQ:
+      req = (uv_req_t*) (uintptr_t) e->user_data;
+      if (req->type == UV_FS)
+        return uv__iou_complete_req(loop, iou, e);
+
+      assert(req->type == UV_WRITE);
+      if (!(e->flags & UV__IORING_CQE_F_MORE))
+        iou->in_flight--;
+      uv__metrics_update_idle_time(loop);
+      if (e->flags & UV__IORING_CQE_F_NOTIF)
+        uv__stream_iou_send_notif((uv_write_t*) req);
+      else
+        uv__stream_iou_send_done((uv_write_t*) req,
+                                 e->res,
+                                 e->flags & UV__IORING_CQE_F_MORE);
+      return 1;
+
+    case UV__IOU_TAG_HANDLE:
+      stream = (uv_stream_t*) (uintptr_t) (e->user_data & ~UV__IOU_TAG_MASK);
+
+      /* Listen sockets don't receive, only accept. */
+      if (stream->io_watcher.cb == uv__server_io) {
+        if (!(e->flags & UV__IORING_CQE_F_MORE))
+          iou->in_flight--;
+        uv__metrics_update_idle_time(loop);
+        uv__stream_iou_accept_done(stream,
+                                   e->res,
+                                   e->flags & UV__IORING_CQE_F_MORE);
+        return 1;
+      }
+
+      buf = NULL;
+      if (e->flags & UV__IORING_CQE_F_BUFFER)
+        buf = uv__iou_pbuf_take(loop, e->flags >> UV__IORING_CQE_BUFFER_SHIFT);
+      iou->in_flight--;
+      uv__metrics_update_idle_time(loop);
+      uv__stream_iou_recv_done(stream, e->res, buf);
+      return 1;
+
+    default:
+      assert((e->user_data & UV__IOU_TAG_MASK) == UV__IOU_TAG_IGNORE);
+      return 0;
+  }
+}
+
+
 static void uv__poll_io_uring(uv_loop_t* loop, struct uv__iou* iou) {
   struct uv__io_uring_cqe* cqe;
   struct uv__io_uring_cqe* e;
-  uv_fs_t* req;
   uint32_t head;
   uint32_t tail;
   uint32_t mask;
@@ -1182,35 +2008,7 @@ static void uv__poll_io_uring(uv_loop_t* loop, struct uv__iou* iou) {
 
   for (i = head; i != tail; i++) {
     e = &cqe[i & mask];
-
-    req = (uv_fs_t*) (uintptr_t) e->user_data;
-    assert(req->type == UV_FS);
-
-    uv__req_unregister(loop);
-    iou->in_flight--;
-
-    /* If the op is not supported by the kernel retry using the thread pool */
-    if (e->res == -EOPNOTSUPP) {
-      uv__fs_post(loop, req);
-      continue;
-    }
-
-    /* io_uring stores error codes as negative numbers, same as libuv. */
-    req->result = e->res;
-
-    switch (req->fs_type) {
-      case UV_FS_FSTAT:
-      case UV_FS_LSTAT:
-      case UV_FS_STAT:
-        uv__iou_fs_statx_post(req);
-        break;
-      default:  /* Squelch -Wswitch warnings. */
-        break;
-    }
-
-    uv__metrics_update_idle_time(loop);
-    req->cb(req);
-    nevents++;
+    nevents += uv__iou_complete(loop, iou, e);
   }
 
   atomic_store_explicit((_Atomic uint32_t*) iou->cqhead,
@@ -1346,6 +2144,224 @@ static void uv__epoll_ctl_flush(int epollfd,
 }
 
 
+/* Waits for readiness events with io_uring instead of epoll. Pending
+ * submissions, like poll (re)arms and file operations, are flushed by the
+ * same io_uring_enter() call that waits for completions.
+ */
+static void uv__io_poll_iou(uv_loop_t* loop, int timeout) {
+  struct uv__io_uring_getevents_arg arg;
+  uv__loop_internal_fields_t* lfields;
+  struct uv__kernel_timespec ts;
+  struct uv__io_uring_cqe* cqe;
+  struct uv__io_uring_cqe* e;
+  struct uv__iou* iou;
+  struct uv__queue* q;
+  uv__io_t* w;
+  sigset_t* sigmask;
+  sigset_t sigset;
+  uint64_t base;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t mask;
+  uint32_t i;
+  unsigned int events;
+  int real_timeout;
+  int have_signals;
+  int nevents;
+  int nfds;
+  int fd;
+  int rc;
+  int user_timeout;
+  int reset_timeout;
+
+  lfields = uv__get_internal_fields(loop);
+  iou = &lfields->iou;
+
+  sigmask = NULL;
+  if (loop->flags & UV_LOOP_BLOCK_SIGPROF) {
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGPROF);
+    sigmask = &sigset;
+  }
+
+  assert(timeout >= -1);
+  base = loop->time;
+  real_timeout = timeout;
+
+  if (lfields->flags & UV_METRICS_IDLE_TIME) {
+    reset_timeout = 1;
+    user_timeout = timeout;
+    timeout = 0;
+  } else {
+    reset_timeout = 0;
+    user_timeout = 0;
+  }
+
+  while (!uv__queue_empty(&loop->watcher_queue)) {
+    q = uv__queue_head(&loop->watcher_queue);
+    w = uv__queue_data(q, uv__io_t, watcher_queue);
+    uv__queue_remove(q);
+    uv__queue_init(q);
+    uv__iou_poll_arm(loop, iou, w);
+  }
+
+  for (;;) {
+    if (loop->nfds == 0)
+      if (iou->in_flight == 0)
+        break;
+
+    /* Only need to set the provider_entry_time if timeout != 0. The function
+     * will return early if the loop isn't configured with UV_METRICS_IDLE_TIME.
+     */
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
+    /* Store the current timeout in a location that's globally accessible so
+     * other locations like uv__work_done() can determine whether the queue
+     * of events in the callback were waiting when poll was called.
+     */
+    lfields->current_timeout = timeout;
+
+    memset(&arg, 0, sizeof(arg));
+    if (sigmask != NULL) {
+      arg.sigmask = (uintptr_t) sigmask;
+      arg.sigmask_sz = _NSIG / 8;  /* Size of the kernel's sigset_t. */
+    }
+
+    if (timeout != -1) {
+      ts.tv_sec = timeout / 1000;
+      ts.tv_nsec = timeout % 1000 * 1000000LL;
+      arg.ts = (uintptr_t) &ts;
+    }
+
+    rc = uv__io_uring_getevents(iou->ringfd,
+                                *iou->sqtail - *iou->sqhead,
+                                timeout != 0,
+                                &arg);
+
+    /* Update loop->time unconditionally. It's tempting to skip the update when
+     * timeout == 0 (i.e. non-blocking poll) but there is no guarantee that the
+     * operating system didn't reschedule our process while in the syscall.
+     */
+    SAVE_ERRNO(uv__update_time(loop));
+
+    /* EBUSY and EAGAIN mean the completion ring is backed up; reap it. */
+    if (rc == -1)
+      if (errno != EINTR && errno != ETIME && errno != EBUSY && errno != EAGAIN)
+        perror("libuv: io_uring_enter(getevents)");  /* Can't happen. */
+
+    head = *iou->cqhead;
+    tail = atomic_load_explicit((_Atomic uint32_t*) iou->cqtail,
+                                memory_order_acquire);
+    nfds = tail - head;
+
+    if (nfds == 0 && rc == -1 && errno == EINTR)
+      nfds = -1;
+
+    if (nfds == 0 || nfds == -1) {
+      if (reset_timeout != 0) {
+        timeout = user_timeout;
+        reset_timeout = 0;
+      } else if (nfds == 0 && timeout != -1) {
+        return;
+      }
+
+      /* Interrupted by a signal. Update timeout and poll again. */
+      goto update_timeout;
+    }
+
+    have_signals = 0;
+    nevents = 0;
+    mask = iou->cqmask;
+    cqe = iou->cqe;
+
+    for (i = head; i != tail; i++) {
+      e = &cqe[i & mask];
+
+      if ((e->user_data & UV__IOU_TAG_MASK) != UV__IOU_TAG_POLL) {
+        nevents += uv__iou_complete(loop, iou, e);
+        continue;
+      }
+
+      /* Skip completions of polls that have been cancelled or rearmed. */
+      fd = (e->user_data >> 2) & 0xFFFFFFFF;
+      if ((unsigned) fd >= lfields->niou_polls)
+        continue;
+
+      if (lfields->iou_polls[fd] != e->user_data)
+        continue;
+
+      lfields->iou_polls[fd] = 0;
+
+      w = loop->watchers[fd];
+      if (w == NULL)
+        continue;
+
+      /* Rearm before running the callback. If the callback stops or closes
+       * the watcher, the new poll is cancelled or its completion is ignored.
+       */
+      uv__iou_poll_arm(loop, iou, w);
+
+      events = POLLERR;
+      if (e->res >= 0)
+        events = e->res;
+
+      /* See uv__io_poll() for why POLLERR and POLLHUP are handled this way. */
+      events &= w->pevents | POLLERR | POLLHUP;
+      if (events == POLLERR || events == POLLHUP)
+        events |= w->pevents & (POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI);
+
+      if (events != 0) {
+        /* Run signal watchers last. */
+        if (w == &loop->signal_io_watcher) {
+          have_signals = 1;
+        } else {
+          uv__metrics_update_idle_time(loop);
+          w->cb(loop, w, events);
+        }
+
+        nevents++;
+      }
+    }
+
+    atomic_store_explicit((_Atomic uint32_t*) iou->cqhead,
+                          tail,
+                          memory_order_release);
+
+    uv__metrics_inc_events(loop, nevents);
+    if (reset_timeout != 0) {
+      timeout = user_timeout;
+      reset_timeout = 0;
+      uv__metrics_inc_events_waiting(loop, nevents);
+    }
+
+    if (have_signals != 0) {
+      uv__metrics_update_idle_time(loop);
+      loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+      break;  /* Event loop should cycle now so don't poll again. */
+    }
+
+    if (nevents != 0)
+      break;
+
+update_timeout:
+    if (timeout == 0)
+      break;
+
+    if (timeout == -1)
+      continue;
+
+    assert(timeout > 0);
+
+    real_timeout -= (loop->time - base);
+    if (real_timeout <= 0)
+      break;
+
+    timeout = real_timeout;
+  }
+}
+
+
 void uv__io_poll(uv_loop_t* loop, int timeout) {
   uv__loop_internal_fields_t* lfields;
   struct epoll_event events[1024];
@@ -1373,6 +2389,11 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int user_timeout;
   int reset_timeout;
 
+  if (loop->flags & UV_LOOP_ENABLE_IO_URING_POLL) {
+    uv__io_poll_iou(loop, timeout);
+    return;
+  }
+
   lfields = uv__get_internal_fields(loop);
   ctl = &lfields->ctl;
   iou = &lfields->iou;
@@ -1449,6 +2470,11 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       while (*ctl->sqhead != *ctl->sqtail)
         uv__epoll_ctl_flush(epollfd, ctl, &prep);
 
+    /* Same for stream operations. Without SQPOLL, nothing else submits them. */
+    if (iou->ringfd >= 0)
+      if (*iou->sqhead != *iou->sqtail)
+        uv__iou_flush(iou);
+
     /* Only need to set the provider_entry_time if timeout != 0. The function
      * will return early if the loop isn't configured with UV_METRICS_IDLE_TIME.
      */
@@ -1690,6 +2716,28 @@ err:
   return UV_EINVAL;
 }
 
+
+int uv__cpu_numa_node(int cpu) {
+  struct dirent* ent;
+  char path[64];
+  DIR* dir;
+  int node;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  dir = opendir(path);
+  if (dir == NULL)
+    return 0;
+
+  /* The cpu directory has a nodeN link to the CPU's NUMA node. */
+  node = 0;
+  while ((ent = readdir(dir)) != NULL)
+    if (sscanf(ent->d_name, "node%d", &node) == 1)
+      break;
+
+  closedir(dir);
+  return node;
+}
+
 int uv_uptime(double* uptime) {
   struct timespec now;
   char buf[128];
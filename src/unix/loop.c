@@ -53,6 +53,7 @@ int uv_loop_init(uv_loop_t* loop) {
   uv__queue_init(&loop->wq);
   uv__queue_init(&loop->idle_handles);
   uv__queue_init(&loop->async_handles);
+  uv__queue_init(&lfields->async_ready);
   uv__queue_init(&loop->check_handles);
   uv__queue_init(&loop->prepare_handles);
   uv__queue_init(&loop->handle_queue);
@@ -201,6 +202,8 @@ void uv__loop_close(uv_loop_t* loop) {
   loop->watchers = NULL;
   loop->nwatchers = 0;
 
+  heap_free((struct heap*) &loop->timer_heap);
+
   lfields = uv__get_internal_fields(loop);
   uv_mutex_destroy(&lfields->loop_metrics.lock);
   uv__free(lfields);
@@ -210,6 +213,10 @@ void uv__loop_close(uv_loop_t* loop) {
 
 int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap) {
   uv__loop_internal_fields_t* lfields;
+#if defined(__linux__)
+  unsigned int count;
+  unsigned int size;
+#endif
 
   lfields = uv__get_internal_fields(loop);
   if (option == UV_METRICS_IDLE_TIME) {
@@ -222,6 +229,23 @@ int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap) {
     loop->flags |= UV_LOOP_ENABLE_IO_URING_SQPOLL;
     return 0;
   }
+
+  if (option == UV_LOOP_USE_IO_URING_POLL)
+    return uv__iou_poll_init(loop);
+
+  if (option == UV_LOOP_USE_EDGE_TRIGGERED_STREAMS) {
+    loop->flags |= UV_LOOP_ENABLE_EDGE_TRIGGERED_STREAMS;
+    return 0;
+  }
+
+  if (option == UV_LOOP_USE_IO_URING_STREAMS)
+    return uv__iou_stream_init(loop);
+
+  if (option == UV_LOOP_USE_IO_URING_BUFFERS) {
+    count = va_arg(ap, unsigned int);
+    size = va_arg(ap, unsigned int);
+    return uv__iou_pbuf_init(loop, count, size);
+  }
 #endif
 
 
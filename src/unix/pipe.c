@@ -169,7 +169,8 @@ int uv__pipe_listen(uv_pipe_t* handle, int backlog, uv_connection_cb cb) {
 
   handle->connection_cb = cb;
   handle->io_watcher.cb = uv__server_io;
-  uv__io_start(handle->loop, &handle->io_watcher, POLLIN);
+  if (uv__stream_iou_listen((uv_stream_t*) handle))
+    uv__io_start(handle->loop, &handle->io_watcher, POLLIN);
   return 0;
 }
 
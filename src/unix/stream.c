@@ -70,9 +70,109 @@ union uv__cmsg {
 
 STATIC_ASSERT(256 == sizeof(union uv__cmsg));
 
+#if defined(__linux__)
+/* State of a stream that reads and writes through io_uring, see
+ * UV_LOOP_USE_IO_URING_STREAMS. Lives in stream->u.reserved[0].
+ *
+ * Receives go into a private buffer rather than one from alloc_cb because
+ * the kernel may still write to it after the stream has been closed, when
+ * the user has already released their buffers. The data is copied out on
+ * delivery. When the loop has provided buffers (UV_LOOP_USE_IO_URING_BUFFERS)
+ * the kernel picks one when data arrives and the private buffer isn't needed;
+ * uv_read_start_provided() then hands that buffer to read_cb as is.
+ *
+ * At most one receive and one send are in flight per stream. The send
+ * gathers the buffers of up to IOV_MAX queued write requests.
+ *
+ * Listen sockets keep a multishot accept in flight instead. Connections that
+ * arrive while the application hasn't called uv_accept() yet wait in |fds|.
+ */
+struct uv__stream_iou_zc;
+
+struct uv__stream_iou {
+  struct msghdr msg;
+  struct iovec* iov;
+  uv_write_t* send_req;  /* Head of the write queue when the send started. */
+  unsigned int send_nreqs;
+  uv_stream_t* stream;
+  struct uv__queue pbuf_queue;  /* See uv__iou_pbuf_waiters(). */
+  char* buf;
+  char* data;  /* The received data, |buf| or a provided buffer. */
+  ssize_t nread;
+  size_t offset;
+  struct uv__stream_iou_zc* zc;  /* See uv_tcp_zerocopy(). */
+  int* fds;  /* Accepted connections, |fds_head| is the oldest. */
+  unsigned int fds_head;
+  unsigned int nfds;
+  unsigned int fds_size;
+  unsigned int flags;
+  int fd;
+};
+
+enum {
+  UV__STREAM_IOU_RECV = 1,      /* Receive in flight. */
+  UV__STREAM_IOU_SEND = 2,      /* Send in flight. */
+  UV__STREAM_IOU_RESULT = 4,    /* Undelivered receive result in data/nread. */
+  UV__STREAM_IOU_PROVIDED = 8,  /* Reading with uv_read_start_provided(). */
+  UV__STREAM_IOU_NOBUFS = 16,   /* Waiting for a provided buffer. */
+  UV__STREAM_IOU_LISTEN = 32,   /* Accepting with io_uring. */
+  UV__STREAM_IOU_ACCEPT = 64,   /* Multishot accept in flight. */
+  UV__STREAM_IOU_NOACCEPT = 128,  /* Multishot accept not supported. */
+  UV__STREAM_IOU_SERVING = 256,  /* In uv__stream_iou_serve(). */
+  UV__STREAM_IOU_COPY = 512     /* Don't make the next send zero-copy. */
+};
+
+#define UV__STREAM_IOU_ZC_MAX 8
+
+/* Zero-copy sends, see uv_tcp_zerocopy(). The kernel reads from the write
+ * requests' buffers until it posts a notification, well after the send
+ * itself completed. Every zero-copy send in flight owns one of |reqs| and
+ * passes it as the user_data of its completions, so the notification names
+ * the send even if notifications arrive out of order.
+ *
+ * Write requests that have been sent stay at the front of the write queue,
+ * |nwait| of them, until the notifications of all zero-copy sends issued by
+ * then are in. That also keeps the write callbacks in order. |waits| groups
+ * those requests by the value of |seq| they wait for.
+ */
+struct uv__stream_iou_zc {
+  uv_write_t reqs[UV__STREAM_IOU_ZC_MAX];
+  struct {
+    unsigned int seq;
+    unsigned int count;
+  } waits[UV__STREAM_IOU_ZC_MAX];
+  unsigned int nwaits;
+  unsigned int nwait;
+  unsigned int seq;    /* Number of zero-copy sends issued. */
+  unsigned int acked;  /* Sends before this one have been notified. */
+  unsigned int done;   /* Notified sends after |acked|, one bit per slot. */
+  size_t threshold;
+  int enabled;
+};
+
+static struct uv__stream_iou* uv__stream_iou(uv_stream_t* stream);
+static void uv__stream_iou_open(uv_stream_t* stream);
+static void uv__stream_iou_read(uv_stream_t* stream);
+static void uv__stream_iou_write(uv_stream_t* stream);
+static void uv__stream_iou_cancel(uv_stream_t* stream);
+static void uv__stream_iou_free(uv_stream_t* stream);
+static int uv__stream_iou_release(uv_loop_t* loop, const char* base);
+static int uv__stream_iou_serve(uv_stream_t* stream, unsigned int events);
+static int uv__stream_iou_accepted(uv_stream_t* stream);
+#else
+#define uv__stream_iou(stream) 0
+#define uv__stream_iou_open(stream)
+#define uv__stream_iou_read(stream)
+#define uv__stream_iou_write(stream)
+#define uv__stream_iou_cancel(stream)
+#define uv__stream_iou_free(stream)
+#define uv__stream_iou_serve(stream, events) UV_ENOSYS
+#define uv__stream_iou_accepted(stream) UV_ENOSYS
+#endif
+
 static void uv__stream_connect(uv_stream_t*);
 static void uv__write(uv_stream_t* stream);
-static void uv__read(uv_stream_t* stream);
+static void uv__read(uv_stream_t* stream, unsigned int events);
 static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events);
 static void uv__write_callbacks(uv_stream_t* stream);
 static size_t uv__write_req_size(uv_write_t* req);
@@ -97,6 +197,7 @@ void uv__stream_init(uv_loop_t* loop,
   uv__queue_init(&stream->write_queue);
   uv__queue_init(&stream->write_completed_queue);
   stream->write_queue_size = 0;
+  stream->u.reserved[0] = NULL;
 
   if (loop->emfile_fd == -1) {
     err = uv__open_cloexec("/dev/null", O_RDONLY);
@@ -117,6 +218,49 @@ void uv__stream_init(uv_loop_t* loop,
 }
 
 
+/* Returns the event mask to watch the stream with. Edge-triggered watchers
+ * require that a short read means the fd has been drained, which isn't true
+ * for TTYs in canonical mode, or for IPC pipes because recvmsg() stops at
+ * ancillary data boundaries. Nor is it true when the peer hung up after
+ * sending the data, the pending EOF won't be reported again, hence
+ * UV__POLLRDHUP.
+ */
+static unsigned int uv__stream_events(uv_stream_t* stream,
+                                      unsigned int events) {
+  if (!(stream->loop->flags & UV_LOOP_ENABLE_EDGE_TRIGGERED_STREAMS))
+    return events;
+
+  if (stream->type == UV_NAMED_PIPE && ((uv_pipe_t*) stream)->ipc)
+    return events;
+
+  if (stream->type != UV_TCP && stream->type != UV_NAMED_PIPE)
+    return events;
+
+  if (events & POLLIN)
+    events |= UV__POLLRDHUP;
+
+  return events | UV__POLLET;
+}
+
+
+/* An edge-triggered watcher doesn't fire again until new data arrives. If we
+ * stopped reading or writing before hitting EAGAIN, remember that and put the
+ * stream on the pending queue so it's picked up again on the next tick.
+ */
+static void uv__stream_requeue(uv_stream_t* stream, unsigned int events) {
+  if (!(stream->io_watcher.pevents & UV__POLLET))
+    return;
+
+  if (events & POLLIN) {
+    if (!(stream->flags & UV_HANDLE_READING))
+      return;
+    stream->flags |= UV_HANDLE_READ_READY;
+  }
+
+  uv__io_feed(stream->loop, &stream->io_watcher);
+}
+
+
 static void uv__stream_osx_interrupt_select(uv_stream_t* stream) {
 #if defined(__APPLE__)
   /* Notify select() thread about state change */
@@ -432,6 +576,7 @@ int uv__stream_open(uv_stream_t* stream, int fd, int flags) {
 #endif
 
   stream->io_watcher.fd = fd;
+  uv__stream_iou_open(stream);
 
   return 0;
 }
@@ -465,6 +610,7 @@ void uv__stream_destroy(uv_stream_t* stream) {
   uv__stream_flush_write_queue(stream, UV_ECANCELED);
   uv__write_callbacks(stream);
   uv__drain(stream);
+  uv__stream_iou_free(stream);
 
   assert(stream->write_queue_size == 0);
 }
@@ -511,6 +657,10 @@ void uv__server_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   int fd;
 
   stream = container_of(w, uv_stream_t, io_watcher);
+
+  if (uv__stream_iou_serve(stream, events) == 0)
+    return;
+
   assert(events & POLLIN);
   assert(stream->accepted_fd == -1);
   assert(!(stream->flags & UV_HANDLE_CLOSING));
@@ -591,7 +741,7 @@ done:
     }
   } else {
     server->accepted_fd = -1;
-    if (err == 0)
+    if (err == 0 && uv__stream_iou_accepted(server) != 0)
       uv__io_start(server->loop, &server->io_watcher, POLLIN);
   }
   return err;
@@ -730,10 +880,12 @@ static void uv__write_req_finish(uv_write_t* req) {
   }
 
   /* Add it to the write_completed_queue where it will have its
-   * callback called in the near future.
+   * callback called in the near future. When the stream is closing, that's
+   * uv__stream_destroy()'s job.
    */
   uv__queue_insert_tail(&stream->write_completed_queue, &req->queue);
-  uv__io_feed(stream->loop, &stream->io_watcher);
+  if (!uv__is_closing(stream))
+    uv__io_feed(stream->loop, &stream->io_watcher);
 }
 
 
@@ -845,6 +997,11 @@ static void uv__write(uv_stream_t* stream) {
 
   assert(uv__stream_fd(stream) >= 0);
 
+  if (uv__stream_iou(stream)) {
+    uv__stream_iou_write(stream);
+    return;
+  }
+
   /* Prevent loop starvation when the consumer of this stream read as fast as
    * (or faster than) we can write it. This `count` mechanism does not need to
    * change even if we switch to edge-triggered I/O.
@@ -872,6 +1029,7 @@ static void uv__write(uv_stream_t* stream) {
         if (count-- > 0)
           continue; /* Start trying to write the next request. */
 
+        uv__stream_requeue(stream, POLLOUT);
         return;
       }
     } else if (n != UV_EAGAIN)
@@ -882,7 +1040,13 @@ static void uv__write(uv_stream_t* stream) {
       continue;
 
     /* We're not done. */
-    uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
+    uv__io_start(stream->loop,
+                 &stream->io_watcher,
+                 uv__stream_events(stream, POLLOUT));
+
+    /* A short write doesn't guarantee that the fd stopped being writable. */
+    if (n >= 0)
+      uv__stream_requeue(stream, POLLOUT);
 
     /* Notify select() thread about state change */
     uv__stream_osx_interrupt_select(stream);
@@ -932,13 +1096,841 @@ static void uv__write_callbacks(uv_stream_t* stream) {
 static void uv__stream_eof(uv_stream_t* stream, const uv_buf_t* buf) {
   stream->flags |= UV_HANDLE_READ_EOF;
   stream->flags &= ~UV_HANDLE_READING;
-  uv__io_stop(stream->loop, &stream->io_watcher, POLLIN);
+  uv__io_stop(stream->loop, &stream->io_watcher, POLLIN | UV__POLLRDHUP);
   uv__handle_stop(stream);
   uv__stream_osx_interrupt_select(stream);
   stream->read_cb(stream, UV_EOF, buf);
 }
 
 
+#if defined(__linux__)
+static struct uv__stream_iou* uv__stream_iou(uv_stream_t* stream) {
+  return stream->u.reserved[0];
+}
+
+
+/* TCP and non-IPC socket pipes only. IPC pipes need recvmsg() to pick up
+ * file descriptors and other pipes can't use the socket opcodes.
+ */
+static void uv__stream_iou_open(uv_stream_t* stream) {
+  struct uv__stream_iou* s;
+  struct stat st;
+
+  if (!(stream->loop->flags & UV_LOOP_ENABLE_IO_URING_STREAMS))
+    return;
+
+  if (stream->u.reserved[0] != NULL)
+    return;
+
+  if (stream->flags & UV_HANDLE_BLOCKING_WRITES)
+    return;
+
+  if (stream->type == UV_NAMED_PIPE) {
+    if (((uv_pipe_t*) stream)->ipc)
+      return;
+
+    if (uv__fstat(uv__stream_fd(stream), &st) || !S_ISSOCK(st.st_mode))
+      return;
+  } else if (stream->type != UV_TCP) {
+    return;
+  }
+
+  s = uv__calloc(1, sizeof(*s));
+  if (s == NULL)
+    return;  /* Not fatal, use read() and write(). */
+
+  s->fd = -1;
+  s->stream = stream;
+  uv__queue_init(&s->pbuf_queue);
+  stream->u.reserved[0] = s;
+}
+
+
+static void uv__stream_iou_free(uv_stream_t* stream) {
+  struct uv__stream_iou* s;
+
+  s = uv__stream_iou(stream);
+  if (s == NULL)
+    return;
+
+  assert(!(s->flags & (UV__STREAM_IOU_RECV |
+                       UV__STREAM_IOU_SEND |
+                       UV__STREAM_IOU_ACCEPT)));
+  assert(s->fds_head == s->nfds);
+
+  uv__queue_remove(&s->pbuf_queue);
+
+  if ((s->flags & UV__STREAM_IOU_RESULT) && s->data != s->buf)
+    uv__stream_iou_release(stream->loop, s->data);
+  uv__free(s->zc);
+  uv__free(s->fds);
+  uv__free(s->iov);
+  uv__free(s->buf);
+  uv__free(s);
+  stream->u.reserved[0] = NULL;
+}
+
+
+int uv__stream_iou_busy(uv_stream_t* stream) {
+  struct uv__stream_iou* s;
+
+  s = uv__stream_iou(stream);
+  if (s == NULL)
+    return 0;
+
+  if (s->zc != NULL && s->zc->acked != s->zc->seq)
+    return 1;  /* Waiting for zero-copy notifications. */
+
+  return !!(s->flags & (UV__STREAM_IOU_RECV |
+                        UV__STREAM_IOU_SEND |
+                        UV__STREAM_IOU_ACCEPT));
+}
+
+
+/* Called from uv__stream_close(). The file descriptor is closed and the
+ * handle's close callback scheduled when the last operation completes, see
+ * uv__stream_iou_closed(), so that the descriptor can't be reused while the
+ * kernel still has operations queued against it.
+ */
+static void uv__stream_iou_cancel(uv_stream_t* stream) {
+  struct uv__stream_iou* s;
+
+  s = uv__stream_iou(stream);
+  if (s == NULL)
+    return;
+
+  /* Stop waiting for a provided buffer. */
+  uv__queue_remove(&s->pbuf_queue);
+  uv__queue_init(&s->pbuf_queue);
+  s->flags &= ~UV__STREAM_IOU_NOBUFS;
+
+  /* Drop the connections that the application hasn't accepted. */
+  while (s->fds_head < s->nfds)
+    uv__close(s->fds[s->fds_head++]);
+  s->fds_head = 0;
+  s->nfds = 0;
+
+  if (!uv__stream_iou_busy(stream))
+    return;
+
+  if (s->flags & (UV__STREAM_IOU_RECV | UV__STREAM_IOU_ACCEPT))
+    uv__iou_stream_cancel(stream, NULL);
+
+  if (s->flags & UV__STREAM_IOU_SEND)
+    uv__iou_stream_cancel(stream, s->send_req);
+
+  /* Listen sockets are closed right away so that they stop accepting new
+   * connections. The accept doesn't care, it holds a file reference and
+   * only ever produces new file descriptors.
+   */
+  if (s->flags & (UV__STREAM_IOU_RECV | UV__STREAM_IOU_SEND)) {
+    /* Don't close stdio file descriptors, see uv__stream_close(). */
+    if (stream->io_watcher.fd > STDERR_FILENO)
+      s->fd = stream->io_watcher.fd;
+    stream->io_watcher.fd = -1;
+  }
+
+  /* Keep the loop alive until uv__stream_iou_closed() runs. */
+  uv__req_register(stream->loop);
+}
+
+
+static void uv__stream_iou_closed(uv_stream_t* stream) {
+  struct uv__stream_iou* s;
+
+  s = uv__stream_iou(stream);
+  if (uv__stream_iou_busy(stream))
+    return;
+
+  if (s->fd != -1)
+    uv__close(s->fd);
+  s->fd = -1;
+
+  uv__req_unregister(stream->loop);
+  uv__make_close_pending((uv_handle_t*) stream);
+}
+
+
+/* Puts a provided buffer back and lets the first stream that is waiting for
+ * one submit a new receive.
+ */
+static int uv__stream_iou_release(uv_loop_t* loop, const char* base) {
+  struct uv__stream_iou* s;
+  struct uv__queue* q;
+  int err;
+
+  err = uv__iou_pbuf_release(loop, base);
+  if (err)
+    return err;
+
+  q = uv__iou_pbuf_waiters(loop);
+  if (uv__queue_empty(q))
+    return 0;
+
+  q = uv__queue_head(q);
+  uv__queue_remove(q);
+  uv__queue_init(q);
+
+  s = container_of(q, struct uv__stream_iou, pbuf_queue);
+  s->flags &= ~UV__STREAM_IOU_NOBUFS;
+  s->stream->flags |= UV_HANDLE_READ_READY;
+  uv__io_feed(loop, &s->stream->io_watcher);
+
+  return 0;
+}
+
+
+static void uv__stream_iou_read(uv_stream_t* stream) {
+  struct uv__stream_iou* s;
+  uv_buf_t buf;
+  size_t len;
+
+  s = uv__stream_iou(stream);
+
+  /* Only watched for readability after a receive failed with EAGAIN. */
+  uv__io_stop(stream->loop, &stream->io_watcher, POLLIN | UV__POLLRDHUP);
+
+  while ((s->flags & UV__STREAM_IOU_RESULT) &&
+         (stream->flags & UV_HANDLE_READING)) {
+    assert(stream->read_cb != NULL);
+
+    buf = uv_buf_init(NULL, 0);
+
+    if (s->flags & UV__STREAM_IOU_PROVIDED) {
+      /* The application releases the buffer with uv_read_buf_release(). */
+      if (s->nread > 0) {
+        assert(s->data != s->buf);
+        buf = uv_buf_init(s->data + s->offset, s->nread - s->offset);
+        s->flags &= ~UV__STREAM_IOU_RESULT;
+        s->offset = 0;
+        stream->read_cb(stream, buf.len, &buf);
+        continue;
+      }
+    } else {
+      assert(stream->alloc_cb != NULL);
+
+      /* Like uv__read(), ask for a buffer before reporting EOF or an error. */
+      len = 64 * 1024;
+      if (s->nread > 0)
+        len = s->nread - s->offset;
+
+      stream->alloc_cb((uv_handle_t*) stream, len, &buf);
+      if (buf.base == NULL || buf.len == 0) {
+        /* User indicates it can't or won't handle the read. */
+        stream->read_cb(stream, UV_ENOBUFS, &buf);
+        if (stream->flags & UV_HANDLE_READING) {
+          stream->flags |= UV_HANDLE_READ_READY;
+          uv__io_feed(stream->loop, &stream->io_watcher);
+        }
+        return;
+      }
+    }
+
+    if (s->nread == 0) {
+      s->flags &= ~UV__STREAM_IOU_RESULT;
+      uv__stream_eof(stream, &buf);
+      return;
+    }
+
+    if (s->nread < 0) {
+      /* Error. User should call uv_close(). */
+      s->flags &= ~UV__STREAM_IOU_RESULT;
+      stream->flags &= ~(UV_HANDLE_READABLE | UV_HANDLE_WRITABLE);
+      stream->read_cb(stream, s->nread, &buf);
+      if (stream->flags & UV_HANDLE_READING) {
+        stream->flags &= ~UV_HANDLE_READING;
+        uv__handle_stop(stream);
+      }
+      return;
+    }
+
+    if (len > buf.len)
+      len = buf.len;
+
+    memcpy(buf.base, s->data + s->offset, len);
+    s->offset += len;
+
+    if (s->offset == (size_t) s->nread) {
+      s->flags &= ~UV__STREAM_IOU_RESULT;
+      s->offset = 0;
+      if (s->data != s->buf)
+        uv__stream_iou_release(stream->loop, s->data);
+    }
+
+    stream->read_cb(stream, len, &buf);
+  }
+
+  if (!(stream->flags & UV_HANDLE_READING))
+    return;
+
+  if (s->flags & (UV__STREAM_IOU_RECV |
+                  UV__STREAM_IOU_RESULT |
+                  UV__STREAM_IOU_NOBUFS)) {
+    return;
+  }
+
+  /* Let the kernel pick a buffer when data arrives. */
+  if (uv__iou_pbuf_size(stream->loop) != 0) {
+    if (uv__iou_stream_recv(stream, NULL, 0) == 0)
+      s->flags |= UV__STREAM_IOU_RECV;
+    return;
+  }
+
+  buf = uv_buf_init(NULL, 0);
+
+  /* The provided buffers are gone after a failed re-registration in a
+   * forked child.
+   */
+  if (s->flags & UV__STREAM_IOU_PROVIDED) {
+    stream->read_cb(stream, UV_ENOBUFS, &buf);
+    return;
+  }
+
+  if (s->buf == NULL) {
+    s->buf = uv__malloc(64 * 1024);
+    if (s->buf == NULL) {
+      stream->read_cb(stream, UV_ENOMEM, &buf);
+      return;
+    }
+  }
+
+  if (uv__iou_stream_recv(stream, s->buf, 64 * 1024) == 0)
+    s->flags |= UV__STREAM_IOU_RECV;
+}
+
+
+/* |buf| is the provided buffer that the kernel received into, if any. */
+void uv__stream_iou_recv_done(uv_stream_t* stream, int res, char* buf) {
+  struct uv__stream_iou* s;
+
+  s = uv__stream_iou(stream);
+  assert(s->flags & UV__STREAM_IOU_RECV);
+  assert(!(s->flags & UV__STREAM_IOU_RESULT));
+  s->flags &= ~UV__STREAM_IOU_RECV;
+
+  /* Some kernels consume a buffer on EOF. */
+  if (buf != NULL && res <= 0) {
+    uv__stream_iou_release(stream->loop, buf);
+    buf = NULL;
+  }
+
+  if (uv__is_closing(stream)) {
+    if (buf != NULL)
+      uv__stream_iou_release(stream->loop, buf);
+    uv__stream_iou_closed(stream);
+    return;
+  }
+
+  /* io_uring honors O_NONBLOCK on some kernels. Fall back to polling for
+   * readability, uv__stream_iou_read() then submits a new receive.
+   */
+  if (res == UV_EAGAIN || res == UV_EINTR) {
+    if (stream->flags & UV_HANDLE_READING)
+      uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
+    return;
+  }
+
+  /* Out of provided buffers. Wait until the application or another stream
+   * releases one, unless that happened in the meantime.
+   */
+  if (res == UV_ENOBUFS && uv__iou_pbuf_size(stream->loop) != 0) {
+    if (uv__iou_pbuf_avail(stream->loop) == 0) {
+      s->flags |= UV__STREAM_IOU_NOBUFS;
+      uv__queue_insert_tail(uv__iou_pbuf_waiters(stream->loop),
+                            &s->pbuf_queue);
+      return;
+    }
+
+    uv__stream_iou_read(stream);
+    return;
+  }
+
+  s->data = buf != NULL ? buf : s->buf;
+  s->nread = res;
+  s->offset = 0;
+  s->flags |= UV__STREAM_IOU_RESULT;
+
+  uv__stream_iou_read(stream);
+}
+
+
+/* Called from uv__tcp_listen() and uv__pipe_listen(). Returns 0 when the
+ * connections are accepted with io_uring; the caller polls the listen socket
+ * for readability otherwise.
+ */
+int uv__stream_iou_listen(uv_stream_t* stream) {
+  struct uv__stream_iou* s;
+  int err;
+
+  s = uv__stream_iou(stream);
+  if (s == NULL || (s->flags & UV__STREAM_IOU_NOACCEPT))
+    return UV_ENOSYS;
+
+  if (!(s->flags & UV__STREAM_IOU_ACCEPT)) {
+    err = uv__iou_stream_accept(stream);
+    if (err)
+      return err;
+
+    s->flags |= UV__STREAM_IOU_ACCEPT;
+  }
+
+  s->flags |= UV__STREAM_IOU_LISTEN;
+
+  return 0;
+}
+
+
+/* Hands the accepted connections to the connection callback one at a time,
+ * the way uv__server_io() does, and re-arms the multishot accept while the
+ * application keeps up. Runs from uv__server_io() when uv_accept() fed the
+ * watcher; |events| is only used to tell those apart from readiness events
+ * after falling back to accept(2).
+ */
+static int uv__stream_iou_serve(uv_stream_t* stream, unsigned int events) {
+  struct uv__stream_iou* s;
+
+  s = uv__stream_iou(stream);
+  if (s == NULL || !(s->flags & UV__STREAM_IOU_LISTEN))
+    return (events & POLLIN) ? UV_ENOSYS : 0;
+
+  s->flags |= UV__STREAM_IOU_SERVING;
+
+  while (stream->accepted_fd == -1 && s->fds_head < s->nfds) {
+    stream->accepted_fd = s->fds[s->fds_head++];
+    stream->connection_cb(stream, 0);
+
+    if (uv__is_closing(stream))
+      break;
+  }
+
+  s->flags &= ~UV__STREAM_IOU_SERVING;
+
+  if (uv__is_closing(stream))
+    return 0;
+
+  if (s->fds_head == s->nfds) {
+    s->fds_head = 0;
+    s->nfds = 0;
+  }
+
+  if (stream->accepted_fd != -1) {
+    /* The user hasn't yet called uv_accept(). Stop accepting until they do,
+     * connections queue up in the kernel in the meantime.
+     */
+    if (s->flags & UV__STREAM_IOU_ACCEPT)
+      uv__iou_stream_cancel(stream, NULL);
+    return 0;
+  }
+
+  if (s->flags & UV__STREAM_IOU_ACCEPT)
+    return 0;
+
+  if (!(s->flags & UV__STREAM_IOU_NOACCEPT))
+    if (uv__iou_stream_accept(stream) == 0) {
+      s->flags |= UV__STREAM_IOU_ACCEPT;
+      return 0;
+    }
+
+  /* Fall back to polling and accept(2). */
+  s->flags &= ~UV__STREAM_IOU_LISTEN;
+  s->flags |= UV__STREAM_IOU_NOACCEPT;
+  uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
+
+  return 0;
+}
+
+
+/* Called from uv_accept(). Delivers the next connection, if any, from the
+ * pending queue rather than from the caller's stack frame.
+ */
+static int uv__stream_iou_accepted(uv_stream_t* stream) {
+  struct uv__stream_iou* s;
+
+  s = uv__stream_iou(stream);
+  if (s == NULL || !(s->flags & UV__STREAM_IOU_LISTEN))
+    return UV_ENOSYS;
+
+  if (!(s->flags & UV__STREAM_IOU_SERVING))
+    uv__io_feed(stream->loop, &stream->io_watcher);
+
+  return 0;
+}
+
+
+/* |res| is the accepted file descriptor or an error. |more| is zero when
+ * this is the multishot accept's last completion.
+ */
+void uv__stream_iou_accept_done(uv_stream_t* stream, int res, int more) {
+  struct uv__stream_iou* s;
+  unsigned int size;
+  int* fds;
+
+  s = uv__stream_iou(stream);
+  assert(s->flags & UV__STREAM_IOU_ACCEPT);
+
+  if (!more)
+    s->flags &= ~UV__STREAM_IOU_ACCEPT;
+
+  if (uv__is_closing(stream)) {
+    if (res >= 0)
+      uv__close(res);
+    if (!more)
+      uv__stream_iou_closed(stream);
+    return;
+  }
+
+  if (res >= 0) {
+    if (s->nfds == s->fds_size) {
+      size = s->fds_size ? 2 * s->fds_size : 8;
+      fds = uv__realloc(s->fds, size * sizeof(*fds));
+      if (fds == NULL) {
+        uv__close(res);  /* Shed load. */
+        res = UV_ENOMEM;
+      } else {
+        s->fds = fds;
+        s->fds_size = size;
+      }
+    }
+
+    if (res >= 0)
+      s->fds[s->nfds++] = res;
+  } else if (res == UV_ECANCELED) {
+    res = 0;
+  } else if (res == UV_EMFILE || res == UV_ENFILE) {
+    uv__emfile_trick(stream->loop, uv__stream_fd(stream));  /* Shed load. */
+    res = 0;
+  } else if (!more) {
+    /* Don't re-arm after an error, a persistent one would make us spin.
+     * EINVAL means that multishot accept isn't supported and EAGAIN that the
+     * kernel honors O_NONBLOCK, those aren't the user's business.
+     */
+    s->flags |= UV__STREAM_IOU_NOACCEPT;
+    if (res == UV_EINVAL || res == UV_EAGAIN)
+      res = 0;
+  }
+
+  if (res < 0) {
+    stream->connection_cb(stream, res);
+    if (uv__is_closing(stream))
+      return;
+  }
+
+  if (stream->accepted_fd == -1 && !(s->flags & UV__STREAM_IOU_SERVING))
+    uv__stream_iou_serve(stream, POLLIN);
+}
+
+
+static void uv__stream_iou_write(uv_stream_t* stream) {
+  struct uv__stream_iou_zc* zc;
+  struct uv__stream_iou* s;
+  struct uv__queue* q;
+  uv_write_t* req;
+  unsigned int nreqs;
+  size_t iovcnt;
+  size_t iovmax;
+  size_t size;
+  size_t n;
+  int zerocopy;
+
+  s = uv__stream_iou(stream);
+
+  /* Only watched for writability after a send failed with EAGAIN. Stop it
+   * before bailing out for a send in flight, the watcher would otherwise
+   * fire in every loop iteration until the send completes.
+   */
+  uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
+
+  if (s->flags & UV__STREAM_IOU_SEND)
+    return;
+
+  if (uv__queue_empty(&stream->write_queue))
+    return;
+
+  iovmax = uv__getiovmax();
+
+  if (s->iov == NULL) {
+    s->iov = uv__malloc(iovmax * sizeof(*s->iov));
+    if (s->iov == NULL) {
+      q = uv__queue_head(&stream->write_queue);
+      req = uv__queue_data(q, uv_write_t, queue);
+      req->error = UV_ENOMEM;
+      uv__write_req_finish(req);
+      return;
+    }
+  }
+
+  /* Skip the requests that wait for zero-copy notifications. */
+  q = uv__queue_head(&stream->write_queue);
+  if (s->zc != NULL)
+    for (n = s->zc->nwait; n > 0; n--)
+      q = uv__queue_next(q);
+
+  if (q == &stream->write_queue)
+    return;
+
+  s->send_req = uv__queue_data(q, uv_write_t, queue);
+
+  iovcnt = 0;
+  nreqs = 0;
+  size = 0;
+
+  for (; q != &stream->write_queue; q = uv__queue_next(q)) {
+    req = uv__queue_data(q, uv_write_t, queue);
+    assert(req->handle == stream);
+    assert(req->send_handle == NULL);
+
+    n = req->nbufs - req->write_index;
+    if (n > iovmax - iovcnt)
+      n = iovmax - iovcnt;
+
+    memcpy(s->iov + iovcnt, req->bufs + req->write_index, n * sizeof(*s->iov));
+    size += uv__count_bufs(req->bufs + req->write_index, n);
+    iovcnt += n;
+    nreqs++;
+
+    if (iovcnt == iovmax)
+      break;
+  }
+
+  s->send_nreqs = nreqs;
+
+  memset(&s->msg, 0, sizeof(s->msg));
+  s->msg.msg_iov = s->iov;
+  s->msg.msg_iovlen = iovcnt;
+
+  /* Small sends are cheaper to copy than to pin. Fall back to copying too
+   * when all zero-copy slots are waiting for notifications.
+   */
+  zc = s->zc;
+  req = s->send_req;
+  zerocopy = zc != NULL &&
+             zc->enabled &&
+             size >= zc->threshold &&
+             zc->seq - zc->acked < UV__STREAM_IOU_ZC_MAX &&
+             !(s->flags & UV__STREAM_IOU_COPY);
+  s->flags &= ~UV__STREAM_IOU_COPY;
+  if (zerocopy)
+    req = &zc->reqs[zc->seq % UV__STREAM_IOU_ZC_MAX];
+
+  if (uv__iou_stream_sendmsg(stream, req, &s->msg, zerocopy))
+    return;
+
+  s->flags |= UV__STREAM_IOU_SEND;
+  if (zerocopy)
+    zc->seq++;
+}
+
+
+/* Completes |req|, or keeps it queued while zero-copy sends are waiting for
+ * their notifications.
+ */
+static void uv__stream_iou_finish(uv_stream_t* stream, uv_write_t* req) {
+  struct uv__stream_iou_zc* zc;
+  unsigned int n;
+
+  zc = uv__stream_iou(stream)->zc;
+  if (zc == NULL || zc->acked == zc->seq) {
+    uv__write_req_finish(req);
+    return;
+  }
+
+  n = zc->nwaits;
+  if (n > 0 && zc->waits[n - 1].seq == zc->seq) {
+    zc->waits[n - 1].count++;
+  } else {
+    assert(n < ARRAY_SIZE(zc->waits));
+    zc->waits[n].seq = zc->seq;
+    zc->waits[n].count = 1;
+    zc->nwaits++;
+  }
+
+  zc->nwait++;
+}
+
+
+/* Records the notification of the zero-copy send that owns |slot| and
+ * completes the write requests that no longer wait for anything.
+ */
+static void uv__stream_iou_zc_ack(uv_stream_t* stream, unsigned int slot) {
+  struct uv__stream_iou_zc* zc;
+  struct uv__queue* q;
+  unsigned int n;
+
+  zc = uv__stream_iou(stream)->zc;
+  zc->done |= 1u << slot;
+
+  while (zc->acked != zc->seq) {
+    slot = zc->acked % UV__STREAM_IOU_ZC_MAX;
+    if (!(zc->done & (1u << slot)))
+      break;
+
+    zc->done &= ~(1u << slot);
+    zc->acked++;
+  }
+
+  while (zc->nwaits > 0 && (int) (zc->acked - zc->waits[0].seq) >= 0) {
+    for (n = zc->waits[0].count; n > 0; n--) {
+      q = uv__queue_head(&stream->write_queue);
+      uv__write_req_finish(uv__queue_data(q, uv_write_t, queue));
+    }
+
+    zc->nwait -= zc->waits[0].count;
+    zc->nwaits--;
+    memmove(zc->waits, zc->waits + 1, zc->nwaits * sizeof(zc->waits[0]));
+  }
+}
+
+
+/* Hands out the |nsent| bytes of the last send to the requests that were
+ * part of it, in queue order.
+ */
+static void uv__stream_iou_sent(uv_stream_t* stream, size_t nsent) {
+  struct uv__stream_iou* s;
+  struct uv__queue* q;
+  uv_write_t* req;
+  unsigned int i;
+  size_t size;
+  size_t n;
+
+  s = uv__stream_iou(stream);
+  q = &s->send_req->queue;
+
+  for (i = 0; i < s->send_nreqs; i++) {
+    req = uv__queue_data(q, uv_write_t, queue);
+    q = uv__queue_next(q);
+
+    size = uv__write_req_size(req);
+    n = nsent < size ? nsent : size;
+    nsent -= n;
+
+    if (!uv__write_req_update(stream, req, n))
+      break;
+
+    uv__stream_iou_finish(stream, req);
+  }
+}
+
+
+/* |req| is the send's first write request or, for zero-copy sends, one of
+ * the stream's struct uv__stream_iou_zc slots. |more| is non-zero when a
+ * zero-copy notification follows.
+ */
+void uv__stream_iou_send_done(uv_write_t* req, int res, int more) {
+  struct uv__stream_iou_zc* zc;
+  struct uv__stream_iou* s;
+  uv_stream_t* stream;
+
+  stream = req->handle;
+  s = uv__stream_iou(stream);
+  assert(s->flags & UV__STREAM_IOU_SEND);
+  s->flags &= ~UV__STREAM_IOU_SEND;
+
+  zc = s->zc;
+  if (req != s->send_req) {
+    assert(zc != NULL);
+    assert(req >= zc->reqs && req < zc->reqs + UV__STREAM_IOU_ZC_MAX);
+    if (!more)
+      uv__stream_iou_zc_ack(stream, req - zc->reqs);
+    req = s->send_req;
+
+    /* The socket doesn't do zero-copy or the kernel couldn't pin the pages.
+     * Copy instead, for good in the first case and once in the second.
+     */
+    if (!uv__is_closing(stream) &&
+        (res == UV_ENOTSUP || res == UV_ENOMEM || res == UV_ENOBUFS)) {
+      if (res == UV_ENOTSUP)
+        zc->enabled = 0;
+      s->flags |= UV__STREAM_IOU_COPY;
+      uv__stream_iou_write(stream);
+      return;
+    }
+  }
+
+  /* The send may have completed before uv__stream_close() cancelled it.
+   * Requests that made it out succeed, uv__stream_destroy() cancels the rest.
+   */
+  if (uv__is_closing(stream)) {
+    if (res > 0)
+      uv__stream_iou_sent(stream, res);
+    uv__stream_iou_closed(stream);
+    return;
+  }
+
+  if (res == UV_EAGAIN || res == UV_EINTR) {
+    uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
+    return;
+  }
+
+  /* uv__write_req_finish() feeds the stream to the pending queue, where the
+   * write callbacks run and a pending shutdown is carried out.
+   */
+  if (res < 0) {
+    req->error = res;
+    uv__stream_iou_finish(stream, req);
+    uv__stream_iou_write(stream);
+    return;
+  }
+
+  uv__stream_iou_sent(stream, res);
+  uv__stream_iou_write(stream);
+}
+
+
+void uv__stream_iou_send_notif(uv_write_t* req) {
+  struct uv__stream_iou* s;
+  uv_stream_t* stream;
+
+  stream = req->handle;
+  s = uv__stream_iou(stream);
+  uv__stream_iou_zc_ack(stream, req - s->zc->reqs);
+
+  if (uv__is_closing(stream))
+    uv__stream_iou_closed(stream);
+}
+
+
+int uv__stream_iou_zerocopy(uv_stream_t* stream, int enable, size_t threshold) {
+  struct uv__stream_iou_zc* zc;
+  struct uv__stream_iou* s;
+  unsigned int i;
+  int err;
+
+  s = uv__stream_iou(stream);
+  if (s == NULL)
+    return UV_ENOTSUP;
+
+  zc = s->zc;
+  if (zc == NULL) {
+    if (!enable)
+      return 0;
+
+    err = uv__iou_stream_zerocopy();
+    if (err)
+      return err;
+
+    zc = uv__calloc(1, sizeof(*zc));
+    if (zc == NULL)
+      return UV_ENOMEM;
+
+    /* Only the fields that uv__iou_complete() and uv__stream_iou_send_done()
+     * look at.
+     */
+    for (i = 0; i < ARRAY_SIZE(zc->reqs); i++) {
+      zc->reqs[i].type = UV_WRITE;
+      zc->reqs[i].handle = stream;
+    }
+
+    s->zc = zc;
+  }
+
+  zc->enabled = !!enable;
+  zc->threshold = threshold;
+
+  return 0;
+}
+#endif  /* defined(__linux__) */
+
+
 static int uv__stream_queue_fd(uv_stream_t* stream, int fd) {
   uv__stream_queued_fds_t* queued_fds;
   unsigned int queue_size;
@@ -1022,7 +2014,7 @@ static int uv__stream_recv_cmsg(uv_stream_t* stream, struct msghdr* msg) {
 }
 
 
-static void uv__read(uv_stream_t* stream) {
+static void uv__read(uv_stream_t* stream, unsigned int events) {
   uv_buf_t buf;
   ssize_t nread;
   struct msghdr msg;
@@ -1030,11 +2022,23 @@ static void uv__read(uv_stream_t* stream) {
   int count;
   int err;
   int is_ipc;
+  int drain;
 
-  stream->flags &= ~UV_HANDLE_READ_PARTIAL;
+  /* Don't take a short read to mean that there is nothing left to read if
+   * the peer hung up, or if the stream was requeued without the kernel
+   * telling us whether that's still the case.
+   */
+  drain = (events & UV__POLLRDHUP) || (stream->flags & UV_HANDLE_READ_READY);
+  stream->flags &= ~(UV_HANDLE_READ_PARTIAL | UV_HANDLE_READ_READY);
+
+  if (uv__stream_iou(stream)) {
+    uv__stream_iou_read(stream);
+    return;
+  }
 
   /* Prevent loop starvation when the data comes in as fast as (or faster than)
-   * we can read it. XXX Need to rearm fd if we switch to edge-triggered I/O.
+   * we can read it. Edge-triggered streams that still have data to read when
+   * the budget runs out are requeued, see uv__stream_requeue().
    */
   count = 32;
 
@@ -1053,6 +2057,7 @@ static void uv__read(uv_stream_t* stream) {
     if (buf.base == NULL || buf.len == 0) {
       /* User indicates it can't or won't handle the read. */
       stream->read_cb(stream, UV_ENOBUFS, &buf);
+      uv__stream_requeue(stream, POLLIN);
       return;
     }
 
@@ -1086,7 +2091,9 @@ static void uv__read(uv_stream_t* stream) {
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
         /* Wait for the next one. */
         if (stream->flags & UV_HANDLE_READING) {
-          uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
+          uv__io_start(stream->loop,
+                       &stream->io_watcher,
+                       uv__stream_events(stream, POLLIN));
           uv__stream_osx_interrupt_select(stream);
         }
         stream->read_cb(stream, 0, &buf);
@@ -1101,7 +2108,9 @@ static void uv__read(uv_stream_t* stream) {
         stream->read_cb(stream, UV__ERR(errno), &buf);
         if (stream->flags & UV_HANDLE_READING) {
           stream->flags &= ~UV_HANDLE_READING;
-          uv__io_stop(stream->loop, &stream->io_watcher, POLLIN);
+          uv__io_stop(stream->loop,
+                      &stream->io_watcher,
+                      POLLIN | UV__POLLRDHUP);
           uv__handle_stop(stream);
           uv__stream_osx_interrupt_select(stream);
         }
@@ -1118,6 +2127,7 @@ static void uv__read(uv_stream_t* stream) {
         err = uv__stream_recv_cmsg(stream, &msg);
         if (err != 0) {
           stream->read_cb(stream, err, &buf);
+          uv__stream_requeue(stream, POLLIN);
           return;
         }
       }
@@ -1150,10 +2160,14 @@ static void uv__read(uv_stream_t* stream) {
       /* Return if we didn't fill the buffer, there is no more data to read. */
       if (nread < buflen) {
         stream->flags |= UV_HANDLE_READ_PARTIAL;
-        return;
+        if (!drain)
+          return;
       }
     }
   }
+
+  if (count < 0)
+    uv__stream_requeue(stream, POLLIN);
 }
 
 
@@ -1204,8 +2218,9 @@ static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   assert(uv__stream_fd(stream) >= 0);
 
   /* Ignore POLLHUP here. Even if it's set, there may still be data to read. */
-  if (events & (POLLIN | POLLERR | POLLHUP))
-    uv__read(stream);
+  if ((events & (POLLIN | POLLERR | POLLHUP)) ||
+      (stream->flags & UV_HANDLE_READ_READY))
+    uv__read(stream, events);
 
   if (uv__stream_fd(stream) == -1)
     return;  /* read_cb closed stream. */
@@ -1381,6 +2396,12 @@ int uv_write2(uv_write_t* req,
   if (stream->connect_req) {
     /* Still connecting, do nothing. */
   }
+  else if (uv__stream_iou(stream)) {
+    /* Submit from the pending queue so that writes made in the same loop
+     * iteration go out in a single send.
+     */
+    uv__io_feed(stream->loop, &stream->io_watcher);
+  }
   else if (empty_queue) {
     uv__write(stream);
   }
@@ -1391,7 +2412,9 @@ int uv_write2(uv_write_t* req,
      * sufficiently flushed in uv__write.
      */
     assert(!(stream->flags & UV_HANDLE_BLOCKING_WRITES));
-    uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
+    uv__io_start(stream->loop,
+                 &stream->io_watcher,
+                 uv__stream_events(stream, POLLOUT));
     uv__stream_osx_interrupt_select(stream);
   }
 
@@ -1454,7 +2477,20 @@ int uv__read_start(uv_stream_t* stream,
   stream->read_cb = read_cb;
   stream->alloc_cb = alloc_cb;
 
-  uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
+  if (uv__stream_iou(stream)) {
+    /* Submit the receive, or deliver what the last one returned, from the
+     * pending queue. Callbacks don't run from inside uv_read_start().
+     */
+#if defined(__linux__)
+    uv__stream_iou(stream)->flags &= ~UV__STREAM_IOU_PROVIDED;
+#endif
+    stream->flags |= UV_HANDLE_READ_READY;
+    uv__io_feed(stream->loop, &stream->io_watcher);
+  } else {
+    uv__io_start(stream->loop,
+                 &stream->io_watcher,
+                 uv__stream_events(stream, POLLIN));
+  }
   uv__handle_start(stream);
   uv__stream_osx_interrupt_select(stream);
 
@@ -1462,12 +2498,53 @@ int uv__read_start(uv_stream_t* stream,
 }
 
 
+int uv__read_start_provided(uv_stream_t* stream, uv_read_cb read_cb) {
+#if defined(__linux__)
+  struct uv__stream_iou* s;
+
+  s = uv__stream_iou(stream);
+  if (s == NULL || uv__iou_pbuf_size(stream->loop) == 0)
+    return UV_ENOSYS;
+
+  /* Data from before the loop had provided buffers can't be handed out. */
+  if (s->buf != NULL && (s->flags & (UV__STREAM_IOU_RECV |
+                                     UV__STREAM_IOU_RESULT))) {
+    return UV_EBUSY;
+  }
+
+  stream->flags |= UV_HANDLE_READING;
+  stream->flags &= ~UV_HANDLE_READ_EOF;
+  stream->read_cb = read_cb;
+  stream->alloc_cb = NULL;
+  s->flags |= UV__STREAM_IOU_PROVIDED;
+
+  /* See uv__read_start(). */
+  stream->flags |= UV_HANDLE_READ_READY;
+  uv__io_feed(stream->loop, &stream->io_watcher);
+  uv__handle_start(stream);
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif
+}
+
+
+int uv_read_buf_release(uv_loop_t* loop, const uv_buf_t* buf) {
+#if defined(__linux__)
+  return uv__stream_iou_release(loop, buf->base);
+#else
+  return UV_EINVAL;
+#endif
+}
+
+
 int uv_read_stop(uv_stream_t* stream) {
   if (!(stream->flags & UV_HANDLE_READING))
     return 0;
 
   stream->flags &= ~UV_HANDLE_READING;
-  uv__io_stop(stream->loop, &stream->io_watcher, POLLIN);
+  uv__io_stop(stream->loop, &stream->io_watcher, POLLIN | UV__POLLRDHUP);
   uv__handle_stop(stream);
   uv__stream_osx_interrupt_select(stream);
 
@@ -1534,6 +2611,9 @@ void uv__stream_close(uv_stream_t* handle) {
   uv__handle_stop(handle);
   handle->flags &= ~(UV_HANDLE_READABLE | UV_HANDLE_WRITABLE);
 
+  /* Takes ownership of the file descriptor if io_uring still references it. */
+  uv__stream_iou_cancel(handle);
+
   if (handle->io_watcher.fd != -1) {
     /* Don't close stdio file descriptors.  Nothing good comes from it. */
     if (handle->io_watcher.fd > STDERR_FILENO)
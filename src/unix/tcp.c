@@ -445,7 +445,8 @@ int uv__tcp_listen(uv_tcp_t* tcp, int backlog, uv_connection_cb cb) {
 
   /* Start listening for connections. */
   tcp->io_watcher.cb = uv__server_io;
-  uv__io_start(tcp->loop, &tcp->io_watcher, POLLIN);
+  if (uv__stream_iou_listen((uv_stream_t*) tcp))
+    uv__io_start(tcp->loop, &tcp->io_watcher, POLLIN);
 
   return 0;
 }
@@ -622,6 +623,14 @@ int uv_tcp_simultaneous_accepts(uv_tcp_t* handle, int enable) {
 }
 
 
+int uv_tcp_zerocopy(uv_tcp_t* handle, int enable, size_t threshold) {
+  if (uv__stream_fd(handle) == -1)
+    return UV_EBADF;
+
+  return uv__stream_iou_zerocopy((uv_stream_t*) handle, enable, threshold);
+}
+
+
 void uv__tcp_close(uv_tcp_t* handle) {
   uv__stream_close((uv_stream_t*)handle);
 }
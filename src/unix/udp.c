@@ -32,6 +32,27 @@
 #endif
 #include <sys/un.h>
 
+#if defined(__linux__)
+# include <netinet/udp.h>
+# ifndef UDP_SEGMENT
+#  define UDP_SEGMENT 103
+# endif
+# ifndef UDP_GRO
+#  define UDP_GRO 104
+# endif
+#endif
+
+/* The most segments and payload bytes the kernel takes per UDP_SEGMENT send. */
+#define UV__UDP_GSO_MAXSEGS 64
+#define UV__UDP_GSO_MAXSIZE 65507
+
+/* uv_udp_send_t has no room for the segment size of a uv_udp_send_gso()
+ * request or for how much of it went out without breaking the ABI, so they
+ * are kept in the request's reserved fields.
+ */
+#define uv__udp_req_segment_size(req) ((size_t) (uintptr_t) (req)->reserved[0])
+#define uv__udp_req_offset(req) ((size_t) (uintptr_t) (req)->reserved[1])
+
 #if defined(IPV6_JOIN_GROUP) && !defined(IPV6_ADD_MEMBERSHIP)
 # define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #endif
@@ -147,13 +168,67 @@ static void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents) {
   }
 }
 
+/* Control message space for the segment size of coalesced datagrams. */
+typedef union {
+  char data[CMSG_SPACE(sizeof(int))];
+  struct cmsghdr align;
+} uv__udp_gro_cmsg_t;
+
+
+/* Returns the size of the datagrams that the kernel coalesced into the message
+ * that |h| describes, or zero if it holds a single datagram.
+ */
+static size_t uv__udp_gro_size(struct msghdr* h) {
+#if defined(__linux__)
+  struct cmsghdr* cmsg;
+  int size;
+
+  if (h->msg_controllen == 0)
+    return 0;
+
+  for (cmsg = CMSG_FIRSTHDR(h); cmsg != NULL; cmsg = CMSG_NXTHDR(h, cmsg)) {
+    if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+      memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+      return size > 0 ? size : 0;
+    }
+  }
+#endif  /* __linux__ */
+
+  return 0;
+}
+
+
+/* Hands the |nread| bytes at |base| to the recv_cb, as |segment| sized
+ * datagrams. Stops early when the callback stops reading.
+ */
+static void uv__udp_recv_segments(uv_udp_t* handle,
+                                  char* base,
+                                  size_t nread,
+                                  size_t segment,
+                                  const struct sockaddr* addr,
+                                  unsigned flags) {
+  uv_buf_t chunk_buf;
+  size_t n;
+
+  do {
+    n = nread < segment ? nread : segment;
+    chunk_buf = uv_buf_init(base, n);
+    handle->recv_cb(handle, n, &chunk_buf, addr, flags | UV_UDP_MMSG_CHUNK);
+    base += n;
+    nread -= n;
+  } while (nread > 0 && handle->recv_cb != NULL);
+}
+
+
 static int uv__udp_recvmmsg(uv_udp_t* handle, uv_buf_t* buf) {
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
   struct sockaddr_in6 peers[20];
   struct iovec iov[ARRAY_SIZE(peers)];
   struct mmsghdr msgs[ARRAY_SIZE(peers)];
+  uv__udp_gro_cmsg_t cmsgs[ARRAY_SIZE(peers)];
   ssize_t nread;
   uv_buf_t chunk_buf;
+  size_t segment;
   size_t chunks;
   int flags;
   size_t k;
@@ -174,6 +249,10 @@ static int uv__udp_recvmmsg(uv_udp_t* handle, uv_buf_t* buf) {
     msgs[k].msg_hdr.msg_controllen = 0;
     msgs[k].msg_hdr.msg_flags = 0;
     msgs[k].msg_len = 0;
+    if (handle->flags & UV_HANDLE_UDP_GRO) {
+      msgs[k].msg_hdr.msg_control = cmsgs[k].data;
+      msgs[k].msg_hdr.msg_controllen = sizeof(cmsgs[k].data);
+    }
   }
 
 #if defined(__APPLE__)
@@ -198,6 +277,17 @@ static int uv__udp_recvmmsg(uv_udp_t* handle, uv_buf_t* buf) {
       if (msgs[k].msg_hdr.msg_flags & MSG_TRUNC)
         flags |= UV_UDP_PARTIAL;
 
+      segment = uv__udp_gro_size(&msgs[k].msg_hdr);
+      if (segment != 0 && segment < msgs[k].msg_len) {
+        uv__udp_recv_segments(handle,
+                              iov[k].iov_base,
+                              msgs[k].msg_len,
+                              segment,
+                              msgs[k].msg_hdr.msg_name,
+                              flags);
+        continue;
+      }
+
       chunk_buf = uv_buf_init(iov[k].iov_base, iov[k].iov_len);
       handle->recv_cb(handle,
                       msgs[k].msg_len,
@@ -218,9 +308,11 @@ static int uv__udp_recvmmsg(uv_udp_t* handle, uv_buf_t* buf) {
 
 static void uv__udp_recvmsg(uv_udp_t* handle) {
   struct sockaddr_storage peer;
+  uv__udp_gro_cmsg_t cmsg;
   struct msghdr h;
   ssize_t nread;
   uv_buf_t buf;
+  size_t segment;
   int flags;
   int count;
 
@@ -254,6 +346,10 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
     h.msg_namelen = sizeof(peer);
     h.msg_iov = (void*) &buf;
     h.msg_iovlen = 1;
+    if (handle->flags & UV_HANDLE_UDP_GRO) {
+      h.msg_control = cmsg.data;
+      h.msg_controllen = sizeof(cmsg.data);
+    }
 
     do {
       nread = recvmsg(handle->io_watcher.fd, &h, 0);
@@ -271,7 +367,24 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
       if (h.msg_flags & MSG_TRUNC)
         flags |= UV_UDP_PARTIAL;
 
-      handle->recv_cb(handle, nread, &buf, (const struct sockaddr*) &peer, flags);
+      /* Coalesced datagrams share the buffer, like recvmmsg() chunks do. */
+      segment = uv__udp_gro_size(&h);
+      if (segment != 0 && segment < (size_t) nread) {
+        uv__udp_recv_segments(handle,
+                              buf.base,
+                              nread,
+                              segment,
+                              (const struct sockaddr*) &peer,
+                              flags);
+        if (handle->recv_cb != NULL)
+          handle->recv_cb(handle, 0, &buf, NULL, UV_UDP_MMSG_FREE);
+      } else {
+        handle->recv_cb(handle,
+                        nread,
+                        &buf,
+                        (const struct sockaddr*) &peer,
+                        flags);
+      }
     }
     count--;
   }
@@ -282,7 +395,11 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
       && handle->recv_cb != NULL);
 }
 
-static void uv__udp_sendmsg_one(uv_udp_t* handle, uv_udp_send_t* req) {
+/* Sends |req| and the requests that follow it, up to the first
+ * uv_udp_send_gso() request. Returns 0 when it gets there and UV_EAGAIN when
+ * it can't go on.
+ */
+static int uv__udp_sendmsg_one(uv_udp_t* handle, uv_udp_send_t* req) {
   struct uv__queue* q;
   struct msghdr h;
   ssize_t size;
@@ -314,7 +431,7 @@ static void uv__udp_sendmsg_one(uv_udp_t* handle, uv_udp_send_t* req) {
 
     if (size == -1)
       if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
-        return;
+        return UV_EAGAIN;
 
     req->status = (size == -1 ? UV__ERR(errno) : size);
 
@@ -328,15 +445,18 @@ static void uv__udp_sendmsg_one(uv_udp_t* handle, uv_udp_send_t* req) {
     uv__io_feed(handle->loop, &handle->io_watcher);
 
     if (uv__queue_empty(&handle->write_queue))
-      return;
+      return 0;
 
     q = uv__queue_head(&handle->write_queue);
     req = uv__queue_data(q, uv_udp_send_t, queue);
+    if (uv__udp_req_segment_size(req) != 0)
+      return 0;
   }
 }
 
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
-static void uv__udp_sendmsg_many(uv_udp_t* handle) {
+/* Same as uv__udp_sendmsg_one() but batches the datagrams. */
+static int uv__udp_sendmsg_many(uv_udp_t* handle) {
   uv_udp_send_t* req;
   struct mmsghdr h[20];
   struct mmsghdr* p;
@@ -350,6 +470,8 @@ write_queue_drain:
        pkts < ARRAY_SIZE(h) && q != &handle->write_queue;
        ++pkts, q = uv__queue_head(q)) {
     req = uv__queue_data(q, uv_udp_send_t, queue);
+    if (uv__udp_req_segment_size(req) != 0)
+      break;
 
     p = &h[pkts];
     memset(p, 0, sizeof(*p));
@@ -385,7 +507,7 @@ write_queue_drain:
 
   if (npkts < 1) {
     if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
-      return;
+      return UV_EAGAIN;
     for (i = 0, q = uv__queue_head(&handle->write_queue);
          i < pkts && q != &handle->write_queue;
          ++i, q = uv__queue_head(&handle->write_queue)) {
@@ -395,7 +517,7 @@ write_queue_drain:
       uv__queue_insert_tail(&handle->write_completed_queue, &req->queue);
     }
     uv__io_feed(handle->loop, &handle->io_watcher);
-    return;
+    return UV_EAGAIN;
   }
 
   /* Safety: npkts known to be >0 below. Hence cast from ssize_t
@@ -417,33 +539,284 @@ write_queue_drain:
   }
 
   /* couldn't batch everything, continue sending (jump to avoid stack growth) */
-  if (!uv__queue_empty(&handle->write_queue))
-    goto write_queue_drain;
+  if (!uv__queue_empty(&handle->write_queue)) {
+    q = uv__queue_head(&handle->write_queue);
+    req = uv__queue_data(q, uv_udp_send_t, queue);
+    if (uv__udp_req_segment_size(req) == 0)
+      goto write_queue_drain;
+  }
 
   uv__io_feed(handle->loop, &handle->io_watcher);
+  return 0;
 }
 #endif  /* __linux__ || ____FreeBSD__ || __APPLE__ */
 
+
+static void uv__udp_msg_name(struct msghdr* h, struct sockaddr_storage* addr) {
+  if (addr->ss_family == AF_UNSPEC) {
+    h->msg_name = NULL;
+    h->msg_namelen = 0;
+    return;
+  }
+
+  h->msg_name = addr;
+  if (addr->ss_family == AF_INET6)
+    h->msg_namelen = sizeof(struct sockaddr_in6);
+  else if (addr->ss_family == AF_INET)
+    h->msg_namelen = sizeof(struct sockaddr_in);
+  else if (addr->ss_family == AF_UNIX)
+    h->msg_namelen = sizeof(struct sockaddr_un);
+  else {
+    assert(0 && "unsupported address family");
+    abort();
+  }
+}
+
+
+/* Points |iov| at the |len| bytes of |bufs| that start |off| bytes in.
+ * Returns the number of iovecs used, never more than |nbufs|.
+ */
+static size_t uv__udp_slice(const uv_buf_t* bufs,
+                            unsigned int nbufs,
+                            size_t off,
+                            size_t len,
+                            struct iovec* iov) {
+  unsigned int k;
+  size_t n;
+
+  n = 0;
+  for (k = 0; k < nbufs && len > 0; k++) {
+    if (off >= bufs[k].len) {
+      off -= bufs[k].len;
+      continue;
+    }
+
+    iov[n].iov_base = bufs[k].base + off;
+    iov[n].iov_len = bufs[k].len - off;
+    if (iov[n].iov_len > len)
+      iov[n].iov_len = len;
+
+    len -= iov[n].iov_len;
+    off = 0;
+    n++;
+  }
+
+  return n;
+}
+
+
+#if defined(__linux__)
+/* Sends as many segments of |req| as the kernel takes in one go, starting
+ * |off| bytes in. Returns the number of bytes sent or an error.
+ */
+static ssize_t uv__udp_sendmsg_segments(uv_udp_t* handle,
+                                        uv_udp_send_t* req,
+                                        struct iovec* iov,
+                                        size_t off,
+                                        size_t size) {
+  union {
+    char data[CMSG_SPACE(sizeof(uint16_t))];
+    struct cmsghdr align;
+  } u;
+  struct cmsghdr* cmsg;
+  struct msghdr h;
+  uint16_t segment;
+  size_t len;
+  ssize_t r;
+
+  len = uv__udp_req_segment_size(req);
+  if (len < UV__UDP_GSO_MAXSIZE / UV__UDP_GSO_MAXSEGS)
+    len *= UV__UDP_GSO_MAXSEGS;
+  else if (len < UV__UDP_GSO_MAXSIZE)
+    len *= UV__UDP_GSO_MAXSIZE / len;
+  if (len > size - off)
+    len = size - off;
+
+  memset(&h, 0, sizeof(h));
+  uv__udp_msg_name(&h, &req->addr);
+  h.msg_iov = iov;
+  h.msg_iovlen = uv__udp_slice(req->bufs, req->nbufs, off, len, iov);
+
+  if (len > uv__udp_req_segment_size(req)) {
+    memset(&u, 0, sizeof(u));
+    h.msg_control = u.data;
+    h.msg_controllen = sizeof(u.data);
+    segment = uv__udp_req_segment_size(req);
+    cmsg = CMSG_FIRSTHDR(&h);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(segment));
+    memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+  }
+
+  do
+    r = sendmsg(handle->io_watcher.fd, &h, 0);
+  while (r == -1 && errno == EINTR);
+
+  if (r == -1)
+    return UV__ERR(errno);
+
+  return r;
+}
+#endif  /* __linux__ */
+
+
+/* Splits |req| into datagrams and sends a batch of them, starting |off| bytes
+ * in. Returns the number of bytes sent or an error.
+ */
+static ssize_t uv__udp_sendmsg_split(uv_udp_t* handle,
+                                     uv_udp_send_t* req,
+                                     struct iovec* iov,
+                                     size_t off,
+                                     size_t size) {
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+  struct mmsghdr h[20];
+#else
+  struct { struct msghdr msg_hdr; } h[1];
+#endif
+  size_t segment;
+  size_t pkts;
+  size_t len;
+  size_t n;
+  ssize_t npkts;
+
+  segment = uv__udp_req_segment_size(req);
+  pkts = 0;
+  len = 0;
+
+  do {
+    n = segment;
+    if (n > size - off - len)
+      n = size - off - len;
+
+    memset(&h[pkts], 0, sizeof(h[pkts]));
+    uv__udp_msg_name(&h[pkts].msg_hdr, &req->addr);
+    h[pkts].msg_hdr.msg_iov = iov;
+    h[pkts].msg_hdr.msg_iovlen =
+        uv__udp_slice(req->bufs, req->nbufs, off + len, n, iov);
+
+    iov += h[pkts].msg_hdr.msg_iovlen;
+    len += n;
+    pkts++;
+  } while (pkts < ARRAY_SIZE(h) && off + len < size);
+
+#if defined(__APPLE__)
+  do
+    npkts = sendmsg_x(handle->io_watcher.fd, h, pkts, MSG_DONTWAIT);
+  while (npkts == -1 && errno == EINTR);
+#elif defined(__linux__) || defined(__FreeBSD__)
+  do
+    npkts = sendmmsg(handle->io_watcher.fd, h, pkts, 0);
+  while (npkts == -1 && errno == EINTR);
+#else
+  do
+    npkts = sendmsg(handle->io_watcher.fd, &h[0].msg_hdr, 0);
+  while (npkts == -1 && errno == EINTR);
+
+  if (npkts != -1)
+    npkts = 1;
+#endif
+
+  if (npkts == -1)
+    return UV__ERR(errno);
+
+  if ((size_t) npkts == pkts)
+    return len;
+
+  return npkts * segment;
+}
+
+
+/* Sends the datagrams of a uv_udp_send_gso() request. Returns 0 when |req|
+ * is done and UV_EAGAIN when the socket can't take more.
+ */
+static int uv__udp_sendmsg_gso(uv_udp_t* handle, uv_udp_send_t* req) {
+  struct iovec iovsml[64];
+  struct iovec* iov;
+  ssize_t r;
+  size_t size;
+  size_t off;
+  size_t n;
+
+  /* A batch of datagrams can't take up more iovecs than that. */
+  n = req->nbufs + 20;
+  iov = iovsml;
+  if (n > ARRAY_SIZE(iovsml))
+    iov = uv__malloc(n * sizeof(*iov));
+
+  size = uv__count_bufs(req->bufs, req->nbufs);
+  off = uv__udp_req_offset(req);
+  r = UV_ENOMEM;
+
+  if (iov != NULL) {
+    do {
+      r = UV_ENOTSUP;
+#if defined(__linux__)
+      if (uv__kernel_version() < /* 4.18.0 */ 0x041200)
+        handle->flags &= ~UV_HANDLE_UDP_GSO;
+
+      if (handle->flags & UV_HANDLE_UDP_GSO)
+        r = uv__udp_sendmsg_segments(handle, req, iov, off, size);
+
+      /* The route has no checksum offload, stop asking. EINVAL usually means
+       * the segments don't fit in the MTU, split this one the hard way.
+       */
+      if (r == UV_EIO)
+        handle->flags &= ~UV_HANDLE_UDP_GSO;
+#endif
+      if (r == UV_ENOTSUP || r == UV_EIO || r == UV_EINVAL)
+        r = uv__udp_sendmsg_split(handle, req, iov, off, size);
+
+      if (r < 0)
+        break;
+
+      off += r;
+    } while (off < size);
+  }
+
+  if (iov != iovsml)
+    uv__free(iov);
+
+  req->reserved[1] = (void*) (uintptr_t) off;
+
+  if (r == UV_EAGAIN || r == UV_ENOBUFS)
+    return UV_EAGAIN;
+
+  req->status = r < 0 ? r : (ssize_t) off;
+  uv__queue_remove(&req->queue);
+  uv__queue_insert_tail(&handle->write_completed_queue, &req->queue);
+  uv__io_feed(handle->loop, &handle->io_watcher);
+
+  return 0;
+}
+
+
 static void uv__udp_sendmsg(uv_udp_t* handle) {
   struct uv__queue* q;
   uv_udp_send_t* req;
+  int err;
 
-  if (uv__queue_empty(&handle->write_queue))
-    return;
-
-  q = uv__queue_head(&handle->write_queue);
-  req = uv__queue_data(q, uv_udp_send_t, queue);
+  while (!uv__queue_empty(&handle->write_queue)) {
+    q = uv__queue_head(&handle->write_queue);
+    req = uv__queue_data(q, uv_udp_send_t, queue);
 
+    if (uv__udp_req_segment_size(req) != 0)
+      err = uv__udp_sendmsg_gso(handle, req);
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
-  /* Use sendmmsg() if this send request contains more than one datagram OR
-   * there is more than one send request (because that automatically implies
-   * there is more than one datagram.)
-   */
-  if (req->nbufs != 1 || &handle->write_queue != uv__queue_next(&req->queue))
-    return uv__udp_sendmsg_many(handle);
+    /* Use sendmmsg() if this send request contains more than one datagram OR
+     * there is more than one send request (because that automatically implies
+     * there is more than one datagram.)
+     */
+    else if (req->nbufs != 1 ||
+             &handle->write_queue != uv__queue_next(&req->queue))
+      err = uv__udp_sendmsg_many(handle);
 #endif
+    else
+      err = uv__udp_sendmsg_one(handle, req);
 
-  return uv__udp_sendmsg_one(handle, req);
+    if (err)
+      return;
+  }
 }
 
 /* On the BSDs, SO_REUSEPORT implies SO_REUSEADDR but with some additional
@@ -725,6 +1098,19 @@ int uv__udp_send(uv_udp_send_t* req,
                  const struct sockaddr* addr,
                  unsigned int addrlen,
                  uv_udp_send_cb send_cb) {
+  return uv__udp_send_gso(req, handle, bufs, nbufs, addr, addrlen, 0, send_cb);
+}
+
+
+/* A |segment_size| of zero sends |bufs| as a single datagram. */
+int uv__udp_send_gso(uv_udp_send_t* req,
+                     uv_udp_t* handle,
+                     const uv_buf_t bufs[],
+                     unsigned int nbufs,
+                     const struct sockaddr* addr,
+                     unsigned int addrlen,
+                     size_t segment_size,
+                     uv_udp_send_cb send_cb) {
   int err;
   int empty_queue;
 
@@ -751,6 +1137,8 @@ int uv__udp_send(uv_udp_send_t* req,
   req->send_cb = send_cb;
   req->handle = handle;
   req->nbufs = nbufs;
+  req->reserved[0] = (void*) (uintptr_t) segment_size;
+  req->reserved[1] = (void*) (uintptr_t) 0;
 
   req->bufs = req->bufsml;
   if (nbufs > ARRAY_SIZE(req->bufsml))
@@ -1380,6 +1768,18 @@ int uv__udp_recv_start(uv_udp_t* handle,
   if (err)
     return err;
 
+#if defined(__linux__)
+  if (handle->flags & UV_HANDLE_UDP_GRO) {
+    int on = 1;
+    if (setsockopt(handle->io_watcher.fd,
+                   IPPROTO_UDP,
+                   UDP_GRO,
+                   &on,
+                   sizeof(on)))
+      handle->flags &= ~UV_HANDLE_UDP_GRO;  /* Linux < 5.0, not fatal. */
+  }
+#endif
+
   handle->alloc_cb = alloc_cb;
   handle->recv_cb = recv_cb;
 
@@ -354,14 +354,19 @@ int uv_udp_init_ex(uv_loop_t* loop, uv_udp_t* handle, unsigned flags) {
 
   /* Use the higher bits for extra flags. */
   extra_flags = flags & ~0xFF;
-  if (extra_flags & ~UV_UDP_RECVMMSG)
+  if (extra_flags & ~(UV_UDP_RECVMMSG | UV_UDP_GSO | UV_UDP_GRO))
     return UV_EINVAL;
 
   rc = uv__udp_init_ex(loop, handle, flags, domain);
 
-  if (rc == 0)
+  if (rc == 0) {
     if (extra_flags & UV_UDP_RECVMMSG)
       handle->flags |= UV_HANDLE_UDP_RECVMMSG;
+    if (extra_flags & UV_UDP_GSO)
+      handle->flags |= UV_HANDLE_UDP_GSO;
+    if (extra_flags & UV_UDP_GRO)
+      handle->flags |= UV_HANDLE_UDP_GRO;
+  }
 
   return rc;
 }
@@ -500,6 +505,33 @@ int uv_udp_send(uv_udp_send_t* req,
 }
 
 
+int uv_udp_send_gso(uv_udp_send_t* req,
+                    uv_udp_t* handle,
+                    const uv_buf_t bufs[],
+                    unsigned int nbufs,
+                    const struct sockaddr* addr,
+                    size_t segment_size,
+                    uv_udp_send_cb send_cb) {
+  int addrlen;
+
+  if (segment_size == 0)
+    return UV_EINVAL;
+
+  addrlen = uv__udp_check_before_send(handle, addr);
+  if (addrlen < 0)
+    return addrlen;
+
+  return uv__udp_send_gso(req,
+                          handle,
+                          bufs,
+                          nbufs,
+                          addr,
+                          addrlen,
+                          segment_size,
+                          send_cb);
+}
+
+
 int uv_udp_try_send(uv_udp_t* handle,
                     const uv_buf_t bufs[],
                     unsigned int nbufs,
@@ -633,6 +665,21 @@ size_t uv__count_bufs(const uv_buf_t bufs[], unsigned int nbufs) {
   return bytes;
 }
 
+
+void uv__cpu_relax(void) {
+#if defined(_WIN32)
+  YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__ ("rep; nop" ::: "memory");  /* a.k.a. PAUSE */
+#elif (defined(__arm__) && __ARM_ARCH >= 7) || defined(__aarch64__)
+  __asm__ __volatile__ ("yield" ::: "memory");
+#elif (defined(__ppc__) || defined(__ppc64__)) && defined(__APPLE__)
+  __asm volatile ("" : : : "memory");
+#elif !defined(__APPLE__) && (defined(__powerpc64__) || defined(__ppc64__) || defined(__PPC64__))
+  __asm__ __volatile__ ("or 1,1,1; or 2,2,2" ::: "memory");
+#endif
+}
+
 int uv_recv_buffer_size(uv_handle_t* handle, int* value) {
   return uv__socket_sockopt(handle, SO_RCVBUF, value);
 }
@@ -804,12 +851,36 @@ void uv__fs_readdir_cleanup(uv_fs_t* req) {
 
 
 int uv_loop_configure(uv_loop_t* loop, uv_loop_option option, ...) {
+  uv_threadpool_t* pool;
+  unsigned int kinds;
   va_list ap;
+  int prio;
   int err;
 
   va_start(ap, option);
   /* Any platform-agnostic options should be handled here. */
-  err = uv__loop_configure(loop, option, ap);
+  if (option == UV_LOOP_USE_TIMER_WHEEL) {
+    err = uv__timer_wheel_init(loop);
+  } else if (option == UV_LOOP_TIMER_SLACK) {
+    uv__get_internal_fields(loop)->timer_slack = va_arg(ap, unsigned int);
+    err = 0;
+  } else if (option == UV_LOOP_THREADPOOL) {
+    kinds = va_arg(ap, unsigned int);
+    pool = va_arg(ap, uv_threadpool_t*);
+    err = uv__threadpool_bind(loop, kinds, pool);
+  } else if (option == UV_METRICS_THREADPOOL_TIME) {
+    uv__get_internal_fields(loop)->flags |= UV__METRICS_THREADPOOL_TIME;
+    err = 0;
+  } else if (option == UV_LOOP_WORK_PRIORITY) {
+    prio = va_arg(ap, int);
+    err = UV_EINVAL;
+    if (prio >= UV_WORK_PRIORITY_CRITICAL &&
+        prio <= UV_WORK_PRIORITY_BACKGROUND) {
+      uv__get_internal_fields(loop)->wq_priority = prio;
+      err = 0;
+    }
+  } else
+    err = uv__loop_configure(loop, option, ap);
   va_end(ap);
 
   return err;
@@ -864,6 +935,8 @@ int uv_loop_close(uv_loop_t* loop) {
       return UV_EBUSY;
   }
 
+  uv__timer_wheel_free(loop);
+  uv__threadpool_unbind(loop);
   uv__loop_close(loop);
 
 #ifndef NDEBUG
@@ -911,6 +984,23 @@ int uv_read_start(uv_stream_t* stream,
 }
 
 
+int uv_read_start_provided(uv_stream_t* stream, uv_read_cb read_cb) {
+  if (stream == NULL || read_cb == NULL)
+    return UV_EINVAL;
+
+  if (stream->flags & UV_HANDLE_CLOSING)
+    return UV_EINVAL;
+
+  if (stream->flags & UV_HANDLE_READING)
+    return UV_EALREADY;
+
+  if (!(stream->flags & UV_HANDLE_READABLE))
+    return UV_ENOTCONN;
+
+  return uv__read_start_provided(stream, read_cb);
+}
+
+
 void uv_os_free_environ(uv_env_item_t* envitems, int count) {
   int i;
 
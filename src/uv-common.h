@@ -88,6 +88,7 @@ enum {
   /* Used by streams. */
   UV_HANDLE_LISTENING                   = 0x00000040,
   UV_HANDLE_CONNECTION                  = 0x00000080,
+  UV_HANDLE_READ_READY                  = 0x00000100,
   UV_HANDLE_SHUT                        = 0x00000200,
   UV_HANDLE_READ_PARTIAL                = 0x00000400,
   UV_HANDLE_READ_EOF                    = 0x00000800,
@@ -118,6 +119,8 @@ enum {
   UV_HANDLE_UDP_PROCESSING              = 0x01000000,
   UV_HANDLE_UDP_CONNECTED               = 0x02000000,
   UV_HANDLE_UDP_RECVMMSG                = 0x04000000,
+  UV_HANDLE_UDP_GSO                     = 0x08000000,
+  UV_HANDLE_UDP_GRO                     = 0x10000000,
 
   /* Only used by uv_pipe_t handles. */
   UV_HANDLE_NON_OVERLAPPED_PIPE         = 0x01000000,
@@ -136,11 +139,19 @@ enum {
   /* Only used by uv_poll_t handles. */
   UV_HANDLE_POLL_SLOW                   = 0x01000000,
 
+  /* Only used by uv_async_t handles. */
+  UV_HANDLE_ASYNC_CHANNEL               = 0x01000000,
+
+  /* Only used by uv_timer_t handles. */
+  UV_HANDLE_TIMER_STRICT                = 0x01000000,
+
   /* Only used by uv_process_t handles. */
   UV_HANDLE_REAP                        = 0x10000000
 };
 
 int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap);
+int uv__timer_wheel_init(uv_loop_t* loop);
+void uv__timer_wheel_free(uv_loop_t* loop);
 
 void uv__loop_close(uv_loop_t* loop);
 
@@ -148,6 +159,8 @@ int uv__read_start(uv_stream_t* stream,
                    uv_alloc_cb alloc_cb,
                    uv_read_cb read_cb);
 
+int uv__read_start_provided(uv_stream_t* stream, uv_read_cb read_cb);
+
 int uv__tcp_bind(uv_tcp_t* tcp,
                  const struct sockaddr* addr,
                  unsigned int addrlen,
@@ -185,6 +198,15 @@ int uv__udp_send(uv_udp_send_t* req,
                  unsigned int addrlen,
                  uv_udp_send_cb send_cb);
 
+int uv__udp_send_gso(uv_udp_send_t* req,
+                     uv_udp_t* handle,
+                     const uv_buf_t bufs[],
+                     unsigned int nbufs,
+                     const struct sockaddr* addr,
+                     unsigned int addrlen,
+                     size_t segment_size,
+                     uv_udp_send_cb send_cb);
+
 int uv__udp_try_send(uv_udp_t* handle,
                      const uv_buf_t bufs[],
                      unsigned int nbufs,
@@ -214,8 +236,17 @@ void uv__work_submit(uv_loop_t* loop,
 
 void uv__work_done(uv_async_t* handle);
 
+int uv__threadpool_bind(uv_loop_t* loop,
+                        unsigned int kinds,
+                        uv_threadpool_t* pool);
+
+void uv__threadpool_unbind(uv_loop_t* loop);
+
 size_t uv__count_bufs(const uv_buf_t bufs[], unsigned int nbufs);
 
+void uv__cpu_relax(void);
+int uv__cpu_numa_node(int cpu);  /* 0 when unknown. */
+
 int uv__socket_sockopt(uv_handle_t* handle, int optname, int* value);
 
 void uv__fs_scandir_cleanup(uv_fs_t* req);
@@ -417,14 +448,33 @@ struct uv__iou {
 };
 #endif  /* __linux__ */
 
+/* uv__loop_internal_fields_t flags, next to UV_METRICS_IDLE_TIME. */
+#define UV__METRICS_THREADPOOL_TIME 0x100
+
 struct uv__loop_internal_fields_s {
   unsigned int flags;
   uv__loop_metrics_t loop_metrics;
   int current_timeout;
+  void* timer_wheel;  /* struct uv__timer_wheel, see uv__timer_wheel_init() */
+  uint64_t timer_slack;
+  void* wq_done;  /* finished struct uv__work stack, see uv__work_finish() */
+  unsigned int wq_worker;  /* preferred worker + 1, see uv__work_submit() */
+  void* wq_pools[3];  /* struct uv__threadpool per enum uv__work_kind */
+  int wq_priority;  /* uv_work_priority */
+  int wq_node;  /* NUMA node + 1 of the loop thread, -1 if unknown. */
+  uv_threadpool_kind_metrics_t wq_metrics[3];  /* per enum uv__work_kind */
+#ifndef _WIN32
+  void* async_pending;  /* uv_async_t stack, see uv_async_send() */
+  struct uv__queue async_ready;
+#endif  /* !_WIN32 */
 #ifdef __linux__
   struct uv__iou ctl;
   struct uv__iou iou;
   void* inv;  /* used by uv__platform_invalidate_fd() */
+  uint64_t* iou_polls;  /* armed poll per fd, see uv__iou_poll_arm() */
+  unsigned int niou_polls;
+  uint32_t iou_pollgen;
+  void* iou_pbuf;  /* struct uv__iou_pbuf, see uv__iou_pbuf_init() */
 #endif  /* __linux__ */
 };
 
@@ -27,6 +27,27 @@
 #include "handle-inl.h"
 #include "req-inl.h"
 
+/* Number of messages that are passed to the channel callback at once. */
+#define UV__CHANNEL_BATCH 64
+
+#define uv__channel_load(p) ((ULONG) InterlockedOr((LONG volatile*) (p), 0))
+
+/* The bounded multi-producer queue of src/unix/async.c. The counters are 32
+ * bits wide so that the Interlocked functions work on them everywhere. They
+ * wrap around, that's fine because the capacity is at most 2^30.
+ */
+struct uv__channel_slot {
+  LONG volatile seq;
+  void* msg;
+};
+
+struct uv__channel_ring {
+  LONG volatile tail;  /* Next slot to claim for producers. */
+  ULONG head;  /* Next slot to read, only used by the loop thread. */
+  ULONG mask;
+  struct uv__channel_slot* slots;
+};
+
 
 void uv__async_endgame(uv_loop_t* loop, uv_async_t* handle) {
   if (handle->flags & UV_HANDLE_CLOSING &&
@@ -54,7 +75,35 @@ int uv_async_init(uv_loop_t* loop, uv_async_t* handle, uv_async_cb async_cb) {
 }
 
 
+static void uv__channel_close(uv_channel_t* channel) {
+  LONG volatile* busy;
+  void* ring;
+  int i;
+
+  /* Producers that come after this see no ring, wait for the ones that are
+   * already inside uv_channel_send().
+   */
+  ring = InterlockedExchangePointer(&channel->ring, NULL);
+  busy = (LONG volatile*) &channel->u.fd;
+  for (i = 0; InterlockedOr(busy, 0) != 0; i++) {
+    if (i < 997) {
+      uv__cpu_relax();
+    } else {
+      SwitchToThread();
+      i = 0;
+    }
+  }
+
+  /* Messages that have not been delivered yet are dropped. */
+  uv__free(ring);
+}
+
+
 void uv__async_close(uv_loop_t* loop, uv_async_t* handle) {
+  /* Wait for the channel's producers first, they may still post a wakeup. */
+  if (handle->flags & UV_HANDLE_ASYNC_CHANNEL)
+    uv__channel_close((uv_channel_t*) handle);
+
   if (!((uv_async_t*)handle)->async_sent) {
     uv__want_endgame(loop, (uv_handle_t*) handle);
   }
@@ -96,3 +145,148 @@ void uv__process_async_wakeup_req(uv_loop_t* loop, uv_async_t* handle,
     handle->async_cb(handle);
   }
 }
+
+
+static void uv__channel_io(uv_async_t* handle) {
+  struct uv__channel_ring* ring;
+  struct uv__channel_slot* slot;
+  uv_channel_t* channel;
+  void* msgs[UV__CHANNEL_BATCH];
+  unsigned int nmsgs;
+  ULONG budget;
+
+  channel = (uv_channel_t*) handle;
+  ring = channel->ring;
+
+  /* async_sent has just been cleared. Either we see the messages or the
+   * producer sees it cleared and posts another wakeup, see uv_channel_send().
+   */
+  MemoryBarrier();
+
+  /* Don't let producers that keep the channel full starve the loop, come back
+   * in the next loop iteration after a full round.
+   */
+  for (budget = ring->mask + 1; budget > 0; budget -= nmsgs) {
+    for (nmsgs = 0; nmsgs < budget && nmsgs < UV__CHANNEL_BATCH; nmsgs++) {
+      slot = &ring->slots[ring->head & ring->mask];
+      if (uv__channel_load(&slot->seq) != ring->head + 1)
+        break;  /* Empty, or the producer is still busy with it. */
+
+      msgs[nmsgs] = slot->msg;
+      InterlockedExchange(&slot->seq, (LONG) (ring->head + ring->mask + 1));
+      ring->head++;
+    }
+
+    if (nmsgs == 0)
+      return;
+
+    channel->channel_cb(channel, msgs, nmsgs);
+
+    if (uv__is_closing(channel))
+      return;
+  }
+
+  uv_async_send(handle);
+}
+
+
+int uv_channel_init(uv_loop_t* loop,
+                    uv_channel_t* channel,
+                    unsigned int capacity,
+                    uv_channel_cb channel_cb) {
+  struct uv__channel_ring* ring;
+  ULONG size;
+  ULONG i;
+  int err;
+
+  if (capacity == 0 || capacity > 1u << 30 || channel_cb == NULL)
+    return UV_EINVAL;
+
+  size = 1;
+  while (size < capacity)
+    size *= 2;
+
+  ring = uv__malloc(sizeof(*ring) + size * sizeof(ring->slots[0]));
+  if (ring == NULL)
+    return UV_ENOMEM;
+
+  ring->slots = (struct uv__channel_slot*) (ring + 1);
+  ring->mask = size - 1;
+  ring->head = 0;
+  ring->tail = 0;
+  for (i = 0; i < size; i++)
+    ring->slots[i].seq = (LONG) i;
+
+  err = uv_async_init(loop, (uv_async_t*) channel, uv__channel_io);
+  if (err) {
+    uv__free(ring);
+    return err;
+  }
+
+  channel->u.fd = 0;  /* Number of producers inside uv_channel_send(). */
+  channel->flags |= UV_HANDLE_ASYNC_CHANNEL;
+  channel->channel_cb = channel_cb;
+  channel->ring = ring;
+
+  return 0;
+}
+
+
+int uv_channel_send(uv_channel_t* channel, void* msg) {
+  struct uv__channel_ring* ring;
+  struct uv__channel_slot* slot;
+  LONG volatile* busy;
+  ULONG pos;
+  LONG diff;
+  int err;
+
+  busy = (LONG volatile*) &channel->u.fd;
+
+  /* Keep uv_close() from freeing the ring under our feet. Pairs with
+   * uv__channel_close(): either it sees us busy and waits, or we see the ring
+   * gone.
+   */
+  InterlockedIncrement(busy);
+  ring = InterlockedCompareExchangePointer(&channel->ring, NULL, NULL);
+  if (ring == NULL) {
+    InterlockedDecrement(busy);
+    return UV_EBADF;
+  }
+
+  err = 0;
+  pos = uv__channel_load(&ring->tail);
+  for (;;) {
+    slot = &ring->slots[pos & ring->mask];
+    diff = (LONG) (uv__channel_load(&slot->seq) - pos);
+
+    if (diff == 0) {
+      if ((ULONG) InterlockedCompareExchange(&ring->tail,
+                                             (LONG) (pos + 1),
+                                             (LONG) pos) == pos)
+        break;
+    } else if (diff < 0) {
+      err = UV_EAGAIN;  /* Full. */
+      break;
+    }
+
+    pos = uv__channel_load(&ring->tail);
+  }
+
+  if (err == 0) {
+    slot->msg = msg;
+    InterlockedExchange(&slot->seq, (LONG) (pos + 1));
+
+    /* Only wake up the loop when no wakeup is in flight already. The loop
+     * clears async_sent before it looks at the slots. Don't go through
+     * uv_async_send(), the loop thread may be closing the handle.
+     */
+    if (!channel->async_sent &&
+        !uv__atomic_exchange_set(&channel->async_sent)) {
+      POST_COMPLETION_FOR_REQ(channel->loop, &channel->async_req);
+    }
+  }
+
+  InterlockedDecrement(busy);
+
+  return err;
+}
@@ -363,6 +363,7 @@ void uv__loop_close(uv_loop_t* loop) {
   uv_mutex_unlock(&loop->wq_mutex);
   uv_mutex_destroy(&loop->wq_mutex);
 
+  heap_free(loop->timer_heap);
   uv__free(loop->timer_heap);
   loop->timer_heap = NULL;
 
@@ -749,6 +750,15 @@ int uv__socket_sockopt(uv_handle_t* handle, int optname, int* value) {
   return 0;
 }
 
+int uv__cpu_numa_node(int cpu) {
+  UCHAR node;
+
+  if (cpu < 0 || cpu > 63 || !GetNumaProcessorNode((UCHAR) cpu, &node))
+    return 0;
+
+  return node;
+}
+
 int uv_cpumask_size(void) {
   return (int)(sizeof(DWORD_PTR) * 8);
 }
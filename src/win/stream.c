@@ -91,6 +91,17 @@ int uv__read_start(uv_stream_t* handle,
 }
 
 
+int uv__read_start_provided(uv_stream_t* handle, uv_read_cb read_cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_read_buf_release(uv_loop_t* loop, const uv_buf_t* buf) {
+  /* uv_read_start_provided() isn't supported, there is nothing to release. */
+  return UV_EINVAL;
+}
+
+
 int uv_read_stop(uv_stream_t* handle) {
   int err;
 
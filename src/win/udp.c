@@ -28,6 +28,23 @@
 #include "stream-inl.h"
 #include "req-inl.h"
 
+/* uv_udp_send_t has no room for the state of a uv_udp_send_gso() request
+ * without breaking the ABI, so it's kept in the request's reserved fields.
+ */
+#define uv__udp_req_segment_size(req) ((size_t) (uintptr_t) (req)->reserved[0])
+#define uv__udp_req_offset(req) ((size_t) (uintptr_t) (req)->reserved[1])
+#define uv__udp_req_gso(req) ((struct uv__udp_gso*) (req)->reserved[2])
+
+/* What a uv_udp_send_gso() request needs to send its next datagram. */
+struct uv__udp_gso {
+  struct sockaddr_storage addr;
+  int addrlen;
+  size_t size;
+  unsigned int nbufs;
+  uv_buf_t* bufs;
+  uv_buf_t* slice;  /* The buffers of the datagram that is being sent. */
+};
+
 
 /* A zero-size buffer for use by uv_udp_read */
 static char uv_zero_[] = "";
@@ -364,6 +381,7 @@ static int uv__send(uv_udp_send_t* req,
   UV_REQ_INIT(req, UV_UDP_SEND);
   req->handle = handle;
   req->cb = cb;
+  req->reserved[0] = NULL;
   memset(&req->u.io.overlapped, 0, sizeof(req->u.io.overlapped));
 
   result = WSASendTo(handle->socket,
@@ -522,12 +540,102 @@ done:
 }
 
 
+/* Sends the next datagram of a uv_udp_send_gso() request. This function is
+ * not an egress point, it returns system errors.
+ */
+static int uv__udp_send_segment(uv_udp_send_t* req) {
+  uv_udp_t* handle = req->handle;
+  struct uv__udp_gso* gso;
+  const struct sockaddr* addr;
+  unsigned int nslice;
+  unsigned int i;
+  size_t skip;
+  size_t left;
+  size_t len;
+  DWORD result, bytes;
+
+  gso = uv__udp_req_gso(req);
+  skip = uv__udp_req_offset(req);
+  left = uv__udp_req_segment_size(req);
+  if (left > gso->size - skip)
+    left = gso->size - skip;
+
+  req->reserved[1] = (void*) (uintptr_t) (skip + left);
+
+  /* The datagram may straddle buffer boundaries. */
+  nslice = 0;
+  for (i = 0; i < gso->nbufs && left > 0; i++) {
+    if (skip >= gso->bufs[i].len) {
+      skip -= gso->bufs[i].len;
+      continue;
+    }
+
+    len = gso->bufs[i].len - skip;
+    if (len > left)
+      len = left;
+
+    gso->slice[nslice++] = uv_buf_init(gso->bufs[i].base + skip,
+                                       (unsigned int) len);
+    left -= len;
+    skip = 0;
+  }
+
+  if (nslice == 0)
+    gso->slice[nslice++] = uv_buf_init(NULL, 0);  /* Empty payload. */
+
+  addr = NULL;
+  if (gso->addrlen > 0)
+    addr = (const struct sockaddr*) &gso->addr;
+
+  memset(&req->u.io.overlapped, 0, sizeof(req->u.io.overlapped));
+  result = WSASendTo(handle->socket,
+                     (WSABUF*) gso->slice,
+                     nslice,
+                     &bytes,
+                     0,
+                     addr,
+                     gso->addrlen,
+                     &req->u.io.overlapped,
+                     NULL);
+
+  if (UV_SUCCEEDED_WITHOUT_IOCP(result == 0)) {
+    /* Request completed immediately. */
+    uv__insert_pending_req(handle->loop, (uv_req_t*) req);
+  } else if (!UV_SUCCEEDED_WITH_IOCP(result == 0)) {
+    /* Send failed due to an error. */
+    return WSAGetLastError();
+  }
+
+  return 0;
+}
+
+
 void uv__process_udp_send_req(uv_loop_t* loop, uv_udp_t* handle,
     uv_udp_send_t* req) {
   int err;
 
   assert(handle->type == UV_UDP);
 
+  err = 0;
+  if (!REQ_SUCCESS(req)) {
+    err = GET_REQ_SOCK_ERROR(req);
+  }
+
+  /* A uv_udp_send_gso() request sends its datagrams one after the other. */
+  if (uv__udp_req_segment_size(req) != 0) {
+    if (err == 0 && uv__udp_req_offset(req) < uv__udp_req_gso(req)->size) {
+      if (handle->flags & UV_HANDLE_CLOSING)
+        err = ERROR_OPERATION_ABORTED;
+      else
+        err = uv__udp_send_segment(req);
+
+      if (err == 0)
+        return;
+    }
+
+    uv__free(uv__udp_req_gso(req));
+  }
+
   assert(handle->send_queue_size >= req->u.io.queued_bytes);
   assert(handle->send_queue_count >= 1);
   handle->send_queue_size -= req->u.io.queued_bytes;
@@ -536,10 +644,6 @@ void uv__process_udp_send_req(uv_loop_t* loop, uv_udp_t* handle,
   UNREGISTER_HANDLE_REQ(loop, handle);
 
   if (req->cb) {
-    err = 0;
-    if (!REQ_SUCCESS(req)) {
-      err = GET_REQ_SOCK_ERROR(req);
-    }
     req->cb(req, uv_translate_sys_error(err));
   }
 
@@ -1060,6 +1164,28 @@ int uv__udp_disconnect(uv_udp_t* handle) {
 /* This function is an egress point, i.e. it returns libuv errors rather than
  * system errors.
  */
+static int uv__udp_send_bind(uv_udp_t* handle, unsigned int addrlen) {
+  const struct sockaddr* bind_addr;
+  int err;
+
+  if (handle->flags & UV_HANDLE_BOUND)
+    return 0;
+
+  if (addrlen == sizeof(uv_addr_ip4_any_))
+    bind_addr = (const struct sockaddr*) &uv_addr_ip4_any_;
+  else if (addrlen == sizeof(uv_addr_ip6_any_))
+    bind_addr = (const struct sockaddr*) &uv_addr_ip6_any_;
+  else
+    return UV_EINVAL;
+
+  err = uv__udp_maybe_bind(handle, bind_addr, addrlen, 0);
+  if (err)
+    return uv_translate_sys_error(err);
+
+  return 0;
+}
+
+
 int uv__udp_send(uv_udp_send_t* req,
                  uv_udp_t* handle,
                  const uv_buf_t bufs[],
@@ -1067,21 +1193,11 @@ int uv__udp_send(uv_udp_send_t* req,
                  const struct sockaddr* addr,
                  unsigned int addrlen,
                  uv_udp_send_cb send_cb) {
-  const struct sockaddr* bind_addr;
   int err;
 
-  if (!(handle->flags & UV_HANDLE_BOUND)) {
-    if (addrlen == sizeof(uv_addr_ip4_any_))
-      bind_addr = (const struct sockaddr*) &uv_addr_ip4_any_;
-    else if (addrlen == sizeof(uv_addr_ip6_any_))
-      bind_addr = (const struct sockaddr*) &uv_addr_ip6_any_;
-    else
-      return UV_EINVAL;
-
-    err = uv__udp_maybe_bind(handle, bind_addr, addrlen, 0);
-    if (err)
-      return uv_translate_sys_error(err);
-  }
+  err = uv__udp_send_bind(handle, addrlen);
+  if (err)
+    return err;
 
   err = uv__send(req, handle, bufs, nbufs, addr, addrlen, send_cb);
   if (err)
@@ -1091,6 +1207,66 @@ int uv__udp_send(uv_udp_send_t* req,
 }
 
 
+/* Windows has no segmentation offload for sends, libuv always splits the
+ * payload itself. The datagrams go out one at a time, the completion of one
+ * sends the next, see uv__process_udp_send_req().
+ */
+int uv__udp_send_gso(uv_udp_send_t* req,
+                     uv_udp_t* handle,
+                     const uv_buf_t bufs[],
+                     unsigned int nbufs,
+                     const struct sockaddr* addr,
+                     unsigned int addrlen,
+                     size_t segment_size,
+                     uv_udp_send_cb send_cb) {
+  uv_loop_t* loop = handle->loop;
+  struct uv__udp_gso* gso;
+  int err;
+
+  err = uv__udp_send_bind(handle, addrlen);
+  if (err)
+    return err;
+
+  gso = uv__malloc(sizeof(*gso) + 2 * nbufs * sizeof(bufs[0]));
+  if (gso == NULL)
+    return UV_ENOMEM;
+
+  assert(addrlen <= sizeof(gso->addr));
+  gso->addrlen = 0;
+  if (addr != NULL) {
+    memcpy(&gso->addr, addr, addrlen);
+    gso->addrlen = addrlen;
+  }
+
+  gso->bufs = (uv_buf_t*) (gso + 1);
+  gso->slice = gso->bufs + nbufs;
+  gso->nbufs = nbufs;
+  gso->size = uv__count_bufs(bufs, nbufs);
+  memcpy(gso->bufs, bufs, nbufs * sizeof(bufs[0]));
+
+  UV_REQ_INIT(req, UV_UDP_SEND);
+  req->handle = handle;
+  req->cb = send_cb;
+  req->reserved[0] = (void*) (uintptr_t) segment_size;
+  req->reserved[1] = (void*) (uintptr_t) 0;
+  req->reserved[2] = gso;
+
+  err = uv__udp_send_segment(req);
+  if (err) {
+    uv__free(gso);
+    return uv_translate_sys_error(err);
+  }
+
+  req->u.io.queued_bytes = gso->size;
+  handle->reqs_pending++;
+  handle->send_queue_size += req->u.io.queued_bytes;
+  handle->send_queue_count++;
+  REGISTER_HANDLE_REQ(loop, handle);
+
+  return 0;
+}
+
+
 int uv__udp_try_send(uv_udp_t* handle,
                      const uv_buf_t bufs[],
                      unsigned int nbufs,
@@ -33,6 +33,7 @@ BENCHMARK_DECLARE (tcp4_pound_1000)
 BENCHMARK_DECLARE (pipe_pound_100)
 BENCHMARK_DECLARE (pipe_pound_1000)
 BENCHMARK_DECLARE (tcp_pump100_client)
+BENCHMARK_DECLARE (tcp_pump100_client_io_uring)
 BENCHMARK_DECLARE (tcp_pump1_client)
 BENCHMARK_DECLARE (pipe_pump100_client)
 BENCHMARK_DECLARE (pipe_pump1_client)
@@ -40,6 +41,7 @@ BENCHMARK_DECLARE (pipe_pump1_client)
 BENCHMARK_DECLARE (tcp_multi_accept2)
 BENCHMARK_DECLARE (tcp_multi_accept4)
 BENCHMARK_DECLARE (tcp_multi_accept8)
+BENCHMARK_DECLARE (tcp_multi_accept4_io_uring)
 
 /* Run until X packets have been sent/received. */
 BENCHMARK_DECLARE (udp_pummel_1v1)
@@ -64,6 +66,10 @@ BENCHMARK_DECLARE (udp_timed_pummel_10v1000)
 BENCHMARK_DECLARE (udp_timed_pummel_100v100)
 BENCHMARK_DECLARE (udp_timed_pummel_100v1000)
 BENCHMARK_DECLARE (udp_timed_pummel_1000v1000)
+BENCHMARK_DECLARE (udp_timed_pummel_gso_1v1)
+BENCHMARK_DECLARE (udp_timed_pummel_gso_10v10)
+BENCHMARK_DECLARE (udp_timed_pummel_gso_gro_1v1)
+BENCHMARK_DECLARE (udp_timed_pummel_gso_gro_10v10)
 
 BENCHMARK_DECLARE (getaddrinfo)
 BENCHMARK_DECLARE (fs_stat)
@@ -76,12 +82,24 @@ BENCHMARK_DECLARE (async_pummel_2)
 BENCHMARK_DECLARE (async_pummel_4)
 BENCHMARK_DECLARE (async_pummel_8)
 BENCHMARK_DECLARE (queue_work)
+BENCHMARK_DECLARE (queue_work_fanout)
+BENCHMARK_DECLARE (queue_work_batch)
+BENCHMARK_DECLARE (queue_work_latency)
+BENCHMARK_DECLARE (queue_work_latency_spin)
 BENCHMARK_DECLARE (spawn)
 BENCHMARK_DECLARE (thread_create)
 BENCHMARK_DECLARE (million_async)
 BENCHMARK_DECLARE (million_timers)
+BENCHMARK_DECLARE (million_timers_wheel)
+BENCHMARK_DECLARE (million_timer_restarts)
+BENCHMARK_DECLARE (million_timer_restarts_wheel)
+BENCHMARK_DECLARE (timer_heap_10k)
+BENCHMARK_DECLARE (timer_heap_100k)
+BENCHMARK_DECLARE (timer_heap_1m)
+BENCHMARK_DECLARE (timer_heap_10m)
 HELPER_DECLARE    (tcp4_blackhole_server)
 HELPER_DECLARE    (tcp_pump_server)
+HELPER_DECLARE    (tcp_pump_server_io_uring)
 HELPER_DECLARE    (pipe_pump_server)
 HELPER_DECLARE    (tcp4_echo_server)
 HELPER_DECLARE    (pipe_echo_server)
@@ -105,6 +123,9 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (tcp_pump100_client)
   BENCHMARK_HELPER (tcp_pump100_client, tcp_pump_server)
 
+  BENCHMARK_ENTRY  (tcp_pump100_client_io_uring)
+  BENCHMARK_HELPER (tcp_pump100_client_io_uring, tcp_pump_server_io_uring)
+
   BENCHMARK_ENTRY  (tcp_pump1_client)
   BENCHMARK_HELPER (tcp_pump1_client, tcp_pump_server)
 
@@ -129,6 +150,7 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (tcp_multi_accept2)
   BENCHMARK_ENTRY  (tcp_multi_accept4)
   BENCHMARK_ENTRY  (tcp_multi_accept8)
+  BENCHMARK_ENTRY  (tcp_multi_accept4_io_uring)
 
   BENCHMARK_ENTRY  (udp_pummel_1v1)
   BENCHMARK_ENTRY  (udp_pummel_1v10)
@@ -151,6 +173,10 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (udp_timed_pummel_100v100)
   BENCHMARK_ENTRY  (udp_timed_pummel_100v1000)
   BENCHMARK_ENTRY  (udp_timed_pummel_1000v1000)
+  BENCHMARK_ENTRY  (udp_timed_pummel_gso_1v1)
+  BENCHMARK_ENTRY  (udp_timed_pummel_gso_10v10)
+  BENCHMARK_ENTRY  (udp_timed_pummel_gso_gro_1v1)
+  BENCHMARK_ENTRY  (udp_timed_pummel_gso_gro_10v10)
 
   BENCHMARK_ENTRY  (getaddrinfo)
 
@@ -165,9 +191,20 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (async_pummel_4)
   BENCHMARK_ENTRY  (async_pummel_8)
   BENCHMARK_ENTRY  (queue_work)
+  BENCHMARK_ENTRY  (queue_work_fanout)
+  BENCHMARK_ENTRY  (queue_work_batch)
+  BENCHMARK_ENTRY  (queue_work_latency)
+  BENCHMARK_ENTRY  (queue_work_latency_spin)
 
   BENCHMARK_ENTRY  (spawn)
   BENCHMARK_ENTRY  (thread_create)
   BENCHMARK_ENTRY  (million_async)
   BENCHMARK_ENTRY  (million_timers)
+  BENCHMARK_ENTRY  (million_timers_wheel)
+  BENCHMARK_ENTRY  (million_timer_restarts)
+  BENCHMARK_ENTRY  (million_timer_restarts_wheel)
+  BENCHMARK_ENTRY  (timer_heap_10k)
+  BENCHMARK_ENTRY  (timer_heap_100k)
+  BENCHMARK_ENTRY  (timer_heap_1m)
+  BENCHMARK_ENTRY  (timer_heap_10m)
 TASK_LIST_END
@@ -24,6 +24,11 @@
 
 #define NUM_TIMERS (10 * 1000 * 1000)
 
+/* Idle timeouts of connections that see traffic, restarted on every read. */
+#define NUM_IDLE_TIMERS (2 * 1000 * 1000)
+#define NUM_RESTARTS (10 * 1000 * 1000)
+#define IDLE_TIMEOUT 30000
+
 static int timer_cb_called;
 static int close_cb_called;
 
@@ -38,7 +43,7 @@ static void close_cb(uv_handle_t* handle) {
 }
 
 
-BENCHMARK_IMPL(million_timers) {
+static int million_timers(int use_wheel) {
   uv_timer_t* timers;
   uv_loop_t* loop;
   uint64_t before_all;
@@ -54,6 +59,9 @@ BENCHMARK_IMPL(million_timers) {
   loop = uv_default_loop();
   timeout = 0;
 
+  if (use_wheel)
+    ASSERT_OK(uv_loop_configure(loop, UV_LOOP_USE_TIMER_WHEEL));
+
   before_all = uv_hrtime();
   for (i = 0; i < NUM_TIMERS; i++) {
     if (i % 1000 == 0) timeout++;
@@ -84,3 +92,175 @@ BENCHMARK_IMPL(million_timers) {
   MAKE_VALGRIND_HAPPY(loop);
   return 0;
 }
+
+
+static int million_timer_restarts(int use_wheel) {
+  uv_timer_t* timers;
+  uv_loop_t* loop;
+  uint64_t before_all;
+  uint64_t before_run;
+  uint64_t after_run;
+  uint64_t after_all;
+  unsigned int seed;
+  int i;
+
+  timers = malloc(NUM_IDLE_TIMERS * sizeof(timers[0]));
+  ASSERT_NOT_NULL(timers);
+
+  loop = uv_default_loop();
+  if (use_wheel)
+    ASSERT_OK(uv_loop_configure(loop, UV_LOOP_USE_TIMER_WHEEL));
+
+  before_all = uv_hrtime();
+  for (i = 0; i < NUM_IDLE_TIMERS; i++) {
+    ASSERT_OK(uv_timer_init(loop, timers + i));
+    ASSERT_OK(uv_timer_start(timers + i, timer_cb, IDLE_TIMEOUT, 0));
+  }
+
+  /* Reads arrive on random connections, every one pushes the idle timeout of
+   * its connection out again. Let the loop spin now and then.
+   */
+  seed = 1;
+  before_run = uv_hrtime();
+  for (i = 0; i < NUM_RESTARTS; i++) {
+    seed = seed * 1103515245 + 12345;
+    ASSERT_OK(uv_timer_start(timers + (seed >> 8) % NUM_IDLE_TIMERS,
+                             timer_cb,
+                             IDLE_TIMEOUT,
+                             0));
+    if (i % 10000 == 0)
+      ASSERT_NE(0, uv_run(loop, UV_RUN_NOWAIT));
+  }
+  after_run = uv_hrtime();
+
+  for (i = 0; i < NUM_IDLE_TIMERS; i++)
+    uv_close((uv_handle_t*) (timers + i), close_cb);
+
+  ASSERT_OK(uv_run(loop, UV_RUN_DEFAULT));
+  after_all = uv_hrtime();
+
+  ASSERT_OK(timer_cb_called);
+  ASSERT_EQ(close_cb_called, NUM_IDLE_TIMERS);
+  free(timers);
+
+  fprintf(stderr, "%.2f seconds total\n", (after_all - before_all) / 1e9);
+  fprintf(stderr, "%.2f seconds init\n", (before_run - before_all) / 1e9);
+  fprintf(stderr, "%.2f seconds restarts (%.0f/s)\n",
+          (after_run - before_run) / 1e9,
+          NUM_RESTARTS / ((after_run - before_run) / 1e9));
+  fprintf(stderr, "%.2f seconds cleanup\n", (after_all - after_run) / 1e9);
+  fflush(stderr);
+
+  MAKE_VALGRIND_HAPPY(loop);
+  return 0;
+}
+
+
+/* Timer heap operations at scale: start |n| timers with random timeouts, stop
+ * half of them, start those again and dispatch them all in one go.
+ */
+static int timer_heap_ops(int n) {
+  uv_timer_t* timers;
+  uv_loop_t* loop;
+  uint64_t t[6];
+  unsigned int seed;
+  int i;
+
+  timers = malloc(n * sizeof(timers[0]));
+  ASSERT_NOT_NULL(timers);
+
+  loop = uv_default_loop();
+  timer_cb_called = 0;
+  close_cb_called = 0;
+  seed = 1;
+
+  t[0] = uv_hrtime();
+  for (i = 0; i < n; i++) {
+    seed = seed * 1103515245 + 12345;
+    ASSERT_OK(uv_timer_init(loop, timers + i));
+    ASSERT_OK(uv_timer_start(timers + i, timer_cb, 1 + (seed >> 8) % 100, 0));
+  }
+
+  /* 7919 is prime, so this visits the timers in a scattered order. */
+  t[1] = uv_hrtime();
+  for (i = 0; i < n / 2; i++)
+    ASSERT_OK(uv_timer_stop(timers + (i * 7919ULL) % n));
+
+  t[2] = uv_hrtime();
+  for (i = 0; i < n / 2; i++) {
+    seed = seed * 1103515245 + 12345;
+    ASSERT_OK(uv_timer_start(timers + (i * 7919ULL) % n,
+                             timer_cb,
+                             1 + (seed >> 8) % 100,
+                             0));
+  }
+
+  /* Let all of them expire before the loop looks at them. */
+  t[3] = uv_hrtime();
+  uv_sleep(101);
+  uv_update_time(loop);
+  t[4] = uv_hrtime();
+  ASSERT_OK(uv_run(loop, UV_RUN_DEFAULT));
+  t[5] = uv_hrtime();
+
+  for (i = 0; i < n; i++)
+    uv_close((uv_handle_t*) (timers + i), close_cb);
+
+  ASSERT_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(timer_cb_called, n);
+  ASSERT_EQ(close_cb_called, n);
+  free(timers);
+
+  fprintf(stderr, "%d timers: insert %.1f, remove %.1f, reinsert %.1f, "
+                  "dispatch %.1f ns/op\n",
+          n,
+          (double) (t[1] - t[0]) / n,
+          (double) (t[2] - t[1]) / (n / 2),
+          (double) (t[3] - t[2]) / (n / 2),
+          (double) (t[5] - t[4]) / n);
+  fflush(stderr);
+
+  MAKE_VALGRIND_HAPPY(loop);
+  return 0;
+}
+
+
+BENCHMARK_IMPL(million_timers) {
+  return million_timers(0);
+}
+
+
+BENCHMARK_IMPL(million_timers_wheel) {
+  return million_timers(1);
+}
+
+
+BENCHMARK_IMPL(million_timer_restarts) {
+  return million_timer_restarts(0);
+}
+
+
+BENCHMARK_IMPL(million_timer_restarts_wheel) {
+  return million_timer_restarts(1);
+}
+
+
+BENCHMARK_IMPL(timer_heap_10k) {
+  return timer_heap_ops(10 * 1000);
+}
+
+
+BENCHMARK_IMPL(timer_heap_100k) {
+  return timer_heap_ops(100 * 1000);
+}
+
+
+BENCHMARK_IMPL(timer_heap_1m) {
+  return timer_heap_ops(1000 * 1000);
+}
+
+
+BENCHMARK_IMPL(timer_heap_10m) {
+  return timer_heap_ops(10 * 1000 * 1000);
+}
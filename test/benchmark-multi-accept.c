@@ -102,6 +102,7 @@ static void cl_idle_cb(uv_idle_t* handle);
 static void cl_close_cb(uv_handle_t* handle);
 
 static struct sockaddr_in listen_addr;
+static int use_io_uring;
 
 
 static void ipc_connection_cb(uv_stream_t* ipc_pipe, int status) {
@@ -261,6 +262,9 @@ static void server_cb(void *arg) {
   ctx = arg;
   ASSERT_OK(uv_loop_init(&loop));
 
+  if (use_io_uring)
+    ASSERT_OK(uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_STREAMS));
+
   ASSERT_OK(uv_async_init(&loop, &ctx->async_handle, sv_async_cb));
   uv_unref((uv_handle_t*) &ctx->async_handle);
 
@@ -414,8 +418,9 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
     uv_sem_destroy(&ctx->semaphore);
   }
 
-  printf("accept%u: %.0f accepts/sec (%u total)\n",
+  printf("accept%u%s: %.0f accepts/sec (%u total)\n",
          num_servers,
+         use_io_uring ? "_io_uring" : "",
          NUM_CONNECTS / time,
          NUM_CONNECTS);
 
@@ -449,3 +454,19 @@ BENCHMARK_IMPL(tcp_multi_accept4) {
 BENCHMARK_IMPL(tcp_multi_accept8) {
   return test_tcp(8, 40);
 }
+
+
+BENCHMARK_IMPL(tcp_multi_accept4_io_uring) {
+  uv_loop_t loop;
+  int r;
+
+  ASSERT_OK(uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_STREAMS);
+  ASSERT_OK(uv_loop_close(&loop));
+  if (r == UV_ENOSYS)
+    RETURN_SKIP("io_uring not supported");
+  ASSERT_OK(r);
+
+  use_io_uring = 1;
+  return test_tcp(4, 40);
+}
@@ -73,6 +73,9 @@ static char write_buffer[WRITE_BUFFER_SIZE];
 
 static stream_type type;
 
+/* Read and write through io_uring, see UV_LOOP_USE_IO_URING_STREAMS. */
+static int use_io_uring;
+
 static uv_tcp_t tcp_write_handles[MAX_WRITE_HANDLES];
 static uv_pipe_t pipe_write_handles[MAX_WRITE_HANDLES];
 
@@ -102,9 +105,10 @@ static void show_stats(uv_timer_t* handle) {
     uv_update_time(loop);
     diff = uv_now(loop) - start_time;
 
-    fprintf(stderr, "%s_pump%d_client: %.1f gbit/s\n",
+    fprintf(stderr, "%s_pump%d_client%s: %.1f gbit/s\n",
             type == TCP ? "tcp" : "pipe",
             write_sockets,
+            use_io_uring ? "_io_uring" : "",
             gbit(nsent_total, diff));
     fflush(stderr);
 
@@ -130,9 +134,10 @@ static void read_show_stats(void) {
   uv_update_time(loop);
   diff = uv_now(loop) - start_time;
 
-  fprintf(stderr, "%s_pump%d_server: %.1f gbit/s\n",
+  fprintf(stderr, "%s_pump%d_server%s: %.1f gbit/s\n",
           type == TCP ? "tcp" : "pipe",
           max_read_sockets,
+          use_io_uring ? "_io_uring" : "",
           gbit(nrecv_total, diff));
   fflush(stderr);
 }
@@ -373,12 +378,16 @@ static void buf_free(const uv_buf_t* buf) {
 }
 
 
-HELPER_IMPL(tcp_pump_server) {
+static void tcp_pump_server(void) {
   int r;
 
   type = TCP;
   loop = uv_default_loop();
 
+  /* Stays on read() and write() where not supported, the client skips. */
+  if (use_io_uring)
+    uv_loop_configure(loop, UV_LOOP_USE_IO_URING_STREAMS);
+
   ASSERT_OK(uv_ip4_addr("0.0.0.0", TEST_PORT, &listen_addr));
 
   /* Server */
@@ -392,7 +401,18 @@ HELPER_IMPL(tcp_pump_server) {
 
   notify_parent_process();
   uv_run(loop, UV_RUN_DEFAULT);
+}
+
+
+HELPER_IMPL(tcp_pump_server) {
+  tcp_pump_server();
+  return 0;
+}
+
 
+HELPER_IMPL(tcp_pump_server_io_uring) {
+  use_io_uring = 1;
+  tcp_pump_server();
   return 0;
 }
 
@@ -460,6 +480,16 @@ BENCHMARK_IMPL(tcp_pump100_client) {
 }
 
 
+BENCHMARK_IMPL(tcp_pump100_client_io_uring) {
+  if (uv_loop_configure(uv_default_loop(), UV_LOOP_USE_IO_URING_STREAMS))
+    RETURN_SKIP("io_uring streams not supported");
+
+  use_io_uring = 1;
+  tcp_pump(100);
+  return 0;
+}
+
+
 BENCHMARK_IMPL(tcp_pump1_client) {
   tcp_pump(1);
   return 0;
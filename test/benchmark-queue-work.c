@@ -45,6 +45,8 @@ static void after_work_cb(uv_work_t* req, int status) {
 
 static void timer_cb(uv_timer_t* handle) { done = 1; }
 
+static void fanout_after_work_cb(uv_work_t* req, int status);
+
 BENCHMARK_IMPL(queue_work) {
   char fmtbuf[2][32];
   uv_timer_t timer_handle;
@@ -69,3 +71,167 @@ BENCHMARK_IMPL(queue_work) {
   MAKE_VALGRIND_HAPPY(loop);
   return 0;
 }
+
+
+#define FANOUT 10000
+
+static uv_work_t fanout_reqs[FANOUT];
+static unsigned fanout_pending;
+static int fanout_batch;
+
+
+static void fanout_submit(uv_loop_t* loop) {
+  unsigned i;
+
+  fanout_pending = FANOUT;
+  if (fanout_batch) {
+    ASSERT_OK(uv_queue_work_batch(loop,
+                                  fanout_reqs,
+                                  FANOUT,
+                                  work_cb,
+                                  fanout_after_work_cb));
+    return;
+  }
+
+  for (i = 0; i < FANOUT; i++)
+    ASSERT_OK(uv_queue_work(loop,
+                            fanout_reqs + i,
+                            work_cb,
+                            fanout_after_work_cb));
+}
+
+
+static void fanout_after_work_cb(uv_work_t* req, int status) {
+  ASSERT_OK(status);
+  events++;
+  if (--fanout_pending == 0 && !done)
+    fanout_submit(req->loop);
+}
+
+
+static int fanout(int batch) {
+  char fmtbuf[2][32];
+  uv_timer_t timer_handle;
+  uv_loop_t* loop;
+  int timeout;
+
+  loop = uv_default_loop();
+  timeout = 5000;
+  fanout_batch = batch;
+
+  ASSERT_OK(uv_timer_init(loop, &timer_handle));
+  ASSERT_OK(uv_timer_start(&timer_handle, timer_cb, timeout, 0));
+
+  fanout_submit(loop);
+  ASSERT_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  printf("%s %s jobs in %.1f seconds (%s/s)\n",
+         fmt(&fmtbuf[0], events),
+         batch ? "batched" : "fan-out",
+         timeout / 1000.,
+         fmt(&fmtbuf[1], events / (timeout / 1000.)));
+
+  MAKE_VALGRIND_HAPPY(loop);
+  return 0;
+}
+
+
+BENCHMARK_IMPL(queue_work_fanout) {
+  return fanout(0);
+}
+
+
+BENCHMARK_IMPL(queue_work_batch) {
+  return fanout(1);
+}
+
+
+#define LATENCY_SAMPLES 100000
+
+static uint64_t latency_samples[LATENCY_SAMPLES];
+static unsigned latency_count;
+static uint64_t latency_start;
+
+
+static void latency_work_cb(uv_work_t* req) {
+  latency_samples[latency_count] = uv_hrtime() - latency_start;
+}
+
+
+static void latency_after_work_cb(uv_work_t* req, int status) {
+  ASSERT_OK(status);
+  if (++latency_count == LATENCY_SAMPLES)
+    return;
+
+  latency_start = uv_hrtime();
+  ASSERT_OK(uv_queue_work(req->loop,
+                          req,
+                          latency_work_cb,
+                          latency_after_work_cb));
+}
+
+
+static int latency_compare(const void* a, const void* b) {
+  uint64_t x;
+  uint64_t y;
+
+  x = *(const uint64_t*) a;
+  y = *(const uint64_t*) b;
+  return (x > y) - (x < y);
+}
+
+
+/* Time from uv_queue_work() until the work starts running on a thread, one
+ * request at a time.
+ */
+static int latency(uint64_t spin_time) {
+  uv_threadpool_options_t options;
+  uv_threadpool_t pool;
+  uv_work_t work;
+  uv_loop_t loop;
+
+  memset(&options, 0, sizeof(options));
+  options.min_threads = 4;
+  options.max_threads = 4;
+  options.spin_time = spin_time;
+  ASSERT_OK(uv_threadpool_init_ex(&pool, &options));
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_WORK,
+                              &pool));
+
+  latency_start = uv_hrtime();
+  ASSERT_OK(uv_queue_work(&loop,
+                          &work,
+                          latency_work_cb,
+                          latency_after_work_cb));
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(LATENCY_SAMPLES, latency_count);
+
+  qsort(latency_samples,
+        LATENCY_SAMPLES,
+        sizeof(latency_samples[0]),
+        latency_compare);
+
+  printf("queue_work latency (spin %u us): p50 %.1f us, p99 %.1f us\n",
+         (unsigned) spin_time,
+         latency_samples[LATENCY_SAMPLES / 2] / 1e3,
+         latency_samples[LATENCY_SAMPLES * 99 / 100] / 1e3);
+
+  ASSERT_OK(uv_loop_close(&loop));
+  ASSERT_OK(uv_threadpool_close(&pool));
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+BENCHMARK_IMPL(queue_work_latency) {
+  return latency(0);
+}
+
+
+BENCHMARK_IMPL(queue_work_latency_spin) {
+  return latency(50);
+}
@@ -32,6 +32,9 @@
 
 #define BASE_PORT 12345
 
+/* Datagrams per uv_udp_send_gso() call. */
+#define GSO_SEGMENTS 64
+
 struct sender_state {
   struct sockaddr_in addr;
   uv_udp_send_t send_req;
@@ -49,6 +52,7 @@ static unsigned int packet_counter = (unsigned int) 1e6;
 static int n_senders_;
 static int n_receivers_;
 static uv_buf_t bufs[5];
+static uv_buf_t gso_bufs[GSO_SEGMENTS];
 static struct sender_state senders[1024];
 static struct receiver_state receivers[1024];
 
@@ -57,6 +61,7 @@ static unsigned int recv_cb_called;
 static unsigned int close_cb_called;
 static int timed;
 static int exiting;
+static unsigned int udp_flags;
 
 
 static void alloc_cb(uv_handle_t* handle,
@@ -69,6 +74,27 @@ static void alloc_cb(uv_handle_t* handle,
 }
 
 
+static int pummel_send(struct sender_state* s, uv_udp_send_cb cb) {
+  if (udp_flags & UV_UDP_GSO) {
+    send_cb_called += GSO_SEGMENTS - 1;
+    return uv_udp_send_gso(&s->send_req,
+                           &s->udp_handle,
+                           gso_bufs,
+                           ARRAY_SIZE(gso_bufs),
+                           (const struct sockaddr*) &s->addr,
+                           sizeof(EXPECTED) - 1,
+                           cb);
+  }
+
+  return uv_udp_send(&s->send_req,
+                     &s->udp_handle,
+                     bufs,
+                     ARRAY_SIZE(bufs),
+                     (const struct sockaddr*) &s->addr,
+                     cb);
+}
+
+
 static void send_cb(uv_udp_send_t* req, int status) {
   struct sender_state* s;
 
@@ -96,12 +122,7 @@ static void send_cb(uv_udp_send_t* req, int status) {
   packet_counter--;
 
 send:
-  ASSERT_OK(uv_udp_send(&s->send_req,
-                        &s->udp_handle,
-                        bufs,
-                        ARRAY_SIZE(bufs),
-                        (const struct sockaddr*) &s->addr,
-                        send_cb));
+  ASSERT_OK(pummel_send(s, send_cb));
   send_cb_called++;
 }
 
@@ -147,7 +168,8 @@ static void timeout_cb(uv_timer_t* timer) {
 
 static int pummel(unsigned int n_senders,
                   unsigned int n_receivers,
-                  unsigned long timeout) {
+                  unsigned long timeout,
+                  unsigned int flags) {
   uv_timer_t timer_handle;
   uint64_t duration;
   uv_loop_t* loop;
@@ -160,6 +182,7 @@ static int pummel(unsigned int n_senders,
 
   n_senders_ = n_senders;
   n_receivers_ = n_receivers;
+  udp_flags = flags;
 
   if (timeout) {
     ASSERT_OK(uv_timer_init(loop, &timer_handle));
@@ -173,7 +196,9 @@ static int pummel(unsigned int n_senders,
     struct receiver_state* s = receivers + i;
     struct sockaddr_in addr;
     ASSERT_OK(uv_ip4_addr("0.0.0.0", BASE_PORT + i, &addr));
-    ASSERT_OK(uv_udp_init(loop, &s->udp_handle));
+    ASSERT_OK(uv_udp_init_ex(loop,
+                             &s->udp_handle,
+                             AF_INET | (flags & ~UV_UDP_GSO)));
     ASSERT_OK(uv_udp_bind(&s->udp_handle, (const struct sockaddr*) &addr, 0));
     ASSERT_OK(uv_udp_recv_start(&s->udp_handle, alloc_cb, recv_cb));
     uv_unref((uv_handle_t*)&s->udp_handle);
@@ -185,18 +210,18 @@ static int pummel(unsigned int n_senders,
   bufs[3] = uv_buf_init(&EXPECTED[30], 10);
   bufs[4] = uv_buf_init(&EXPECTED[40], 5);
 
+  for (i = 0; i < ARRAY_SIZE(gso_bufs); i++)
+    gso_bufs[i] = uv_buf_init(EXPECTED, sizeof(EXPECTED) - 1);
+
   for (i = 0; i < n_senders; i++) {
     struct sender_state* s = senders + i;
     ASSERT_OK(uv_ip4_addr("127.0.0.1",
                           BASE_PORT + (i % n_receivers),
                           &s->addr));
-    ASSERT_OK(uv_udp_init(loop, &s->udp_handle));
-    ASSERT_OK(uv_udp_send(&s->send_req,
-                          &s->udp_handle,
-                          bufs,
-                          ARRAY_SIZE(bufs),
-                          (const struct sockaddr*) &s->addr,
-                          send_cb));
+    ASSERT_OK(uv_udp_init_ex(loop,
+                             &s->udp_handle,
+                             AF_INET | (flags & UV_UDP_GSO)));
+    ASSERT_OK(pummel_send(s, send_cb));
   }
 
   duration = uv_hrtime();
@@ -205,8 +230,10 @@ static int pummel(unsigned int n_senders,
   /* convert from nanoseconds to milliseconds */
   duration = duration / (uint64_t) 1e6;
 
-  printf("udp_pummel_%dv%d: %.0f/s received, %.0f/s sent. "
+  printf("udp_pummel_%s%s%dv%d: %.0f/s received, %.0f/s sent. "
          "%u received, %u sent in %.1f seconds.\n",
+         flags & UV_UDP_GSO ? "gso_" : "",
+         flags & UV_UDP_GRO ? "gro_" : "",
          n_receivers,
          n_senders,
          recv_cb_called / (duration / 1000.0),
@@ -222,10 +249,10 @@ static int pummel(unsigned int n_senders,
 
 #define X(a, b)                                                               \
   BENCHMARK_IMPL(udp_pummel_##a##v##b) {                                      \
-    return pummel(a, b, 0);                                                   \
+    return pummel(a, b, 0, 0);                                                \
   }                                                                           \
   BENCHMARK_IMPL(udp_timed_pummel_##a##v##b) {                                \
-    return pummel(a, b, TEST_DURATION);                                       \
+    return pummel(a, b, TEST_DURATION, 0);                                    \
   }
 
 X(1, 1)
@@ -241,3 +268,16 @@ X(100, 1000)
 X(1000, 1000)
 
 #undef X
+
+#define X(a, b)                                                               \
+  BENCHMARK_IMPL(udp_timed_pummel_gso_##a##v##b) {                            \
+    return pummel(a, b, TEST_DURATION, UV_UDP_GSO);                           \
+  }                                                                           \
+  BENCHMARK_IMPL(udp_timed_pummel_gso_gro_##a##v##b) {                        \
+    return pummel(a, b, TEST_DURATION, UV_UDP_GSO | UV_UDP_GRO);              \
+  }
+
+X(1, 1)
+X(10, 10)
+
+#undef X
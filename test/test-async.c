@@ -132,3 +132,39 @@ TEST_IMPL(async) {
   MAKE_VALGRIND_HAPPY(uv_default_loop());
   return 0;
 }
+
+
+static int close_pending_cb_called;
+
+
+static void close_pending_cb(uv_async_t* handle) {
+  ASSERT_OK((handle - (uv_async_t*) handle->data) % 2);
+  close_pending_cb_called++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(async_close_pending) {
+  uv_async_t handles[8];
+  int i;
+
+  for (i = 0; i < (int) ARRAY_SIZE(handles); i++) {
+    ASSERT_OK(uv_async_init(uv_default_loop(), &handles[i], close_pending_cb));
+    handles[i].data = handles;
+  }
+
+  /* Closing a handle that has been signalled but not dispatched yet must
+   * drop it from the pending handles.
+   */
+  for (i = 0; i < (int) ARRAY_SIZE(handles); i++)
+    ASSERT_OK(uv_async_send(&handles[i]));
+
+  for (i = 1; i < (int) ARRAY_SIZE(handles); i += 2)
+    uv_close((uv_handle_t*) &handles[i], NULL);
+
+  ASSERT_OK(uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(4, close_pending_cb_called);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
@@ -0,0 +1,156 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_PRODUCERS 4
+#define NUM_MESSAGES 20000
+
+static uv_channel_t channel;
+static uv_thread_t producers[NUM_PRODUCERS];
+static uintptr_t next_seq[NUM_PRODUCERS];
+static int channel_cb_called;
+static int msgs_received;
+
+
+/* Messages are (producer << 24 | seq + 1), so none of them is NULL. */
+static void producer_cb(void* arg) {
+  uintptr_t producer;
+  uintptr_t seq;
+  int err;
+
+  producer = (uintptr_t) arg;
+  for (seq = 0; seq < NUM_MESSAGES; seq++) {
+    do {
+      err = uv_channel_send(&channel, (void*) (producer << 24 | (seq + 1)));
+      if (err == UV_EAGAIN)
+        uv_sleep(1);
+    } while (err == UV_EAGAIN);
+    ASSERT_OK(err);
+  }
+}
+
+
+static void channel_cb(uv_channel_t* handle, void** msgs, unsigned int nmsgs) {
+  uintptr_t producer;
+  uintptr_t seq;
+  unsigned int i;
+
+  ASSERT_PTR_EQ(handle, &channel);
+  ASSERT_GT(nmsgs, 0);
+  channel_cb_called++;
+
+  /* Messages of one producer arrive in order. */
+  for (i = 0; i < nmsgs; i++) {
+    producer = (uintptr_t) msgs[i] >> 24;
+    seq = ((uintptr_t) msgs[i] & 0xFFFFFF) - 1;
+    ASSERT_LT(producer, NUM_PRODUCERS);
+    ASSERT_EQ(next_seq[producer], seq);
+    next_seq[producer]++;
+  }
+
+  msgs_received += nmsgs;
+  if (msgs_received == NUM_PRODUCERS * NUM_MESSAGES)
+    uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(channel) {
+  uv_channel_t small;
+  uintptr_t i;
+
+  ASSERT_EQ(UV_EINVAL,
+            uv_channel_init(uv_default_loop(), &small, 0, channel_cb));
+
+  /* The capacity is rounded up to a power of two. */
+  ASSERT_OK(uv_channel_init(uv_default_loop(), &small, 3, channel_cb));
+  for (i = 0; i < 4; i++)
+    ASSERT_OK(uv_channel_send(&small, &small));
+  ASSERT_EQ(UV_EAGAIN, uv_channel_send(&small, &small));
+  uv_close((uv_handle_t*) &small, NULL);
+
+  ASSERT_OK(uv_channel_init(uv_default_loop(), &channel, 1024, channel_cb));
+  for (i = 0; i < NUM_PRODUCERS; i++)
+    ASSERT_OK(uv_thread_create(&producers[i], producer_cb, (void*) i));
+
+  ASSERT_OK(uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  for (i = 0; i < NUM_PRODUCERS; i++)
+    ASSERT_OK(uv_thread_join(&producers[i]));
+
+  ASSERT_EQ(NUM_PRODUCERS * NUM_MESSAGES, msgs_received);
+  ASSERT_GT(channel_cb_called, 0);
+  ASSERT_LE(channel_cb_called, msgs_received);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+static uv_channel_t race_channel;
+static uv_thread_t race_producer;
+static int race_close_cb_called;
+
+
+static void race_producer_cb(void* arg) {
+  int err;
+
+  /* Keep sending until uv_close() takes the channel away. */
+  do
+    err = uv_channel_send(&race_channel, &race_channel);
+  while (err == 0 || err == UV_EAGAIN);
+
+  ASSERT_EQ(err, UV_EBADF);
+}
+
+
+static void race_close_cb(uv_handle_t* handle) {
+  /* The producer must be done before the handle goes away. */
+  ASSERT_OK(uv_thread_join(&race_producer));
+  race_close_cb_called++;
+}
+
+
+static void race_channel_cb(uv_channel_t* handle,
+                            void** msgs,
+                            unsigned int nmsgs) {
+  if (!uv_is_closing((uv_handle_t*) handle))
+    uv_close((uv_handle_t*) handle, race_close_cb);
+}
+
+
+TEST_IMPL(channel_close_race) {
+  int i;
+
+  for (i = 0; i < 100; i++) {
+    ASSERT_OK(uv_channel_init(uv_default_loop(),
+                              &race_channel,
+                              16,
+                              race_channel_cb));
+    ASSERT_OK(uv_thread_create(&race_producer, race_producer_cb, NULL));
+    ASSERT_OK(uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+    ASSERT_EQ(i + 1, race_close_cb_called);
+  }
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
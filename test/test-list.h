@@ -33,6 +33,12 @@ TEST_DECLARE   (loop_stop_before_run)
 TEST_DECLARE   (loop_update_time)
 TEST_DECLARE   (loop_backend_timeout)
 TEST_DECLARE   (loop_configure)
+TEST_DECLARE   (loop_configure_io_uring_poll)
+TEST_DECLARE   (loop_configure_edge_triggered)
+TEST_DECLARE   (loop_configure_io_uring_streams)
+TEST_DECLARE   (loop_configure_io_uring_streams_shutdown)
+TEST_DECLARE   (loop_configure_io_uring_buffers)
+TEST_DECLARE   (loop_configure_io_uring_accept)
 TEST_DECLARE   (default_loop_close)
 TEST_DECLARE   (barrier_1)
 TEST_DECLARE   (barrier_2)
@@ -107,6 +113,7 @@ TEST_DECLARE   (tcp_writealot)
 TEST_DECLARE   (tcp_write_fail)
 TEST_DECLARE   (tcp_try_write)
 TEST_DECLARE   (tcp_write_in_a_row)
+TEST_DECLARE   (tcp_zerocopy)
 TEST_DECLARE   (tcp_try_write_error)
 TEST_DECLARE   (tcp_write_queue_order)
 TEST_DECLARE   (tcp_open)
@@ -174,6 +181,8 @@ TEST_DECLARE   (udp_send_hang_loop)
 TEST_DECLARE   (udp_send_immediate)
 TEST_DECLARE   (udp_send_unreachable)
 TEST_DECLARE   (udp_mmsg)
+TEST_DECLARE   (udp_send_gso)
+TEST_DECLARE   (udp_recv_gro)
 TEST_DECLARE   (udp_multicast_join)
 TEST_DECLARE   (udp_multicast_join6)
 TEST_DECLARE   (udp_multicast_ttl)
@@ -241,6 +250,9 @@ TEST_DECLARE   (timer_early_check)
 TEST_DECLARE   (timer_no_double_call_once)
 TEST_DECLARE   (timer_no_double_call_nowait)
 TEST_DECLARE   (timer_no_run_on_unref)
+TEST_DECLARE   (timer_wheel)
+TEST_DECLARE   (timer_slack)
+TEST_DECLARE   (timer_restart_order)
 TEST_DECLARE   (idle_starvation)
 TEST_DECLARE   (idle_check)
 TEST_DECLARE   (loop_handles)
@@ -281,6 +293,9 @@ TEST_DECLARE   (active)
 TEST_DECLARE   (embed)
 TEST_DECLARE   (async)
 TEST_DECLARE   (async_null_cb)
+TEST_DECLARE   (async_close_pending)
+TEST_DECLARE   (channel)
+TEST_DECLARE   (channel_close_race)
 TEST_DECLARE   (eintr_handling)
 TEST_DECLARE   (get_currentexe)
 TEST_DECLARE   (process_title)
@@ -458,6 +473,15 @@ TEST_DECLARE   (strscpy)
 TEST_DECLARE   (strtok)
 TEST_DECLARE   (threadpool_queue_work_simple)
 TEST_DECLARE   (threadpool_queue_work_einval)
+TEST_DECLARE   (threadpool_queue_work_batch)
+TEST_DECLARE   (threadpool_queue_work_detached)
+TEST_DECLARE   (threadpool_queue_work_detached_rebind)
+TEST_DECLARE   (threadpool_spin)
+TEST_DECLARE   (threadpool_placement)
+TEST_DECLARE   (threadpool_auto_size)
+TEST_DECLARE   (threadpool_custom)
+TEST_DECLARE   (threadpool_elastic)
+TEST_DECLARE   (threadpool_priority)
 TEST_DECLARE   (threadpool_multiple_event_loops)
 TEST_DECLARE   (threadpool_cancel_getaddrinfo)
 TEST_DECLARE   (threadpool_cancel_getnameinfo)
@@ -579,6 +603,7 @@ TEST_DECLARE  (uname)
 
 TEST_DECLARE  (metrics_info_check)
 TEST_DECLARE  (metrics_pool_events)
+TEST_DECLARE  (metrics_threadpool)
 TEST_DECLARE  (metrics_idle_time)
 TEST_DECLARE  (metrics_idle_time_thread)
 TEST_DECLARE  (metrics_idle_time_zero)
@@ -598,6 +623,12 @@ TASK_LIST_START
   TEST_ENTRY  (loop_update_time)
   TEST_ENTRY  (loop_backend_timeout)
   TEST_ENTRY  (loop_configure)
+  TEST_ENTRY  (loop_configure_io_uring_poll)
+  TEST_ENTRY  (loop_configure_edge_triggered)
+  TEST_ENTRY  (loop_configure_io_uring_streams)
+  TEST_ENTRY  (loop_configure_io_uring_streams_shutdown)
+  TEST_ENTRY  (loop_configure_io_uring_buffers)
+  TEST_ENTRY  (loop_configure_io_uring_accept)
   TEST_ENTRY  (default_loop_close)
   TEST_ENTRY  (barrier_1)
   TEST_ENTRY  (barrier_2)
@@ -708,6 +739,7 @@ TASK_LIST_START
 
   TEST_ENTRY  (tcp_try_write)
   TEST_ENTRY  (tcp_write_in_a_row)
+  TEST_ENTRY  (tcp_zerocopy)
   TEST_ENTRY  (tcp_try_write_error)
 
   TEST_ENTRY  (tcp_write_queue_order)
@@ -802,6 +834,8 @@ TASK_LIST_START
   TEST_ENTRY  (udp_options6)
   TEST_ENTRY  (udp_no_autobind)
   TEST_ENTRY  (udp_mmsg)
+  TEST_ENTRY  (udp_send_gso)
+  TEST_ENTRY  (udp_recv_gro)
   TEST_ENTRY  (udp_multicast_interface)
   TEST_ENTRY  (udp_multicast_interface6)
   TEST_ENTRY  (udp_multicast_join)
@@ -876,6 +910,9 @@ TASK_LIST_START
   TEST_ENTRY  (timer_no_double_call_once)
   TEST_ENTRY  (timer_no_double_call_nowait)
   TEST_ENTRY  (timer_no_run_on_unref)
+  TEST_ENTRY  (timer_wheel)
+  TEST_ENTRY  (timer_slack)
+  TEST_ENTRY  (timer_restart_order)
 
   TEST_ENTRY  (idle_starvation)
   TEST_ENTRY  (idle_check)
@@ -922,6 +959,9 @@ TASK_LIST_START
 
   TEST_ENTRY  (async)
   TEST_ENTRY  (async_null_cb)
+  TEST_ENTRY  (async_close_pending)
+  TEST_ENTRY  (channel)
+  TEST_ENTRY  (channel_close_race)
   TEST_ENTRY  (eintr_handling)
 
   TEST_ENTRY  (get_currentexe)
@@ -1171,6 +1211,15 @@ TASK_LIST_START
   TEST_ENTRY  (strtok)
   TEST_ENTRY  (threadpool_queue_work_simple)
   TEST_ENTRY  (threadpool_queue_work_einval)
+  TEST_ENTRY  (threadpool_queue_work_batch)
+  TEST_ENTRY  (threadpool_queue_work_detached)
+  TEST_ENTRY  (threadpool_queue_work_detached_rebind)
+  TEST_ENTRY  (threadpool_spin)
+  TEST_ENTRY  (threadpool_placement)
+  TEST_ENTRY  (threadpool_auto_size)
+  TEST_ENTRY  (threadpool_custom)
+  TEST_ENTRY  (threadpool_elastic)
+  TEST_ENTRY  (threadpool_priority)
   TEST_ENTRY_CUSTOM (threadpool_multiple_event_loops, 0, 0, 60000)
   TEST_ENTRY  (threadpool_cancel_getaddrinfo)
   TEST_ENTRY  (threadpool_cancel_getnameinfo)
@@ -1241,6 +1290,7 @@ TASK_LIST_START
 
   TEST_ENTRY  (metrics_info_check)
   TEST_ENTRY  (metrics_pool_events)
+  TEST_ENTRY  (metrics_threadpool)
   TEST_ENTRY  (metrics_idle_time)
   TEST_ENTRY  (metrics_idle_time_thread)
   TEST_ENTRY  (metrics_idle_time_zero)
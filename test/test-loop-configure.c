@@ -36,3 +36,617 @@ TEST_IMPL(loop_configure) {
   ASSERT_OK(uv_loop_close(&loop));
   return 0;
 }
+
+
+#ifndef _WIN32
+static uv_pipe_t iou_poll_pipes[2];
+static uv_fs_t iou_poll_fs_req;
+static int iou_poll_read_cb_called;
+static int iou_poll_fs_cb_called;
+
+
+static void iou_poll_alloc_cb(uv_handle_t* handle,
+                              size_t suggested_size,
+                              uv_buf_t* buf) {
+  static char slab[64];
+  *buf = uv_buf_init(slab, sizeof(slab));
+}
+
+
+static void iou_poll_read_cb(uv_stream_t* stream,
+                             ssize_t nread,
+                             const uv_buf_t* buf) {
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  ASSERT_MEM_EQ("PING", buf->base, 4);
+  iou_poll_read_cb_called++;
+  uv_close((uv_handle_t*) &iou_poll_pipes[0], NULL);
+  uv_close((uv_handle_t*) &iou_poll_pipes[1], NULL);
+}
+
+
+static void iou_poll_fs_cb(uv_fs_t* req) {
+  ASSERT_OK(req->result);
+  iou_poll_fs_cb_called++;
+  uv_fs_req_cleanup(req);
+}
+#endif
+
+
+TEST_IMPL(loop_configure_io_uring_poll) {
+#ifdef _WIN32
+  RETURN_SKIP("Not on Windows.");
+#else
+  uv_timer_t timer_handle;
+  uv_loop_t loop;
+  uv_file fds[2];
+  uv_buf_t buf;
+  int r;
+
+  ASSERT_OK(uv_loop_init(&loop));
+
+  /* Start a handle before switching over to make sure it's moved to the
+   * io_uring instance.
+   */
+  ASSERT_OK(uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT_OK(uv_pipe_init(&loop, &iou_poll_pipes[0], 0));
+  ASSERT_OK(uv_pipe_init(&loop, &iou_poll_pipes[1], 0));
+  ASSERT_OK(uv_pipe_open(&iou_poll_pipes[0], fds[0]));
+  ASSERT_OK(uv_pipe_open(&iou_poll_pipes[1], fds[1]));
+  ASSERT_OK(uv_read_start((uv_stream_t*) &iou_poll_pipes[0],
+                          iou_poll_alloc_cb,
+                          iou_poll_read_cb));
+  ASSERT_EQ(1, uv_run(&loop, UV_RUN_NOWAIT));
+
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_POLL);
+  if (r == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &iou_poll_pipes[0], NULL);
+    uv_close((uv_handle_t*) &iou_poll_pipes[1], NULL);
+    MAKE_VALGRIND_HAPPY(&loop);
+    RETURN_SKIP("io_uring polling not supported");
+  }
+  ASSERT_OK(r);
+
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(4, uv_try_write((uv_stream_t*) &iou_poll_pipes[1], &buf, 1));
+  ASSERT_OK(uv_fs_stat(&loop, &iou_poll_fs_req, ".", iou_poll_fs_cb));
+  ASSERT_OK(uv_timer_init(&loop, &timer_handle));
+  ASSERT_OK(uv_timer_start(&timer_handle, timer_cb, 10, 0));
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(1, iou_poll_read_cb_called);
+  ASSERT_EQ(1, iou_poll_fs_cb_called);
+
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+#endif
+}
+
+
+#ifndef _WIN32
+static uv_pipe_t et_pipes[2];
+static size_t et_nread;
+
+
+static void et_alloc_cb(uv_handle_t* handle,
+                        size_t suggested_size,
+                        uv_buf_t* buf) {
+  static char slab[1];
+  *buf = uv_buf_init(slab, sizeof(slab));
+}
+
+
+static void et_read_cb(uv_stream_t* stream,
+                       ssize_t nread,
+                       const uv_buf_t* buf) {
+  ASSERT_GE(nread, 0);
+  et_nread += nread;
+  if (et_nread < 256)
+    return;
+
+  ASSERT_EQ(256, et_nread);
+  uv_close((uv_handle_t*) &et_pipes[0], NULL);
+  uv_close((uv_handle_t*) &et_pipes[1], NULL);
+}
+#endif
+
+
+TEST_IMPL(loop_configure_edge_triggered) {
+#ifdef _WIN32
+  RETURN_SKIP("Not on Windows.");
+#else
+  uv_loop_t loop;
+  uv_file fds[2];
+  uv_buf_t buf;
+  char data[256];
+  int r;
+
+  ASSERT_OK(uv_loop_init(&loop));
+
+  r = uv_loop_configure(&loop, UV_LOOP_USE_EDGE_TRIGGERED_STREAMS);
+  if (r == UV_ENOSYS) {
+    MAKE_VALGRIND_HAPPY(&loop);
+    RETURN_SKIP("Edge-triggered streams not supported");
+  }
+  ASSERT_OK(r);
+
+  /* Single byte reads exhaust the per-wakeup read budget long before the
+   * socket is drained. The kernel reports the data only once, the stream
+   * must be requeued to read the rest.
+   */
+  ASSERT_OK(uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT_OK(uv_pipe_init(&loop, &et_pipes[0], 0));
+  ASSERT_OK(uv_pipe_init(&loop, &et_pipes[1], 0));
+  ASSERT_OK(uv_pipe_open(&et_pipes[0], fds[0]));
+  ASSERT_OK(uv_pipe_open(&et_pipes[1], fds[1]));
+  ASSERT_OK(uv_read_start((uv_stream_t*) &et_pipes[0],
+                          et_alloc_cb,
+                          et_read_cb));
+
+  memset(data, 'x', sizeof(data));
+  buf = uv_buf_init(data, sizeof(data));
+  ASSERT_EQ(256, uv_try_write((uv_stream_t*) &et_pipes[1], &buf, 1));
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(256, et_nread);
+
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+#endif
+}
+
+
+#ifndef _WIN32
+static uv_pipe_t iou_stream_pipes[2];
+static uv_write_t iou_stream_write_reqs[2];
+static uv_shutdown_t iou_stream_shutdown_req;
+static size_t iou_stream_nread;
+static int iou_stream_write_cb_called;
+static int iou_stream_shutdown_cb_called;
+static int iou_stream_close_cb_called;
+
+
+static void iou_stream_alloc_cb(uv_handle_t* handle,
+                                size_t suggested_size,
+                                uv_buf_t* buf) {
+  static char slab[16];
+  *buf = uv_buf_init(slab, sizeof(slab));
+}
+
+
+static void iou_stream_close_cb(uv_handle_t* handle) {
+  iou_stream_close_cb_called++;
+}
+
+
+static void iou_stream_read_cb(uv_stream_t* stream,
+                               ssize_t nread,
+                               const uv_buf_t* buf) {
+  if (nread != UV_EOF) {
+    ASSERT_GT(nread, 0);
+    ASSERT_LE(nread, 16);
+    iou_stream_nread += nread;
+    return;
+  }
+
+  ASSERT_EQ(256, iou_stream_nread);
+  /* The other end has a receive in flight that must be cancelled. */
+  uv_close((uv_handle_t*) &iou_stream_pipes[0], iou_stream_close_cb);
+  uv_close((uv_handle_t*) &iou_stream_pipes[1], iou_stream_close_cb);
+}
+
+
+static void iou_stream_write_cb(uv_write_t* req, int status) {
+  ASSERT_OK(status);
+  iou_stream_write_cb_called++;
+}
+
+
+static void iou_stream_shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT_OK(status);
+  ASSERT_EQ(2, iou_stream_write_cb_called);
+  iou_stream_shutdown_cb_called++;
+}
+#endif
+
+
+TEST_IMPL(loop_configure_io_uring_streams) {
+#ifdef _WIN32
+  RETURN_SKIP("Not on Windows.");
+#else
+  uv_loop_t loop;
+  uv_file fds[2];
+  uv_buf_t bufs[2];
+  char data[256];
+  int r;
+
+  ASSERT_OK(uv_loop_init(&loop));
+
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_STREAMS);
+  if (r == UV_ENOSYS) {
+    MAKE_VALGRIND_HAPPY(&loop);
+    RETURN_SKIP("io_uring streams not supported");
+  }
+  ASSERT_OK(r);
+
+  ASSERT_OK(uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT_OK(uv_pipe_init(&loop, &iou_stream_pipes[0], 0));
+  ASSERT_OK(uv_pipe_init(&loop, &iou_stream_pipes[1], 0));
+  ASSERT_OK(uv_pipe_open(&iou_stream_pipes[0], fds[0]));
+  ASSERT_OK(uv_pipe_open(&iou_stream_pipes[1], fds[1]));
+  ASSERT_OK(uv_read_start((uv_stream_t*) &iou_stream_pipes[0],
+                          iou_stream_alloc_cb,
+                          iou_stream_read_cb));
+  ASSERT_OK(uv_read_start((uv_stream_t*) &iou_stream_pipes[1],
+                          iou_stream_alloc_cb,
+                          iou_stream_read_cb));
+
+  /* Received data is handed out in alloc_cb sized pieces. */
+  memset(data, 'x', sizeof(data));
+  bufs[0] = uv_buf_init(data, 128);
+  bufs[1] = uv_buf_init(data + 128, 128);
+  ASSERT_OK(uv_write(&iou_stream_write_reqs[0],
+                     (uv_stream_t*) &iou_stream_pipes[1],
+                     &bufs[0],
+                     1,
+                     iou_stream_write_cb));
+  ASSERT_OK(uv_write(&iou_stream_write_reqs[1],
+                     (uv_stream_t*) &iou_stream_pipes[1],
+                     &bufs[1],
+                     1,
+                     iou_stream_write_cb));
+  ASSERT_OK(uv_shutdown(&iou_stream_shutdown_req,
+                        (uv_stream_t*) &iou_stream_pipes[1],
+                        iou_stream_shutdown_cb));
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(256, iou_stream_nread);
+  ASSERT_EQ(2, iou_stream_write_cb_called);
+  ASSERT_EQ(1, iou_stream_shutdown_cb_called);
+  ASSERT_EQ(2, iou_stream_close_cb_called);
+
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+#endif
+}
+
+
+#ifndef _WIN32
+#define IOU_SHUTDOWN_SIZE (4 * 1024 * 1024)
+
+static uv_pipe_t iou_shutdown_pipes[2];
+static uv_timer_t iou_shutdown_timer;
+static uv_write_t iou_shutdown_write_req;
+static uv_shutdown_t iou_shutdown_req;
+static uint64_t iou_shutdown_loop_count;
+static size_t iou_shutdown_nread;
+static int iou_shutdown_write_cb_called;
+static int iou_shutdown_cb_called;
+
+
+static void iou_shutdown_alloc_cb(uv_handle_t* handle,
+                                  size_t suggested_size,
+                                  uv_buf_t* buf) {
+  static char slab[65536];
+  *buf = uv_buf_init(slab, sizeof(slab));
+}
+
+
+static void iou_shutdown_read_cb(uv_stream_t* stream,
+                                 ssize_t nread,
+                                 const uv_buf_t* buf) {
+  if (nread != UV_EOF) {
+    ASSERT_GT(nread, 0);
+    iou_shutdown_nread += nread;
+    return;
+  }
+
+  ASSERT_EQ(IOU_SHUTDOWN_SIZE, iou_shutdown_nread);
+  uv_close((uv_handle_t*) &iou_shutdown_pipes[0], NULL);
+  uv_close((uv_handle_t*) &iou_shutdown_pipes[1], NULL);
+  uv_close((uv_handle_t*) &iou_shutdown_timer, NULL);
+}
+
+
+static void iou_shutdown_write_cb(uv_write_t* req, int status) {
+  ASSERT_OK(status);
+  iou_shutdown_write_cb_called++;
+}
+
+
+static void iou_shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT_OK(status);
+  ASSERT_EQ(1, iou_shutdown_write_cb_called);
+  iou_shutdown_cb_called++;
+}
+
+
+static void iou_shutdown_timer_cb(uv_timer_t* handle) {
+  uv_metrics_t metrics;
+
+  ASSERT_OK(uv_metrics_info(handle->loop, &metrics));
+
+  if (iou_shutdown_loop_count == 0) {
+    /* Nobody reads, so the send is still in flight. */
+    ASSERT_OK(iou_shutdown_write_cb_called);
+    ASSERT_OK(uv_shutdown(&iou_shutdown_req,
+                          (uv_stream_t*) &iou_shutdown_pipes[1],
+                          iou_shutdown_cb));
+    iou_shutdown_loop_count = metrics.loop_count;
+    return;
+  }
+
+  /* The loop slept while it waited for the send, it didn't spin. */
+  ASSERT_LT(metrics.loop_count - iou_shutdown_loop_count, 20);
+  ASSERT_OK(iou_shutdown_cb_called);
+  ASSERT_OK(uv_timer_stop(handle));
+  ASSERT_OK(uv_read_start((uv_stream_t*) &iou_shutdown_pipes[0],
+                          iou_shutdown_alloc_cb,
+                          iou_shutdown_read_cb));
+}
+#endif
+
+
+TEST_IMPL(loop_configure_io_uring_streams_shutdown) {
+#ifdef _WIN32
+  RETURN_SKIP("Not on Windows.");
+#else
+  uv_loop_t loop;
+  uv_file fds[2];
+  uv_buf_t buf;
+  char* data;
+  int r;
+
+  ASSERT_OK(uv_loop_init(&loop));
+
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_STREAMS);
+  if (r == UV_ENOSYS) {
+    MAKE_VALGRIND_HAPPY(&loop);
+    RETURN_SKIP("io_uring streams not supported");
+  }
+  ASSERT_OK(r);
+
+  ASSERT_OK(uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT_OK(uv_pipe_init(&loop, &iou_shutdown_pipes[0], 0));
+  ASSERT_OK(uv_pipe_init(&loop, &iou_shutdown_pipes[1], 0));
+  ASSERT_OK(uv_pipe_open(&iou_shutdown_pipes[0], fds[0]));
+  ASSERT_OK(uv_pipe_open(&iou_shutdown_pipes[1], fds[1]));
+
+  /* More than the socket buffers hold, the send stays in flight until the
+   * other end starts reading.
+   */
+  data = malloc(IOU_SHUTDOWN_SIZE);
+  ASSERT_NOT_NULL(data);
+  memset(data, 'x', IOU_SHUTDOWN_SIZE);
+  buf = uv_buf_init(data, IOU_SHUTDOWN_SIZE);
+  ASSERT_OK(uv_write(&iou_shutdown_write_req,
+                     (uv_stream_t*) &iou_shutdown_pipes[1],
+                     &buf,
+                     1,
+                     iou_shutdown_write_cb));
+
+  /* Shut down after 50 ms, start reading 50 ms later. */
+  ASSERT_OK(uv_timer_init(&loop, &iou_shutdown_timer));
+  ASSERT_OK(uv_timer_start(&iou_shutdown_timer,
+                           iou_shutdown_timer_cb,
+                           50,
+                           50));
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(IOU_SHUTDOWN_SIZE, iou_shutdown_nread);
+  ASSERT_EQ(1, iou_shutdown_write_cb_called);
+  ASSERT_EQ(1, iou_shutdown_cb_called);
+
+  free(data);
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+#endif
+}
+
+
+#ifndef _WIN32
+static uv_pipe_t pbuf_pipes[2];
+static uv_timer_t pbuf_timer;
+static uv_buf_t pbuf_held[2];
+static unsigned int pbuf_nheld;
+static size_t pbuf_nread;
+
+
+static void pbuf_timer_cb(uv_timer_t* handle) {
+  unsigned int i;
+
+  for (i = 0; i < pbuf_nheld; i++) {
+    ASSERT_OK(uv_read_buf_release(handle->loop, &pbuf_held[i]));
+    ASSERT_EQ(UV_EINVAL, uv_read_buf_release(handle->loop, &pbuf_held[i]));
+  }
+
+  pbuf_nheld = 0;
+}
+
+
+static void pbuf_read_cb(uv_stream_t* stream,
+                         ssize_t nread,
+                         const uv_buf_t* buf) {
+  ASSERT_GT(nread, 0);
+  ASSERT_LE(nread, 64);
+  ASSERT_EQ((size_t) nread, buf->len);
+  ASSERT_EQ('x', buf->base[0]);
+  pbuf_nread += nread;
+
+  /* Hang on to both buffers for a bit. Reading stalls until they're
+   * released.
+   */
+  ASSERT_LT(pbuf_nheld, 2);
+  pbuf_held[pbuf_nheld++] = *buf;
+  if (pbuf_nheld == 2)
+    ASSERT_OK(uv_timer_start(&pbuf_timer, pbuf_timer_cb, 10, 0));
+
+  if (pbuf_nread < 256)
+    return;
+
+  ASSERT_EQ(256, pbuf_nread);
+  pbuf_timer_cb(&pbuf_timer);
+  uv_close((uv_handle_t*) &pbuf_pipes[0], NULL);
+  uv_close((uv_handle_t*) &pbuf_pipes[1], NULL);
+  uv_close((uv_handle_t*) &pbuf_timer, NULL);
+}
+#endif
+
+
+TEST_IMPL(loop_configure_io_uring_buffers) {
+#ifdef _WIN32
+  RETURN_SKIP("Not on Windows.");
+#else
+  uv_loop_t loop;
+  uv_file fds[2];
+  uv_buf_t buf;
+  char data[256];
+  int r;
+
+  ASSERT_OK(uv_loop_init(&loop));
+
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_STREAMS);
+  if (r == 0)
+    r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_BUFFERS, 2u, 64u);
+  if (r == UV_ENOSYS) {
+    MAKE_VALGRIND_HAPPY(&loop);
+    RETURN_SKIP("io_uring provided buffers not supported");
+  }
+  ASSERT_OK(r);
+
+  ASSERT_EQ(UV_EBUSY,
+            uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_BUFFERS, 2u, 64u));
+
+  ASSERT_OK(uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT_OK(uv_pipe_init(&loop, &pbuf_pipes[0], 0));
+  ASSERT_OK(uv_pipe_init(&loop, &pbuf_pipes[1], 0));
+  ASSERT_OK(uv_pipe_open(&pbuf_pipes[0], fds[0]));
+  ASSERT_OK(uv_pipe_open(&pbuf_pipes[1], fds[1]));
+  ASSERT_OK(uv_timer_init(&loop, &pbuf_timer));
+  ASSERT_OK(uv_read_start_provided((uv_stream_t*) &pbuf_pipes[0],
+                                   pbuf_read_cb));
+
+  memset(data, 'x', sizeof(data));
+  buf = uv_buf_init(data, sizeof(data));
+  ASSERT_EQ(256, uv_try_write((uv_stream_t*) &pbuf_pipes[1], &buf, 1));
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(256, pbuf_nread);
+
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+#endif
+}
+
+
+#ifndef _WIN32
+static uv_tcp_t accept_server;
+static uv_tcp_t accept_clients[3];
+static uv_tcp_t accept_conns[3];
+static uv_connect_t accept_connect_reqs[3];
+static uv_timer_t accept_timer;
+static unsigned int accept_connection_cb_called;
+static unsigned int accept_connect_cb_called;
+static unsigned int accept_accepted;
+
+
+static void accept_maybe_done(void) {
+  unsigned int i;
+
+  if (accept_accepted < 3 || accept_connect_cb_called < 3)
+    return;
+
+  for (i = 0; i < 3; i++) {
+    uv_close((uv_handle_t*) &accept_clients[i], NULL);
+    uv_close((uv_handle_t*) &accept_conns[i], NULL);
+  }
+
+  uv_close((uv_handle_t*) &accept_server, NULL);
+  uv_close((uv_handle_t*) &accept_timer, NULL);
+}
+
+
+static void accept_one(uv_stream_t* server) {
+  uv_tcp_t* conn;
+
+  conn = &accept_conns[accept_accepted++];
+  ASSERT_OK(uv_tcp_init(server->loop, conn));
+  ASSERT_OK(uv_accept(server, (uv_stream_t*) conn));
+  accept_maybe_done();
+}
+
+
+static void accept_timer_cb(uv_timer_t* handle) {
+  accept_one((uv_stream_t*) &accept_server);
+}
+
+
+static void accept_connection_cb(uv_stream_t* server, int status) {
+  ASSERT_OK(status);
+
+  /* Put off accepting the first connection. The others are delivered once
+   * the application catches up.
+   */
+  if (accept_connection_cb_called++ == 0) {
+    ASSERT_OK(uv_timer_start(&accept_timer, accept_timer_cb, 50, 0));
+    return;
+  }
+
+  accept_one(server);
+}
+
+
+static void accept_connect_cb(uv_connect_t* req, int status) {
+  ASSERT_OK(status);
+  accept_connect_cb_called++;
+  accept_maybe_done();
+}
+#endif
+
+
+TEST_IMPL(loop_configure_io_uring_accept) {
+#ifdef _WIN32
+  RETURN_SKIP("Not on Windows.");
+#else
+  struct sockaddr_in addr;
+  uv_loop_t loop;
+  unsigned int i;
+  int r;
+
+  ASSERT_OK(uv_loop_init(&loop));
+
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING_STREAMS);
+  if (r == UV_ENOSYS) {
+    MAKE_VALGRIND_HAPPY(&loop);
+    RETURN_SKIP("io_uring streams not supported");
+  }
+  ASSERT_OK(r);
+
+  ASSERT_OK(uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_OK(uv_tcp_init(&loop, &accept_server));
+  ASSERT_OK(uv_tcp_bind(&accept_server, (const struct sockaddr*) &addr, 0));
+  ASSERT_OK(uv_listen((uv_stream_t*) &accept_server,
+                      128,
+                      accept_connection_cb));
+  ASSERT_OK(uv_timer_init(&loop, &accept_timer));
+
+  for (i = 0; i < 3; i++) {
+    ASSERT_OK(uv_tcp_init(&loop, &accept_clients[i]));
+    ASSERT_OK(uv_tcp_connect(&accept_connect_reqs[i],
+                             &accept_clients[i],
+                             (const struct sockaddr*) &addr,
+                             accept_connect_cb));
+  }
+
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(3, accept_connection_cb_called);
+  ASSERT_EQ(3, accept_connect_cb_called);
+  ASSERT_EQ(3, accept_accepted);
+
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+#endif
+}
@@ -388,3 +388,73 @@ TEST_IMPL(metrics_pool_events) {
   MAKE_VALGRIND_HAPPY(uv_default_loop());
   return 0;
 }
+
+
+static void threadpool_work_cb(uv_work_t* req) {
+  uv_sleep(20);
+}
+
+
+static void threadpool_after_work_cb(uv_work_t* req, int status) {
+  ASSERT_OK(status);
+}
+
+
+static void threadpool_fs_cb(uv_fs_t* req) {
+  ASSERT_OK(req->result);
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(metrics_threadpool) {
+  uv_threadpool_metrics_t metrics;
+  uv_work_t work_reqs[2];
+  uv_fs_t fs_req;
+  uint64_t n;
+  int i;
+
+  ASSERT_OK(uv_metrics_threadpool(uv_default_loop(), &metrics));
+  ASSERT_OK(metrics.work.completed);
+  ASSERT_OK(metrics.fs.completed);
+  /* Reading the metrics must not start the thread pool. */
+  ASSERT_OK(metrics.work.threads);
+  ASSERT_OK(metrics.work.queued);
+
+  ASSERT_OK(uv_loop_configure(uv_default_loop(), UV_METRICS_THREADPOOL_TIME));
+  ASSERT_OK(uv_queue_work(uv_default_loop(),
+                          &work_reqs[0],
+                          threadpool_work_cb,
+                          threadpool_after_work_cb));
+  ASSERT_OK(uv_queue_work(uv_default_loop(),
+                          &work_reqs[1],
+                          threadpool_work_cb,
+                          threadpool_after_work_cb));
+  ASSERT_OK(uv_fs_access(uv_default_loop(),
+                         &fs_req,
+                         ".",
+                         0,
+                         threadpool_fs_cb));
+  ASSERT_OK(uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_OK(uv_metrics_threadpool(uv_default_loop(), &metrics));
+  ASSERT_EQ(2, metrics.work.completed);
+  ASSERT_OK(metrics.work.cancelled);
+  ASSERT_GE(metrics.work.run_time, 2 * 20 * 1000000);
+  ASSERT_OK(metrics.dns.completed);
+  ASSERT_OK(metrics.work.queued);
+  ASSERT_GT(metrics.work.threads, 0);
+
+  /* 20 ms falls in the [2^14, 2^15) microseconds bucket, or a later one. */
+  n = 0;
+  for (i = 15; i < UV_THREADPOOL_HISTOGRAM_SIZE; i++)
+    n += metrics.work.run_histogram[i];
+  ASSERT_EQ(2, n);
+
+  n = 0;
+  for (i = 0; i < UV_THREADPOOL_HISTOGRAM_SIZE; i++)
+    n += metrics.work.wait_histogram[i];
+  ASSERT_EQ(2, n);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
@@ -0,0 +1,152 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define NUM_BIG_WRITES 4
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_write_t write_reqs[NUM_BIG_WRITES + 1];
+static char big_data[256 * 1024];
+static size_t nread;
+static int write_cb_called;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static char slab[64 * 1024];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t n, const uv_buf_t* buf) {
+  if (n == UV_EOF) {
+    ASSERT_EQ(nread, NUM_BIG_WRITES * sizeof(big_data) + 1);
+    uv_close((uv_handle_t*) stream, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+    return;
+  }
+
+  ASSERT_GE(n, 0);
+  nread += n;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_OK(status);
+
+  /* The callbacks run in order, also when some sends are zero-copy and
+   * others aren't.
+   */
+  ASSERT_PTR_EQ(req, &write_reqs[write_cb_called]);
+  write_cb_called++;
+
+  if (write_cb_called == ARRAY_SIZE(write_reqs))
+    uv_close((uv_handle_t*) &client, close_cb);
+}
+
+
+static void connection_cb(uv_stream_t* s, int status) {
+  ASSERT_OK(status);
+  ASSERT_OK(uv_tcp_init(s->loop, &incoming));
+  ASSERT_OK(uv_accept(s, (uv_stream_t*) &incoming));
+  ASSERT_OK(uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+  int i;
+
+  ASSERT_OK(status);
+
+  buf = uv_buf_init(big_data, sizeof(big_data));
+  for (i = 0; i < NUM_BIG_WRITES; i++)
+    ASSERT_OK(uv_write(&write_reqs[i],
+                       (uv_stream_t*) &client,
+                       &buf,
+                       1,
+                       write_cb));
+
+  /* Below the threshold, copied. */
+  buf = uv_buf_init("x", 1);
+  ASSERT_OK(uv_write(&write_reqs[NUM_BIG_WRITES],
+                     (uv_stream_t*) &client,
+                     &buf,
+                     1,
+                     write_cb));
+}
+
+
+TEST_IMPL(tcp_zerocopy) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int r;
+
+  loop = uv_default_loop();
+
+  r = uv_loop_configure(loop, UV_LOOP_USE_IO_URING_STREAMS);
+  if (r == UV_ENOSYS)
+    RETURN_SKIP("io_uring streams not supported");
+  ASSERT_OK(r);
+
+  ASSERT_OK(uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_OK(uv_tcp_init(loop, &server));
+  ASSERT_OK(uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_OK(uv_listen((uv_stream_t*) &server, 1, connection_cb));
+
+  ASSERT_OK(uv_tcp_init(loop, &client));
+  ASSERT_EQ(UV_EBADF, uv_tcp_zerocopy(&client, 1, 0));
+  ASSERT_OK(uv_tcp_connect(&connect_req,
+                           &client,
+                           (const struct sockaddr*) &addr,
+                           connect_cb));
+
+  r = uv_tcp_zerocopy(&client, 1, 64 * 1024);
+  if (r == UV_ENOTSUP) {
+    MAKE_VALGRIND_HAPPY(loop);
+    RETURN_SKIP("zero-copy sends not supported");
+  }
+  ASSERT_OK(r);
+
+  memset(big_data, 'x', sizeof(big_data));
+  ASSERT_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(write_cb_called, ARRAY_SIZE(write_reqs));
+  ASSERT_EQ(3, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY(loop);
+  return 0;
+}
@@ -74,3 +74,596 @@ TEST_IMPL(threadpool_queue_work_einval) {
   MAKE_VALGRIND_HAPPY(uv_default_loop());
   return 0;
 }
+
+
+static uv_sem_t pool_sem;
+static uv_thread_t pool_threads[2];
+static uv_work_t pool_reqs[2];
+static uv_fs_t pool_fs_req;
+static int pool_done_cb_count;
+
+
+static void pool_work_cb(uv_work_t* req) {
+  if (req == &pool_reqs[0])
+    uv_sem_wait(&pool_sem);
+  pool_threads[req - pool_reqs] = uv_thread_self();
+}
+
+
+static void pool_done_cb(uv_work_t* req, int status) {
+  ASSERT_OK(status);
+  pool_done_cb_count++;
+}
+
+
+static void pool_fs_cb(uv_fs_t* req) {
+  /* The work pool is blocked, file system requests still make progress. */
+  ASSERT_OK(pool_done_cb_count);
+  uv_fs_req_cleanup(req);
+  uv_sem_post(&pool_sem);
+}
+
+
+TEST_IMPL(threadpool_custom) {
+  uv_threadpool_t pool;
+  uv_loop_t loop;
+
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_init(&pool, 0));
+  ASSERT_OK(uv_threadpool_init(&pool, 1));
+  ASSERT_OK(uv_sem_init(&pool_sem, 0));
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_WORK,
+                              &pool));
+
+  ASSERT_OK(uv_queue_work(&loop, &pool_reqs[0], pool_work_cb, pool_done_cb));
+  ASSERT_OK(uv_queue_work(&loop, &pool_reqs[1], pool_work_cb, pool_done_cb));
+  ASSERT_OK(uv_fs_access(&loop, &pool_fs_req, ".", 0, pool_fs_cb));
+  ASSERT_EQ(UV_EBUSY, uv_loop_configure(&loop,
+                                        UV_LOOP_THREADPOOL,
+                                        UV_THREADPOOL_WORK,
+                                        NULL));
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(2, pool_done_cb_count);
+  ASSERT(uv_thread_equal(&pool_threads[0], &pool_threads[1]));
+
+  ASSERT_EQ(UV_EBUSY, uv_threadpool_close(&pool));
+  ASSERT_OK(uv_loop_close(&loop));
+  ASSERT_OK(uv_threadpool_close(&pool));
+  uv_sem_destroy(&pool_sem);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+static uv_sem_t elastic_sem;
+static int elastic_done_cb_count;
+
+
+static void elastic_wait_cb(uv_work_t* req) {
+  uv_sem_wait(&elastic_sem);
+}
+
+
+static void elastic_post_cb(uv_work_t* req) {
+  uv_sem_post(&elastic_sem);
+}
+
+
+static void elastic_done_cb(uv_work_t* req, int status) {
+  ASSERT_OK(status);
+  elastic_done_cb_count++;
+}
+
+
+static unsigned int elastic_threads(uv_loop_t* loop) {
+  uv_threadpool_metrics_t metrics;
+
+  ASSERT_OK(uv_metrics_threadpool(loop, &metrics));
+  return metrics.work.threads;
+}
+
+
+TEST_IMPL(threadpool_elastic) {
+  uv_threadpool_options_t options;
+  uv_threadpool_t pool;
+  uv_work_t reqs[2];
+  uv_loop_t loop;
+  int round;
+  int i;
+
+  memset(&options, 0, sizeof(options));
+  options.min_threads = 2;
+  options.max_threads = 1;
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_init_ex(&pool, &options));
+
+  /* Starts without threads. The second request only runs once the pool grew
+   * to two threads, the first one waits for it.
+   */
+  options.min_threads = 0;
+  options.max_threads = 2;
+  options.spawn_delay = 10;
+  options.idle_timeout = 100;
+  ASSERT_OK(uv_threadpool_init_ex(&pool, &options));
+  ASSERT_OK(uv_sem_init(&elastic_sem, 0));
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_WORK,
+                              &pool));
+
+  ASSERT_OK(elastic_threads(&loop));
+
+  /* The second round runs after the idle threads exited. */
+  for (round = 1; round <= 2; round++) {
+    ASSERT_OK(uv_queue_work(&loop, &reqs[0], elastic_wait_cb, elastic_done_cb));
+    ASSERT_OK(uv_queue_work(&loop, &reqs[1], elastic_post_cb, elastic_done_cb));
+    ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+    ASSERT_EQ(2 * round, elastic_done_cb_count);
+    ASSERT_EQ(2, elastic_threads(&loop));
+
+    /* The threads exit 100 ms after they ran out of work. */
+    for (i = 0; i < 500 && elastic_threads(&loop) > 0; i++)
+      uv_sleep(10);
+    ASSERT_OK(elastic_threads(&loop));
+  }
+
+  ASSERT_OK(uv_loop_close(&loop));
+  ASSERT_OK(uv_threadpool_close(&pool));
+  uv_sem_destroy(&elastic_sem);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+static uv_sem_t priority_sem;
+static uv_sem_t priority_started;
+static int priority_order[12];
+static int priority_count;
+
+
+static void priority_block_cb(uv_work_t* req) {
+  uv_sem_post(&priority_started);
+  uv_sem_wait(&priority_sem);
+}
+
+
+static void priority_work_cb(uv_work_t* req) {
+  /* The pool has one thread, no locking needed. */
+  priority_order[priority_count++] = (int) (intptr_t) req->data;
+}
+
+
+static void priority_done_cb(uv_work_t* req, int status) {
+  ASSERT_OK(status);
+}
+
+
+TEST_IMPL(threadpool_priority) {
+  uv_threadpool_t pool;
+  uv_work_t reqs[12];
+  uv_work_t block_req;
+  uv_loop_t loop;
+  int i;
+
+  ASSERT_OK(uv_threadpool_init(&pool, 1));
+  ASSERT_OK(uv_sem_init(&priority_sem, 0));
+  ASSERT_OK(uv_sem_init(&priority_started, 0));
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_WORK,
+                              &pool));
+  ASSERT_EQ(UV_EINVAL, uv_loop_configure(&loop, UV_LOOP_WORK_PRIORITY, 2));
+
+  ASSERT_OK(uv_queue_work(&loop,
+                          &block_req,
+                          priority_block_cb,
+                          priority_done_cb));
+  uv_sem_wait(&priority_started);
+
+  /* Two background requests with the loop's default priority, then one
+   * normal request and a batch of nine critical ones with their own.
+   */
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_WORK_PRIORITY,
+                              UV_WORK_PRIORITY_BACKGROUND));
+  for (i = 0; i < 2; i++) {
+    reqs[i].data = (void*) (intptr_t) i;
+    ASSERT_OK(uv_queue_work(&loop,
+                            &reqs[i],
+                            priority_work_cb,
+                            priority_done_cb));
+  }
+
+  ASSERT_EQ(UV_EINVAL, uv_queue_work_ex(&loop,
+                                        &reqs[2],
+                                        priority_work_cb,
+                                        priority_done_cb,
+                                        (uv_work_priority) 2));
+  ASSERT_EQ(UV_EINVAL, uv_queue_work_batch_ex(&loop,
+                                              &reqs[3],
+                                              9,
+                                              priority_work_cb,
+                                              priority_done_cb,
+                                              (uv_work_priority) -2));
+  for (i = 2; i < (int) ARRAY_SIZE(reqs); i++)
+    reqs[i].data = (void*) (intptr_t) i;
+  ASSERT_OK(uv_queue_work_ex(&loop,
+                             &reqs[2],
+                             priority_work_cb,
+                             priority_done_cb,
+                             UV_WORK_PRIORITY_NORMAL));
+  ASSERT_OK(uv_queue_work_batch_ex(&loop,
+                                   &reqs[3],
+                                   9,
+                                   priority_work_cb,
+                                   priority_done_cb,
+                                   UV_WORK_PRIORITY_CRITICAL));
+
+  uv_sem_post(&priority_sem);
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(12, priority_count);
+
+  /* Critical work goes first. The normal and the first background request
+   * get a turn after they were passed over eight times.
+   */
+  for (i = 0; i < 8; i++)
+    ASSERT_EQ(3 + i, priority_order[i]);
+  ASSERT_EQ(2, priority_order[8]);
+  ASSERT_EQ(0, priority_order[9]);
+  ASSERT_EQ(11, priority_order[10]);
+  ASSERT_EQ(1, priority_order[11]);
+
+  ASSERT_OK(uv_loop_close(&loop));
+  ASSERT_OK(uv_threadpool_close(&pool));
+  uv_sem_destroy(&priority_started);
+  uv_sem_destroy(&priority_sem);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+static int batch_done_cb_count;
+
+
+static void batch_work_cb(uv_work_t* req) {
+  ASSERT_PTR_EQ(req->data, &data);
+}
+
+
+static void batch_done_cb(uv_work_t* req, int status) {
+  ASSERT_OK(status);
+  ASSERT_PTR_EQ(req->data, &data);
+  batch_done_cb_count++;
+}
+
+
+TEST_IMPL(threadpool_queue_work_batch) {
+  uv_work_t reqs[64];
+  unsigned int i;
+
+  for (i = 0; i < ARRAY_SIZE(reqs); i++)
+    reqs[i].data = &data;
+
+  ASSERT_EQ(UV_EINVAL, uv_queue_work_batch(uv_default_loop(),
+                                           reqs,
+                                           ARRAY_SIZE(reqs),
+                                           NULL,
+                                           batch_done_cb));
+  ASSERT_OK(uv_queue_work_batch(uv_default_loop(),
+                                reqs,
+                                0,
+                                batch_work_cb,
+                                batch_done_cb));
+  ASSERT_OK(uv_queue_work_batch(uv_default_loop(),
+                                reqs,
+                                ARRAY_SIZE(reqs),
+                                batch_work_cb,
+                                batch_done_cb));
+  ASSERT_OK(uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(reqs), batch_done_cb_count);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+static int spin_done_cb_count;
+
+
+static void spin_work_cb(uv_work_t* req) {
+  ASSERT_PTR_EQ(req->data, &data);
+}
+
+
+static void spin_done_cb(uv_work_t* req, int status) {
+  ASSERT_OK(status);
+  /* Queue the next request while the threads are still spinning. */
+  if (++spin_done_cb_count < 1000)
+    ASSERT_OK(uv_queue_work(req->loop, req, spin_work_cb, spin_done_cb));
+}
+
+
+TEST_IMPL(threadpool_spin) {
+  uv_threadpool_options_t options;
+  uv_threadpool_t pool;
+  uv_work_t reqs[4];
+  uv_loop_t loop;
+  unsigned int i;
+
+  memset(&options, 0, sizeof(options));
+  options.min_threads = 4;
+  options.max_threads = 4;
+  options.spin_time = 1000;
+  ASSERT_OK(uv_threadpool_init_ex(&pool, &options));
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_WORK,
+                              &pool));
+
+  for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+    reqs[i].data = &data;
+    ASSERT_OK(uv_queue_work(&loop, &reqs[i], spin_work_cb, spin_done_cb));
+  }
+
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1000 + ARRAY_SIZE(reqs) - 1, spin_done_cb_count);
+
+  /* Closing the pool must not wait for the spinning threads forever. */
+  ASSERT_OK(uv_loop_close(&loop));
+  ASSERT_OK(uv_threadpool_close(&pool));
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+static void placement_work_cb(uv_work_t* req) {
+  uv_thread_t tid;
+
+  tid = uv_thread_self();
+  ASSERT_OK(uv_thread_getaffinity(&tid, req->data, uv_cpumask_size()));
+}
+
+
+static void placement_done_cb(uv_work_t* req, int status) {
+  const char* mask;
+  int ncpus;
+  int i;
+
+  ASSERT_OK(status);
+  mask = req->data;
+  ncpus = 0;
+  for (i = 0; i < uv_cpumask_size(); i++)
+    ncpus += mask[i];
+
+  ASSERT_EQ(1, ncpus);
+}
+
+
+TEST_IMPL(threadpool_placement) {
+  uv_threadpool_options_t options;
+  uv_threadpool_t pool;
+  uv_work_t reqs[4];
+  uv_loop_t loop;
+  unsigned int i;
+  char* masks;
+  int size;
+
+  memset(&options, 0, sizeof(options));
+  options.min_threads = 2;
+  options.max_threads = 2;
+  options.placement = UV_THREADPOOL_PIN_CPU | UV_THREADPOOL_PIN_NUMA;
+
+  size = uv_cpumask_size();
+  if (size < 0) {
+    ASSERT_EQ(size, uv_threadpool_init_ex(&pool, &options));
+    RETURN_SKIP("No CPU affinity support.");
+  }
+
+  masks = calloc(ARRAY_SIZE(reqs), size);
+  ASSERT_NOT_NULL(masks);
+
+  /* An empty CPU set or a too small mask are rejected. */
+  options.cpumask = masks;
+  options.cpumask_size = size;
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_init_ex(&pool, &options));
+  options.cpumask_size = size - 1;
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_init_ex(&pool, &options));
+
+  /* Without a mask the pool uses the CPUs of the calling thread. */
+  options.cpumask = NULL;
+  options.cpumask_size = 0;
+  ASSERT_OK(uv_threadpool_init_ex(&pool, &options));
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_WORK,
+                              &pool));
+
+  for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+    reqs[i].data = masks + i * size;
+    ASSERT_OK(uv_queue_work(&loop,
+                            &reqs[i],
+                            placement_work_cb,
+                            placement_done_cb));
+  }
+
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_OK(uv_loop_close(&loop));
+  ASSERT_OK(uv_threadpool_close(&pool));
+  free(masks);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+static uv_sem_t detached_sem;
+static uv_sem_t detached_block_sem;
+static int detached_work_cb_count;
+
+
+static void detached_block_cb(uv_work_t* req) {
+  uv_sem_wait(&detached_block_sem);
+}
+
+
+static void detached_work_cb(uv_work_t* req) {
+  detached_work_cb_count++;
+  free(req);  /* The request is ours again. */
+  uv_sem_post(&detached_sem);
+}
+
+
+static void detached_cancelled_cb(uv_work_t* req) {
+  ASSERT(0 && "detached_cancelled_cb should not have been called");
+}
+
+
+TEST_IMPL(threadpool_queue_work_detached) {
+  uv_threadpool_t pool;
+  uv_work_t* req;
+  uv_work_t block_req;
+  uv_work_t cancel_req;
+  uv_loop_t loop;
+
+  ASSERT_OK(uv_sem_init(&detached_sem, 0));
+  ASSERT_OK(uv_sem_init(&detached_block_sem, 0));
+  ASSERT_OK(uv_threadpool_init(&pool, 1));
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_WORK,
+                              &pool));
+
+  req = malloc(sizeof(*req));
+  ASSERT_NOT_NULL(req);
+  ASSERT_EQ(UV_EINVAL, uv_queue_work_detached(&loop, req, NULL));
+
+  /* The loop has nothing to wait for. */
+  ASSERT_OK(uv_queue_work_detached(&loop, req, detached_work_cb));
+  ASSERT_OK(uv_loop_alive(&loop));
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  uv_sem_wait(&detached_sem);
+  ASSERT_EQ(1, detached_work_cb_count);
+
+  /* Queued detached work can be cancelled, no callback runs. */
+  ASSERT_OK(uv_queue_work_detached(&loop, &block_req, detached_block_cb));
+  ASSERT_OK(uv_queue_work_detached(&loop,
+                                   &cancel_req,
+                                   detached_cancelled_cb));
+  ASSERT_OK(uv_cancel((uv_req_t*) &cancel_req));
+  uv_sem_post(&detached_block_sem);
+
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_OK(uv_loop_close(&loop));
+  /* Runs the work that is still queued before the threads exit. */
+  ASSERT_OK(uv_threadpool_close(&pool));
+  ASSERT_EQ(1, detached_work_cb_count);
+
+  uv_sem_destroy(&detached_block_sem);
+  uv_sem_destroy(&detached_sem);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+TEST_IMPL(threadpool_auto_size) {
+  uv_threadpool_metrics_t metrics;
+  unsigned int expected;
+
+  /* Must be set before the global thread pool starts. */
+  ASSERT_OK(uv_os_setenv("UV_THREADPOOL_SIZE", "auto"));
+
+  work_req.data = &data;
+  ASSERT_OK(uv_queue_work(uv_default_loop(),
+                          &work_req,
+                          work_cb,
+                          after_work_cb));
+  ASSERT_OK(uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(1, work_cb_count);
+  ASSERT_EQ(1, after_work_cb_count);
+
+  /* One thread per CPU of the quota, at least two. */
+  expected = uv_available_parallelism();
+  if (expected < 2)
+    expected = 2;
+
+  ASSERT_OK(uv_metrics_threadpool(uv_default_loop(), &metrics));
+  ASSERT_EQ(expected, metrics.work.threads);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+TEST_IMPL(threadpool_queue_work_detached_rebind) {
+  uv_threadpool_t pools[2];
+  uv_work_t block_req;
+  uv_work_t cancel_req;
+  uv_loop_t loop;
+  int i;
+  int r;
+
+  ASSERT_OK(uv_sem_init(&detached_block_sem, 0));
+  ASSERT_OK(uv_threadpool_init(&pools[0], 1));
+  ASSERT_OK(uv_threadpool_init(&pools[1], 1));
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_WORK,
+                              &pools[0]));
+
+  ASSERT_OK(uv_queue_work_detached(&loop, &block_req, detached_block_cb));
+  ASSERT_OK(uv_queue_work_detached(&loop,
+                                   &cancel_req,
+                                   detached_cancelled_cb));
+
+  /* The loop stays on the pool while detached work is queued there, so that
+   * uv_cancel() finds the work.
+   */
+  ASSERT_EQ(UV_EBUSY, uv_loop_configure(&loop,
+                                        UV_LOOP_THREADPOOL,
+                                        UV_THREADPOOL_WORK,
+                                        &pools[1]));
+  ASSERT_OK(uv_cancel((uv_req_t*) &cancel_req));
+  ASSERT_EQ(UV_EBUSY, uv_cancel((uv_req_t*) &cancel_req));
+
+  /* Only the file system requests move. */
+  ASSERT_OK(uv_loop_configure(&loop,
+                              UV_LOOP_THREADPOOL,
+                              UV_THREADPOOL_FS,
+                              &pools[1]));
+
+  /* Once the worker took the blocking work off the queue, the loop can move.
+   * It's picked up right away, but give it time.
+   */
+  for (i = 0; i < 500; i++) {
+    r = uv_loop_configure(&loop,
+                          UV_LOOP_THREADPOOL,
+                          UV_THREADPOOL_WORK,
+                          &pools[1]);
+    if (r != UV_EBUSY)
+      break;
+    uv_sleep(10);
+  }
+  ASSERT_OK(r);
+  uv_sem_post(&detached_block_sem);
+
+  ASSERT_OK(uv_loop_close(&loop));
+  ASSERT_OK(uv_threadpool_close(&pools[0]));
+  ASSERT_OK(uv_threadpool_close(&pools[1]));
+  uv_sem_destroy(&detached_block_sem);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
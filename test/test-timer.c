@@ -451,3 +451,154 @@ TEST_IMPL(timer_no_run_on_unref) {
   MAKE_VALGRIND_HAPPY(uv_default_loop());
   return 0;
 }
+
+
+static const uint64_t wheel_timeouts[] = { 130, 0, 64, 63, 1, 130, 100, 65 };
+static const int wheel_order[] = { 6, 0, 3, 2, 1, 5, -1, 4 };
+static int wheel_cb_called;
+
+
+static void wheel_cb(uv_timer_t* handle) {
+  int i;
+
+  i = (int) (intptr_t) handle->data;
+  ASSERT_EQ(wheel_order[i], wheel_cb_called);
+  ASSERT_UINT64_GE(uv_now(handle->loop) - start_time, wheel_timeouts[i]);
+  wheel_cb_called++;
+}
+
+
+TEST_IMPL(timer_wheel) {
+  uv_timer_t handles[ARRAY_SIZE(wheel_timeouts)];
+  uv_loop_t loop;
+  size_t i;
+
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_timer_init(&loop, &handles[0]));
+  ASSERT_OK(uv_timer_start(&handles[0], wheel_cb, 1, 0));
+  ASSERT_EQ(UV_EBUSY, uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
+  ASSERT_OK(uv_timer_stop(&handles[0]));
+  ASSERT_OK(uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
+
+  start_time = uv_now(&loop);
+  for (i = 0; i < ARRAY_SIZE(wheel_timeouts); i++) {
+    ASSERT_OK(uv_timer_init(&loop, &handles[i]));
+    handles[i].data = (void*) (intptr_t) i;
+    ASSERT_OK(uv_timer_start(&handles[i], wheel_cb, wheel_timeouts[i], 0));
+  }
+
+  /* Restarting a timer orders it after the others with the same timeout. */
+  ASSERT_OK(uv_timer_start(&handles[0], wheel_cb, wheel_timeouts[0], 0));
+  ASSERT_OK(uv_timer_stop(&handles[6]));
+
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(7, wheel_cb_called);
+
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+}
+
+
+static uint64_t slack_now;
+static int slack_cb_called;
+static int slack_wakeups;
+static int strict_cb_called;
+
+
+static void strict_cb(uv_timer_t* handle) {
+  strict_cb_called++;
+}
+
+
+static void slack_cb(uv_timer_t* handle) {
+  /* The timers span less than the slack, so they straddle at most one
+   * multiple of it.
+   */
+  if (slack_now != uv_now(handle->loop)) {
+    slack_now = uv_now(handle->loop);
+    slack_wakeups++;
+  }
+
+  ASSERT_LE(slack_wakeups, 2);
+  slack_cb_called++;
+}
+
+
+TEST_IMPL(timer_slack) {
+  uv_timer_t handles[10];
+  uv_timer_t strict;
+  uv_loop_t loop;
+  uint64_t due;
+  uint64_t now;
+  int i;
+
+  ASSERT_OK(uv_loop_init(&loop));
+  ASSERT_OK(uv_loop_configure(&loop, UV_LOOP_TIMER_SLACK, 50u));
+
+  /* Due times are rounded up to a multiple of the slack... */
+  now = uv_now(&loop);
+  for (i = 0; i < (int) ARRAY_SIZE(handles); i++) {
+    ASSERT_OK(uv_timer_init(&loop, &handles[i]));
+    ASSERT_OK(uv_timer_start(&handles[i], slack_cb, 1 + i * 3, 0));
+    due = now + uv_timer_get_due_in(&handles[i]);
+    ASSERT_OK(due % 50);
+    ASSERT_UINT64_GE(due, now + 1 + i * 3);
+    ASSERT_UINT64_LT(due, now + 1 + i * 3 + 50);
+  }
+
+  /* ...except for strict timers. */
+  ASSERT_OK(uv_timer_init(&loop, &strict));
+  uv_timer_set_strict(&strict, 1);
+  ASSERT_OK(uv_timer_start(&strict, strict_cb, 7, 0));
+  ASSERT_UINT64_EQ(7, uv_timer_get_due_in(&strict));
+
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, strict_cb_called);
+  ASSERT_EQ(10, slack_cb_called);
+
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+}
+
+
+static int restart_order_cb_called;
+
+
+static void restart_order_cb(uv_timer_t* handle) {
+  ASSERT_EQ(restart_order_cb_called, (int) (intptr_t) handle->data);
+  restart_order_cb_called++;
+}
+
+
+TEST_IMPL(timer_restart_order) {
+  uv_timer_t handles[4];
+  uv_loop_t loop;
+  int i;
+
+  ASSERT_OK(uv_loop_init(&loop));
+  for (i = 0; i < (int) ARRAY_SIZE(handles); i++)
+    ASSERT_OK(uv_timer_init(&loop, &handles[i]));
+
+  handles[0].data = (void*) 1;
+  handles[1].data = (void*) 2;
+  handles[2].data = (void*) 3;
+  handles[3].data = (void*) 0;
+
+  /* Timers that are pushed out run in the order of their last start... */
+  ASSERT_OK(uv_timer_start(&handles[0], restart_order_cb, 50, 0));
+  ASSERT_OK(uv_timer_start(&handles[1], restart_order_cb, 10, 0));
+  ASSERT_OK(uv_timer_start(&handles[1], restart_order_cb, 30, 0));
+  ASSERT_OK(uv_timer_start(&handles[1], restart_order_cb, 50, 0));
+  ASSERT_UINT64_EQ(50, uv_timer_get_due_in(&handles[1]));
+  ASSERT_OK(uv_timer_start(&handles[2], restart_order_cb, 50, 0));
+
+  /* ...and so do timers that are pulled in. */
+  ASSERT_OK(uv_timer_start(&handles[3], restart_order_cb, 20, 0));
+  ASSERT_OK(uv_timer_start(&handles[3], restart_order_cb, 5, 0));
+
+  ASSERT_OK(uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(4, restart_order_cb_called);
+
+  MAKE_VALGRIND_HAPPY(&loop);
+  return 0;
+}
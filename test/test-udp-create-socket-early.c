@@ -129,7 +129,7 @@ TEST_IMPL(udp_create_early_bad_domain) {
   r = uv_udp_init_ex(uv_default_loop(), &client, 47);
   ASSERT_EQ(r, UV_EINVAL);
 
-  r = uv_udp_init_ex(uv_default_loop(), &client, 1024);
+  r = uv_udp_init_ex(uv_default_loop(), &client, 4096);
   ASSERT_EQ(r, UV_EINVAL);
 
   uv_run(uv_default_loop(), UV_RUN_DEFAULT);
@@ -0,0 +1,206 @@
+/* Copyright libuv contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+/* 71 datagrams, more than the kernel segments in one go. */
+#define SEGMENT_SIZE 1000
+#define PAYLOAD_SIZE (70 * SEGMENT_SIZE + 500)
+
+static uv_udp_t recver;
+static uv_udp_t senders[2];
+static uv_udp_send_t send_reqs[2];
+static char payload[PAYLOAD_SIZE];
+static char recv_buf[64 * 1024];
+static struct sockaddr_in addr;
+static size_t received;
+static int sender;
+static int nsenders;
+static int send_cb_called;
+static int free_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  buf->base = recv_buf;
+  buf->len = sizeof(recv_buf);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT_OK(status);
+  ASSERT_PTR_EQ(req, &send_reqs[sender]);
+  send_cb_called++;
+}
+
+
+static void send_payload(void) {
+  uv_buf_t bufs[3];
+
+  /* Segments straddle the buffer boundaries. */
+  bufs[0] = uv_buf_init(payload, 30250);
+  bufs[1] = uv_buf_init(payload + 30250, 40000);
+  bufs[2] = uv_buf_init(payload + 70250, PAYLOAD_SIZE - 70250);
+
+  ASSERT_OK(uv_udp_send_gso(&send_reqs[sender],
+                            &senders[sender],
+                            bufs,
+                            ARRAY_SIZE(bufs),
+                            (const struct sockaddr*) &addr,
+                            SEGMENT_SIZE,
+                            send_cb));
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* from,
+                    unsigned flags) {
+  size_t expected;
+
+  ASSERT_GE(nread, 0);
+  if (flags & UV_UDP_MMSG_FREE) {
+    ASSERT_OK(nread);
+    ASSERT_NULL(from);
+    ASSERT_PTR_EQ(buf->base, recv_buf);
+    free_cb_called++;
+    return;
+  }
+
+  if (nread == 0) {
+    ASSERT_NULL(from);
+    return;
+  }
+
+  /* Every datagram is a full segment, except for the last one. */
+  expected = PAYLOAD_SIZE - received;
+  if (expected > SEGMENT_SIZE)
+    expected = SEGMENT_SIZE;
+
+  ASSERT_EQ(nread, expected);
+  ASSERT_MEM_EQ(payload + received, buf->base, nread);
+  received += nread;
+
+  if (received < PAYLOAD_SIZE)
+    return;
+
+  received = 0;
+  if (++sender < nsenders) {
+    send_payload();
+    return;
+  }
+
+  uv_close((uv_handle_t*) &recver, close_cb);
+  while (nsenders > 0)
+    uv_close((uv_handle_t*) &senders[--nsenders], close_cb);
+}
+
+
+TEST_IMPL(udp_send_gso) {
+  uv_buf_t buf;
+  size_t i;
+
+  for (i = 0; i < sizeof(payload); i++)
+    payload[i] = i % 251;
+
+  ASSERT_OK(uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_OK(uv_udp_init(uv_default_loop(), &recver));
+  ASSERT_OK(uv_udp_bind(&recver, (const struct sockaddr*) &addr, 0));
+  ASSERT_OK(uv_udp_recv_start(&recver, alloc_cb, recv_cb));
+
+  /* The first sender lets the kernel segment, if it can, the second one
+   * segments in userspace.
+   */
+  ASSERT_OK(uv_udp_init_ex(uv_default_loop(),
+                           &senders[0],
+                           AF_INET | UV_UDP_GSO));
+  ASSERT_OK(uv_udp_init_ex(uv_default_loop(), &senders[1], AF_INET));
+  nsenders = 2;
+
+  buf = uv_buf_init(payload, 1);
+  ASSERT_EQ(UV_EINVAL, uv_udp_send_gso(&send_reqs[0],
+                                       &senders[0],
+                                       &buf,
+                                       1,
+                                       (const struct sockaddr*) &addr,
+                                       0,
+                                       send_cb));
+
+  send_payload();
+
+  ASSERT_OK(uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_EQ(2, send_cb_called);
+  ASSERT_EQ(3, close_cb_called);
+  ASSERT_EQ(2, sender);
+  ASSERT_OK(free_cb_called);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}
+
+
+TEST_IMPL(udp_recv_gro) {
+  size_t i;
+
+  for (i = 0; i < sizeof(payload); i++)
+    payload[i] = i % 251;
+
+  ASSERT_OK(uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_OK(uv_udp_init_ex(uv_default_loop(), &recver, AF_INET | UV_UDP_GRO));
+  ASSERT_OK(uv_udp_bind(&recver, (const struct sockaddr*) &addr, 0));
+  ASSERT_OK(uv_udp_recv_start(&recver, alloc_cb, recv_cb));
+
+  ASSERT_OK(uv_udp_init_ex(uv_default_loop(),
+                           &senders[0],
+                           AF_INET | UV_UDP_GSO));
+  nsenders = 1;
+
+  send_payload();
+
+  ASSERT_OK(uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_EQ(1, send_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+  ASSERT_EQ(1, sender);
+
+  /* Loopback hands segmentation offloaded sends to GRO sockets as they are,
+   * so the datagrams come in far fewer reads than there are datagrams.
+   */
+#if defined(__linux__)
+  ASSERT_GT(free_cb_called, 0);
+#endif
+  ASSERT_LT(free_cb_called, PAYLOAD_SIZE / SEGMENT_SIZE);
+
+  MAKE_VALGRIND_HAPPY(uv_default_loop());
+  return 0;
+}